@@ -0,0 +1,46 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include "board.h"
+#include <stdio.h>
+
+#define ANALYZER_MAX_ISSUES 32
+#define ANALYZER_MAX_PASSES 4096 // Limite de passagens completas no dry run de um script
+
+typedef enum {
+    ISSUE_WARNING = 0,
+    ISSUE_ERROR = 1,
+} issue_severity_t;
+
+typedef struct {
+    issue_severity_t severity;
+    char msg[160];
+} level_issue_t;
+
+typedef struct {
+    char level_name[256];
+    int n_errors;
+    int n_warnings;
+    int open_cells, reachable_cells;
+    int total_dots, reachable_dots;
+    int n_portals, reachable_portals;
+    int n_issues; // Só os primeiros ANALYZER_MAX_ISSUES são guardados
+    level_issue_t issues[ANALYZER_MAX_ISSUES];
+} level_report_t;
+
+/* Analisa estaticamente um nível já carregado por parse_level.
+   Devolve o número de erros encontrados (0 = nível jogável) */
+int analyze_level(const board_t* board, level_report_t* report);
+
+/* Analisa todos os .lvl de uma diretoria em paralelo com n_threads.
+   *reports fica com um relatório por nível (libertar com free) */
+int analyze_directory(const char* dir_path, int n_threads, level_report_t** reports, int* n_reports);
+
+/* Escreve o relatório para um stream ou para o ficheiro de debug */
+void print_level_report(FILE* out, const level_report_t* report);
+void log_level_report(const level_report_t* report);
+
+/* Modo "--check <dir> [threads]": valida uma diretoria sem jogar */
+int analyzer_main(int argc, char** argv);
+
+#endif
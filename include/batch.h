@@ -0,0 +1,67 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "board.h"
+
+/* Simulação em lockstep de K cópias independentes do mesmo nível.
+   O estado de cada agente é guardado como structure-of-arrays ao longo dos
+   jogos (uma "lane" por jogo) e cada jogada corre kernels sobre as K lanes,
+   com as mesmas regras de sim_step/move_pacman/move_ghost. Os kernels não têm
+   ramos por lane (máscaras e seleções) e as decisões (passo, instrução, destino,
+   paredes, colisões, pontos) vetorizam; as leituras e escritas nas grelhas, que
+   dependem da casa de cada lane, ficam em ciclos próprios à volta delas. Só a
+   investida de um fantasma carregado anda casa a casa. */
+
+typedef struct {
+    int32_t *x, *y;
+    int32_t *pc;       // Instrução atual
+    int32_t *wait;     // waiting
+    int32_t *left;     // Jogadas de ação que faltam à instrução atual
+    int32_t *charged;
+    int32_t *alive;
+    int32_t *points;
+    uint32_t *rng;
+    int passo;
+    int n_code;
+    // Script compilado (igual em todas as lanes): cada instrução numa palavra
+    // (op, carga e direção) e o contador à parte
+    int32_t code_word[MAX_MOVES];
+    int32_t code_count[MAX_MOVES];
+} agent_lanes_t;
+
+typedef struct {
+    int K, P, G;           // lanes, Pacmans, fantasmas
+    int width, height;
+    uint8_t* wall;         // [célula], partilhado
+    uint8_t* portal;       // [célula], partilhado
+    char* content;         // [célula * K + slot]: ' ', 'P' ou 'M'
+    uint8_t* dot;          // [célula * K + slot]
+    agent_lanes_t* pac;
+    agent_lanes_t* ghost;
+    int32_t* status;       // sim_outcome_t de cada slot
+    int32_t* ticks;        // jogadas feitas por cada slot
+    // As lanes que ainda jogam ficam nos primeiros 'active' slots e os kernels só
+    // passam por esses; lane[s] é a lane no slot s e slot[k] o slot da lane k
+    int active;
+    int32_t *lane, *slot;
+    int32_t *dx, *dy, *act; // Temporários dos kernels
+    int32_t *word, *from, *cell, *seen;
+    void* arena;
+} batch_t;
+
+/* Prepara K lanes a partir de level; a lane k usa a semente seed + k,
+   tal como um clone com board_seed(clone, seed + k) */
+int batch_init(batch_t* batch, const board_t* level, int K, uint32_t seed);
+void batch_free(batch_t* batch);
+
+/* Avança uma jogada em todas as lanes ativas; devolve quantas continuam */
+int batch_step(batch_t* batch);
+
+/* Compara lane a lane, jogada a jogada, com K clones escalares (sim_step).
+   Devolve 0 se coincidirem; senão escreve a primeira diferença em err */
+int batch_verify(const board_t* level, int K, int ticks, uint32_t seed, char* err, size_t err_len);
+
+/* Modo "--batch <dir> [K] [ticks]": verifica e mede o débito contra K board_t */
+int batch_main(int argc, char** argv);
+
+#endif
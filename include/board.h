@@ -6,11 +6,32 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "script.h"
 
 #define MAX_MOVES 100 // Aumentado para suportar ficheiros maiores
 #define MAX_LEVELS 20
 #define MAX_FILENAME 256
-#define MAX_GHOSTS 25
+#define MAX_GHOSTS 4096
+#define MAX_PACMANS 64
+#define MAX_PLAYERS 2 // Pacmans controlados pelo teclado (W/A/S/D e I/J/K/L)
+#define MAX_NESTS 64  // Ninhos de fantasmas (NINHO) por nível
+#define MAX_BOARD_DIM 65535 // Largura e altura máximas (width * height cabe em 32 bits)
+
+// O tabuleiro é guardado em blocos de 4096 casas (64x64 ou 4096x1, conforme o layout)
+#define BOARD_CHUNK_BITS 12
+#define BOARD_CHUNK_CELLS (1 << BOARD_CHUNK_BITS)
+#define BOARD_TILE_SHIFT 6 // Lado dos blocos quadrados: 64
+
+/* Ordem das casas na memória, escolhida ao carregar o nível */
+typedef enum {
+    BOARD_LAYOUT_TILED = 0,  // Blocos 64x64, por linhas dentro do bloco
+    BOARD_LAYOUT_MORTON = 1, // Blocos 64x64, em ordem Z (Morton) dentro do bloco
+    BOARD_LAYOUT_ROWS = 2,   // Faixas de 4096x1: o tabuleiro fica por linhas (y * width + x)
+    BOARD_N_LAYOUTS
+} board_layout_t;
 
 typedef enum {
     REACHED_PORTAL = 1,
@@ -19,68 +40,314 @@ typedef enum {
     DEAD_PACMAN = -2,
 } move_t;
 
-typedef struct {
-    char command;
-    int turns;
-    int turns_left;
-} command_t;
+/* Estado de um nível: GAME_RUNNING até acabar; os outros valores são o desfecho */
+typedef enum {
+    GAME_RUNNING = 0,
+    GAME_WON = 1,
+    GAME_DEAD = 2,
+    GAME_QUIT = 3,
+    GAME_RELOAD = 4,  // O .lvl foi gravado: o nível recomeça lido de novo
+} game_state_t;
 
 typedef struct {
     int pos_x, pos_y; 
     int alive; 
     int points; 
     int passo; 
-    command_t moves[MAX_MOVES];
-    int current_move;
+    command_t moves[MAX_MOVES]; // Script tal como foi lido
     int n_moves; 
+    script_op_t code[MAX_MOVES]; // Script compilado
+    int n_code;
+    int pc;               // Instrução atual de code
+    int left;             // Jogadas de ação que faltam à instrução atual
     int waiting;
+    int start_x, start_y; // Posição declarada no ficheiro (antes de correções)
+    uint32_t rng;         // Estado do gerador aleatório deste agente ('R')
+    int player;           // Jogador do teclado que o controla (-1 = script ou parado)
+    _Atomic char next_cmd; // Comando manual pendente (escrito pela UI, tirado pela thread de jogo)
 } pacman_t;
 
 typedef struct {
     int pos_x, pos_y; 
     int passo; 
-    command_t moves[MAX_MOVES];
+    command_t moves[MAX_MOVES]; // Script tal como foi lido
     int n_moves; 
-    int current_move;
+    script_op_t code[MAX_MOVES]; // Script compilado
+    int n_code;
+    int pc;               // Instrução atual de code
+    int left;             // Jogadas de ação que faltam à instrução atual
     int waiting;
     int charged;
+    int start_x, start_y; // Posição declarada no ficheiro (antes de correções)
+    uint32_t rng;         // Estado do gerador aleatório deste agente ('R')
+    int active;           // 0 = vaga livre (fora do tabuleiro, fica na última casa)
+    int nest;             // Ninho da vaga (-1 = fantasma do MON, a vaga nunca é reutilizada)
+    uint32_t gen;         // Geração da vaga: sobe sempre que o fantasma sai (ghost_handle_t)
+    int leaving;          // Sai no fim desta jogada (está em board->leaving)
 } ghost_t;
 
+/* Ninho de fantasmas (linha "NINHO <y> <x> <ficheiro.m> <max>"): no fim de cada
+   jogada nasce lá um fantasma com o script do ficheiro se a casa está livre e o
+   ninho tem menos de max vivos. As vagas são reservadas ao carregar */
+typedef struct {
+    int x, y;
+    int slots;            // Vagas do ninho: ghosts[first .. first + slots)
+    int max;              // Limite de vivos (começa em slots; pode baixar durante o jogo)
+    int first;
+    int n_free;           // Vagas livres: min-heap em board->free_slots + (first - spawn_base)
+    char file[256];
+} nest_t;
+
+/* Uma casa é uma palavra de 16 bits alinhada: move_pacman / move_ghost trocam-na
+   inteira com compare-and-swap (conteúdo e ponto ao mesmo tempo) */
 typedef struct {
-    char content;   
-    int has_dot;    
-    int has_portal; 
+    _Alignas(uint16_t) char content; // 'W', 'P', 'M' ou ' '
+    uint8_t has_dot : 1;
+    uint8_t has_portal : 1;
 } board_pos_t;
 
+/* Movimento pretendido por um agente numa jogada (fase de decisão) */
+typedef struct {
+    int move;       // 0 = não se mexe nesta jogada (passo, 'T', 'C' ou comando inválido)
+    char direction; // 'W', 'A', 'S' ou 'D' (já resolvido quando o comando é 'R')
+    int dx, dy;
+    int charged;    // Fantasma carregado: desliza até colidir
+} intent_t;
+
 typedef struct {
     int width, height;      
-    board_pos_t* board;     
+    board_pos_t** chunks;   // [chunks_y * chunks_x] Blocos por linhas; os só de parede partilham board_wall_chunk
+    int chunks_x, chunks_y;
+    int layout;             // board_layout_t
+    int chunk_shift_x, chunk_shift_y; // Um bloco tem 2^shift_x x 2^shift_y casas
     int n_pacmans;          
     pacman_t* pacmans;      
     int n_ghosts;           
     ghost_t* ghosts;        
     char level_name[256];   
-    char pacman_file[256];  
-    char ghosts_files[MAX_GHOSTS][256]; 
+    char pacman_files[MAX_PACMANS][256];
+    char (*ghosts_files)[256]; // [n_ghosts] Alocado pelo parse_level (MON pode ter milhares)
     int tempo;              
+    int map_rows;           // Linhas de mapa lidas (para comparar com DIM)
+    int map_bad_rows;       // Linhas de mapa com largura diferente de DIM
+    uint32_t seed;          // Semente dos geradores dos agentes
+    uint64_t hash;          // Hash Zobrist do estado, mantido pelas funções de movimento
+    struct traj_set* trajs; // Trajetórias pré-calculadas dos fantasmas (traj.h); os clones partilham-nas
+    nest_t* nests;          // [n_nests] Ninhos; as suas vagas vêm depois dos fantasmas do MON
+    int n_nests;
+    int spawn_base;         // Primeira vaga de ninho (= número de fantasmas do MON)
+    int* free_slots;        // [n_ghosts - spawn_base] Vagas livres de cada ninho
+    int* leaving;           // [n_ghosts] Fantasmas que saem no fim desta jogada
+    int n_leaving;
     
     // --- NOVO EXERCÍCIO 3 ---
     pthread_mutex_t board_lock; // O cadeado para proteger o tabuleiro
-    int game_running;           // Flag: 1 = Jogo corre, 0 = Jogo deve parar
-    char next_pacman_cmd; 
-    int save_request;      // Comunicação entre Main (Teclado) e Thread Pacman
+    atomic_int state;           // game_state_t: só sai de GAME_RUNNING uma vez (board_finish)
+    atomic_int save_request;    // Comunicação entre a thread de jogo ('G') e a UI
     // ------------------------
-    int exit_status;
+    pthread_mutex_t wake_lock;  // A thread de jogo dorme em wake entre jogadas (board_sleep_until)
+    pthread_cond_t wake;
+    int wake_pending;           // board_wake chegou antes de a thread adormecer
     pthread_mutex_t* row_locks; // Array dinâmico: tamanho = board->height
     pthread_mutex_t global_stats_lock;
 } board_t;
 
+/*Sparse cell storage: the board is a grid of chunks of BOARD_CHUNK_CELLS cells
+  (64x64 tiles, or 4096x1 strips for BOARD_LAYOUT_ROWS). A chunk with no open cell is never allocated, its slot points to the
+  shared read-only board_wall_chunk; a real chunk is allocated (as walls) the
+  first time the loader writes an open cell into it. Walls never change while
+  playing, so every write during a game lands in a real chunk and the chunk
+  table itself is read-only after loading*/
+extern board_pos_t board_wall_chunk[BOARD_CHUNK_CELLS];
+
+/*Layout used by the next boards allocated (board_alloc_cells, load_level). Until it
+  is set, the environment variable PACMANIST_LAYOUT=tiled|morton|rows chooses it
+  (default: morton)*/
+void board_set_layout(int layout);
+int board_default_layout(void);
+const char* board_layout_name(int layout);
+int board_parse_layout(const char* name); // -1 se o nome não for um layout
+
+/*Allocates the chunk table for width x height in the default layout (every chunk =
+  walls). -1 if the dimensions are invalid or out of memory*/
+int board_alloc_cells(board_t* board, int width, int height);
+int board_alloc_cells_layout(board_t* board, int width, int height, int layout);
+void board_free_cells(board_t* board);
+
+/*Number of real (allocated) chunks*/
+size_t board_chunks_used(const board_t* board);
+
+/*Chunk (cx, cy) of the table*/
+static inline board_pos_t* board_chunk(const board_t* board, int cx, int cy) {
+    return board->chunks[(size_t)cy * board->chunks_x + cx];
+}
+
+/*Bits of a 6-bit coordinate spread to the even positions (Morton order in a tile)*/
+extern const uint16_t board_morton_spread[1 << BOARD_TILE_SHIFT];
+
+/*Cell (x, y), which must be inside the board, for reading. All-wall chunks are one
+  chunk shared by every board, so writes go through board_at_mut*/
+static inline const board_pos_t* board_at(const board_t* board, int x, int y) {
+    int sx = board->chunk_shift_x, sy = board->chunk_shift_y;
+    const board_pos_t* chunk = board_chunk(board, x >> sx, y >> sy);
+    if (board->layout == BOARD_LAYOUT_MORTON)
+        return &chunk[board_morton_spread[x & 63] | board_morton_spread[y & 63] << 1];
+    return &chunk[((y & ((1 << sy) - 1)) << sx) | (x & ((1 << sx) - 1))];
+}
+
+/*Cell (x, y) for writing: allocates its chunk if it is still the shared wall
+  chunk. NULL if out of memory. A cell that is not a wall is never in the shared
+  chunk, so writing it allocates nothing (safe from several threads)*/
+board_pos_t* board_at_mut(board_t* board, int x, int y);
+
 /*Makes the current thread sleep for 'int milliseconds' miliseconds*/
 void sleep_ms(int milliseconds);
 
-/*Processes a command for Pacman or Ghost(Monster)*/
-int move_pacman(board_t* board, int pacman_index, command_t* command);
-int move_ghost(board_t* board, int ghost_index, command_t* command);
+/*Next pseudo-random number from an agent's private generator (xorshift32).
+  Inline so that the batch kernels draw exactly the same sequence*/
+static inline uint32_t agent_rand(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/*Seeds every agent's generator from a single board seed (same seed = same game)*/
+void board_seed(board_t* board, uint32_t seed);
+
+/*Copies the game state of src into dst, reusing dst's buffers when the sizes match.
+  dst must be zeroed or a previous clone. The clone has no row locks and must be
+  stepped by a single thread*/
+int board_clone(board_t* dst, const board_t* src);
+void board_free_clone(board_t* clone);
+
+/*Zobrist hash of the full game state (agent positions, script cursors, waiting,
+  charged, remaining dots). The move functions keep board->hash up to date
+  incrementally; board_rehash recomputes it from scratch*/
+uint64_t board_hash_full(const board_t* board);
+void board_rehash(board_t* board);
+
+/*Instruction the agent runs next: its script's current op, or NULL without a script*/
+const script_op_t* pacman_op(const board_t* board, int pacman_index);
+const script_op_t* ghost_op(const board_t* board, int ghost_index);
+
+/*Processes an instruction for Pacman or Ghost(Monster): plan + resolve.
+  op is the agent's current op (pacman_op/ghost_op) or a one-tick op for an agent
+  without a script (keyboard, wandering ghost). The caller owns the board*/
+int move_pacman(board_t* board, int pacman_index, const script_op_t* op);
+int move_ghost(board_t* board, int ghost_index, const script_op_t* op);
+
+/*The same on a board where several threads move agents at once (each agent moved
+  by one thread only). No lock is taken: the target cell is claimed with a
+  compare-and-swap on the cell word, then the old cell is released, so agents on
+  the same rows move in parallel; a dot is eaten and a Pacman killed exactly once.
+  Experimental: only --cas-stress uses it. The game and the tick engine resolve
+  with move_pacman / move_ghost (row mutexes in the parallel resolve), whose
+  order is deterministic*/
+int move_pacman_shared(board_t* board, int pacman_index, const script_op_t* op);
+int move_ghost_shared(board_t* board, int ghost_index, const script_op_t* op);
+
+/*Two-phase move. plan_* only touches the agent's own state (passo, script cursor,
+  instruction counter, generator) and fills the intent, so every agent can be planned in
+  parallel. resolve_* applies the intent to the board (walls, collisions, dots,
+  deaths) and takes no locks: the caller must own the board*/
+int plan_pacman(board_t* board, int pacman_index, const script_op_t* op, intent_t* intent);
+int plan_ghost(board_t* board, int ghost_index, const script_op_t* op, intent_t* intent);
+int resolve_pacman(board_t* board, int pacman_index, const intent_t* intent);
+int resolve_ghost(board_t* board, int ghost_index, const intent_t* intent);
+
+/*Rows [*top, *bottom] that resolve_ghost may read or write for this intent (the
+  ghost's row and its target, or for a charged vertical move every row up to the
+  first wall). Ghosts whose rows do not overlap can be resolved in any order*/
+void ghost_footprint_rows(const board_t* board, int ghost_index, const intent_t* intent, int* top, int* bottom);
+
+/*Puts a ghost straight into a later state of its own script (a precomputed
+  trajectory): moves its 'M' and keeps board->hash up to date. The caller
+  guarantees that no other agent touched its cells in the meantime*/
+void place_ghost(board_t* board, int ghost_index, int x, int y, int pc, int left, int waiting, int charged);
+
+/*Skips the Pacman's current script instruction (used for 'G')*/
+void skip_pacman_command(board_t* board, int pacman_index);
+
+/*Number of upcoming ticks in which plan_* would only wait (passo countdown or a
+  wait op that is not on its last turn) for a script-driven agent. 'G' and 'Q' act
+  immediately, so a Pacman on one of them has 0 idle ticks*/
+long pacman_idle_ticks(const board_t* board, int pacman_index);
+long ghost_idle_ticks(const board_t* board, int ghost_index);
+
+/*Applies n of those idle ticks at once (n <= *_idle_ticks): same state and hash as
+  n calls to plan_* with the current instruction*/
+void skip_pacman_ticks(board_t* board, int pacman_index, long n);
+void skip_ghost_ticks(board_t* board, int ghost_index, long n);
+
+/*Handle of a ghost: its slot and the slot's generation. A ghost that leaves the
+  board bumps the generation, so an old handle never reaches the ghost that later
+  reuses the slot*/
+typedef uint32_t ghost_handle_t;
+#define GHOST_NONE UINT32_MAX
+#define GHOST_SLOT_BITS 12 // MAX_GHOSTS = 1 << GHOST_SLOT_BITS
+
+/*Handle of the ghost in slot g (GHOST_NONE if the slot is free)*/
+ghost_handle_t ghost_handle(const board_t* board, int g);
+
+/*Slot of a live ghost, or -1 if the handle is stale*/
+int ghost_slot(const board_t* board, ghost_handle_t handle);
+
+/*Asks the ghost to leave the board at the end of the next tick (as if it ran 'X').
+  -1 if the handle is stale*/
+int despawn_ghost(board_t* board, ghost_handle_t handle);
+
+/*End of a tick in which the ghosts played: the ghosts that ran 'X' (or were asked to
+  leave) leave, in board->leaving order, then each nest in turn spawns a ghost in its
+  lowest free slot if its cell is empty. Never allocates. Writes the new slots to
+  spawned (room for n_nests, may be NULL) and returns how many there are*/
+int board_end_tick(board_t* board, int* spawned);
+
+/*Rebuilds the free slots of the nests from the ghosts' active flags (after the
+  ghosts were restored, e.g. by the journal). The free lists are min-heaps, so the
+  slot a nest uses next depends only on which slots are free*/
+void board_rebuild_slots(board_t* board);
+
+/*1 if the ghost count can change while playing (nests or a ghost script with 'X')*/
+int board_has_spawning(const board_t* board);
+
+/*Initializes (or, in the child of a fork, re-creates) the lock and condition the game
+  thread sleeps on. The condition waits on CLOCK_MONOTONIC, like the tick clock*/
+int board_init_wake(board_t* board);
+void board_destroy_wake(board_t* board);
+
+/*1 while the level is GAME_RUNNING*/
+int board_running(board_t* board);
+
+/*Ends the level with the given outcome (game_state_t). Only the first call changes the
+  state (returns 1; later calls return 0); it also wakes the game thread, so the level
+  stops without waiting for the end of a tick's sleep*/
+int board_finish(board_t* board, int state);
+
+/*Wakes the game thread if it is sleeping between ticks; if it is not, its next sleep
+  returns at once (a request is never lost)*/
+void board_wake(board_t* board);
+
+/*Sleeps until the absolute CLOCK_MONOTONIC deadline (NULL = none) or until board_wake.
+  Returns 1 if it was woken, 0 if the deadline passed*/
+int board_sleep_until(board_t* board, const struct timespec* deadline);
+
+/*Takes/releases every row lock (in increasing order). Only whole-board operations
+  (drawing, saving, a tick of the tick engine) take them*/
+void lock_all_rows(board_t* board);
+void unlock_all_rows(board_t* board);
+
+/*Sum of every Pacman's points (the team score)*/
+int board_points(const board_t* board);
+
+/*Number of Pacmans driven by the keyboard*/
+int board_players(const board_t* board);
+
+/*Hands a movement key to the Pacman of that player (W/A/S/D = player 0,
+  I/J/K/L = player 1); the tick engine consumes it on the next tick*/
+void board_send_input(board_t* board, char key);
 
 /*Process the death of a Pacman*/
 void kill_pacman(board_t* board, int pacman_index);
@@ -90,7 +357,8 @@ void kill_pacman(board_t* board, int pacman_index);
    level_file: name of the .lvl file
 */
 
-int get_board_index(board_t* board, int x, int y);
+/*Linear index y * width + x of a cell (for hashes and wire formats, not storage)*/
+size_t get_board_index(const board_t* board, int x, int y);
 
 /*Unloads levels loaded by load_level*/
 
@@ -9,17 +9,35 @@
 #define DRAW_WIN 1
 #define DRAW_MENU 2
 
+// Backends do ecrã
+#define DISPLAY_NCURSES 0
+#define DISPLAY_ANSI 1
+
 
 /*
 Potential Structures for ncurses
 */
 
+/*Choose the backend before terminal_init. By default it is ncurses, or ANSI if
+the environment has PACMANIST_DISPLAY=ansi*/
+void display_set_backend(int backend);
+
 /*Initialize everything ncurses requires*/
 int terminal_init();
 
-/*Draw the board on the screen*/
+/*Clear the whole screen (takes effect on the next refresh_screen)*/
+void clear_screen();
+
+/*Write a formatted line of text with colour i at the start of a row, clearing the rest of the row*/
+void draw_text(int row, int colour_i, const char* format, ...);
+
+/*Draw the board on the screen. Boards larger than the screen are drawn through a
+viewport that follows the Pacman, so the cost depends on the screen size*/
 void draw_board(board_t* board, int mode);
 
+/*Show/hide the minimap drawn over the viewport when the board does not fit (key N)*/
+void toggle_minimap();
+
 /*Add a specific character with colour i into position (pos_x,pos_y) of the creen
 Pre loaded colours:
 1- Yellow
@@ -40,4 +58,21 @@ char get_input();
 
 void terminal_cleanup();
 
+/* Backend ANSI (display_ansi.c): chamado pelas funções acima, não usar diretamente.
+   Cada frame é composto num buffer pré-alocado, com as escapes de cor só onde a cor
+   muda, e sai num único write() */
+#define ANSI_BOLD 1
+#define ANSI_DIM 2
+int ansi_terminal_init();
+void ansi_clear();
+void ansi_put(int row, int col, char c, int colour_i, int style);
+void ansi_text(int row, int colour_i, const char* text);
+size_t ansi_refresh();
+void ansi_size(int* rows, int* cols);
+int ansi_getch();
+void ansi_terminal_cleanup();
+
+/* Modo "--render-bench <dir> [frames]": mede tempo e bytes por frame dos dois backends */
+int render_bench_main(int argc, char** argv);
+
 #endif
\ No newline at end of file
@@ -4,12 +4,69 @@
 #include "board.h"
 #include <dirent.h>
 
-/* Carrega um nível a partir de ficheiros para a estrutura board */
+/* Lê um nível a partir de ficheiros para a estrutura board, sem validação */
+int parse_level(board_t* board, const char* dir_path, const char* level_file, int accumulated_points);
+
+/* Carrega um nível (parse_level + análise estática); rejeita níveis com erros */
 int load_level(board_t* board, const char* dir_path, const char* level_file, int accumulated_points);
 
 void unload_level(board_t * board);
 
+/* Um ficheiro de um nível guardado em memória */
+typedef struct {
+    char name[256];
+    char* data;       // Do pacote (libertado por bundle_free)
+    size_t len;
+} bundle_file_t;
+
+/* Um nível e os ficheiros de agentes que usa, em memória em vez de numa
+   diretoria (ex.: recebidos por uma stream, ver stream.h) */
+typedef struct {
+    bundle_file_t* files;
+    int n_files, cap;
+} level_bundle_t;
+
+/* Junta ao pacote o ficheiro name com data (que passa a ser do pacote). -1 sem memória */
+int bundle_add_file(level_bundle_t* bundle, const char* name, char* data, size_t len);
+void bundle_free(level_bundle_t* bundle);
+
+/* Como load_level, mas o nível e os agentes vêm do pacote (um ficheiro em falta
+   conta como ilegível) */
+int load_level_bundle(board_t* board, const level_bundle_t* bundle, const char* level_file, int accumulated_points);
+
 /* Filtro para o scandir encontrar ficheiros .lvl */
 int filter_levels(const struct dirent *entry);
 
+/* Passa o nível carregado em src para dst (já descarregado ou nunca carregado);
+   src deixa de ser usado. Os cadeados embutidos são criados de novo em dst */
+void move_level(board_t* dst, board_t* src);
+
+/* Um ficheiro de agente (.m ou .p) lido e compilado uma só vez, para trocar o
+   script dos agentes de um nível que o usam sem voltar a ler o nível */
+typedef struct {
+    char file[256];
+    int start_x, start_y;             // POS do ficheiro (-1 se não tem)
+    int passo;
+    command_t moves[MAX_MOVES];
+    int n_moves;
+    script_op_t ghost_code[MAX_MOVES]; // Compilado para fantasma e para Pacman
+    script_op_t pacman_code[MAX_MOVES];
+    int n_ghost_code, n_pacman_code;  // -1 se não compila para esse agente
+    char ghost_err[128], pacman_err[128];
+} agent_script_t;
+
+/* Lê e compila dir_path/file. -1 se o ficheiro não se lê */
+int load_agent_script(agent_script_t* script, const char* dir_path, const char* file);
+
+/* Troca o script dos agentes de board que usam script->file (os Pacmans dos
+   jogadores ficam com o teclado): recomeçam o script do início onde estão.
+   Devolve quantos agentes mudaram, ou -1 sem mudar nada se o script não compila
+   para algum deles (err fica com o erro). *moved = 1 se a POS do ficheiro mudou,
+   o que só conta quando o nível volta a ser lido. As trajetórias (board->trajs)
+   ficam por refazer */
+int swap_agent_script(board_t* board, const agent_script_t* script, int* moved, char* err, size_t err_len);
+
+/* O nível usa o ficheiro de agente file */
+int level_uses_file(const board_t* board, const char* file);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "board.h"
+
+/* Jornal das últimas jogadas, para voltar atrás sem copiar o tabuleiro.
+   Cada registo guarda só o que a jogada mudou, com os valores de antes: as casas
+   alteradas e o estado dos agentes que mudaram (posição, cursor do script,
+   contadores, carga, gerador, pontos, vivo, vaga ocupada), mais o hash. Voltar
+   atrás k jogadas aplica os k registos mais recentes ao contrário, por isso custa
+   o que essas jogadas mudaram e não o tamanho do tabuleiro.
+
+   As casas que uma jogada pode mudar são sempre as de partida e de chegada dos
+   agentes que mudaram; o jornal guarda as casas debaixo de cada agente no fim da
+   jogada anterior para saber o valor de antes. Uma casa sem agentes só pode ter
+   ' ' (ou parede) e perde o ponto quando um Pacman o come.
+
+   Os registos ficam num anel de bytes limitado em jogadas e em bytes: quando
+   enche, os mais antigos saem. A memória é a do anel mais o estado de cada agente
+   (O(agentes)), nunca uma cópia do tabuleiro. */
+
+#define JOURNAL_DEFAULT_TICKS 1024
+#define JOURNAL_DEFAULT_BYTES (8u << 20)
+
+typedef struct journal journal_t;
+
+/* Jornal vazio para board, que está no estado da jogada 'tick'. max_ticks / max_bytes
+   <= 0 usam os valores por omissão. NULL sem memória */
+journal_t* journal_create(const board_t* board, long tick, int max_ticks, size_t max_bytes);
+void journal_free(journal_t* journal);
+
+/* Esquece o histórico: board (noutro nível, ou reposto de um save) passa a ser o
+   início, na jogada 'tick' */
+int journal_reset(journal_t* journal, const board_t* board, long tick);
+
+/* Regista o que mudou desde o registo anterior; board está agora na jogada 'tick'
+   (pode ter avançado várias jogadas, ex.: jogadas sem ninguém a agir). O estado dos
+   agentes tem de estar em dia (tick_sync no jogo ao vivo). -1 se o registo não
+   cabe no anel: o histórico é esquecido, mas o jornal continua a seguir o tabuleiro */
+int journal_record(journal_t* journal, const board_t* board, long tick);
+
+/* Volta à jogada registada mais recente que seja <= tick (ou à mais antiga que ainda
+   houver). Devolve a jogada em que o tabuleiro ficou */
+long journal_rewind(journal_t* journal, board_t* board, long tick);
+
+/* Jogada mais antiga a que ainda se pode voltar e a atual */
+long journal_oldest(const journal_t* journal);
+long journal_tick(const journal_t* journal);
+
+/* Bytes ocupados pelos registos */
+size_t journal_bytes(const journal_t* journal);
+
+/* Modo "--rewind <dir> [ticks] [depth]": joga cada nível sem ecrã com o jornal,
+   volta atrás a jogadas ao acaso e confirma o estado (e que o jogo refeito dali é
+   igual); mede o custo de voltar atrás contra o de copiar o tabuleiro */
+int journal_main(int argc, char** argv);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include "board.h"
+#include <stdio.h>
+
+#define MC_HIST_BINS 10
+
+/* Estimativa de Monte Carlo do desfecho de um nível com comandos 'R':
+   o nível é clonado para cada corrida e jogado headless com outra semente. */
+
+typedef struct {
+    int runs;
+    int wins, deaths, quits, timeouts;
+    int max_ticks;
+
+    // Jogadas até ao portal (só corridas ganhas)
+    int ticks_min, ticks_p50, ticks_p90, ticks_max;
+    double ticks_mean;
+    int hist[MC_HIST_BINS];   // Histograma de [ticks_min, ticks_max]
+
+    // Pontos no fim da corrida (todas as corridas)
+    int points_min, points_p50, points_max;
+    double points_mean;
+} mc_stats_t;
+
+/* Joga 'runs' clones de level em paralelo (n_threads) com sementes seed, seed+1, ...
+   -1 se faltou memória (incluindo para o clone de alguma corrida): stats não vale */
+int montecarlo_estimate(const board_t* level, int runs, int max_ticks, uint32_t seed,
+                        int n_threads, mc_stats_t* stats);
+
+void print_mc_stats(FILE* out, const char* level_name, const mc_stats_t* stats);
+
+/* Modo "--montecarlo <dir> [runs] [max_ticks] [threads]" */
+int montecarlo_main(int argc, char** argv);
+
+#endif
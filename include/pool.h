@@ -0,0 +1,25 @@
+#ifndef POOL_H
+#define POOL_H
+
+/* Pool de threads reutilizável para trabalho "parallel for".
+   A thread que chama pool_parallel_for também participa no trabalho. */
+
+typedef void (*pool_task_fn)(void* ctx, int index);
+
+typedef struct pool pool_t;
+
+/* Cria um pool com n_threads trabalhadores no total (incluindo quem chama) */
+pool_t* pool_create(int n_threads);
+
+/* Executa fn(ctx, i) para i em [0, n) e só retorna quando todas terminarem */
+void pool_parallel_for(pool_t* pool, int n, pool_task_fn fn, void* ctx);
+
+/* Número de threads que o pool usa (incluindo quem chama) */
+int pool_size(const pool_t* pool);
+
+void pool_destroy(pool_t* pool);
+
+/* Número de cores disponíveis (mínimo 1) */
+int pool_default_threads(void);
+
+#endif
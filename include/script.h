@@ -0,0 +1,48 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Scripts dos agentes (.m/.p). O ficheiro é lido para command_t (a fonte, tal
+   como está escrita) e compilado ao carregar o nível para um bytecode já
+   validado: as direções trazem o (dx, dy), os 'T' seguidos são uma só espera
+   com a soma das voltas e um 'C' seguido de um movimento é uma só instrução.
+   O interpretador (plan_pacman/plan_ghost) só consulta a instrução atual. */
+
+typedef struct {
+    char command;
+    int turns;      // Voltas de 'T<n>' (1 nos outros comandos)
+} command_t;
+
+typedef enum {
+    OP_MOVE = 0,    // Um passo (dx, dy)
+    OP_RANDOM,      // Direção sorteada pelo gerador do agente ('R')
+    OP_WAIT,        // 'T': count jogadas de ação sem se mexer
+    OP_CHARGE,      // 'C' que não é seguido de um movimento
+    OP_SAVE,        // 'G' (só Pacman)
+    OP_QUIT,        // 'Q' (só Pacman)
+    OP_DESPAWN,     // 'X': o fantasma sai do tabuleiro no fim da jogada (só fantasmas)
+} script_opcode_t;
+
+typedef struct {
+    uint8_t op;     // script_opcode_t
+    uint8_t charge; // OP_MOVE/OP_RANDOM precedido de 'C': carrega na primeira jogada, move-se na segunda
+    int8_t dx, dy;
+    char direction; // 'W', 'A', 'S' ou 'D' (OP_MOVE)
+    int32_t count;  // Jogadas de ação que a instrução ocupa (o contador do agente começa aqui)
+} script_op_t;
+
+/* Compila os n comandos de src para code (no máximo n instruções). Um fantasma
+   aceita W/A/S/D/R/C/T/X, um Pacman W/A/S/D/R/T/G/Q. Devolve o número de instruções,
+   ou -1 com o primeiro comando inválido descrito em err */
+int script_compile(const command_t* src, int n, int is_ghost, script_op_t* code, char* err, size_t err_len);
+
+/* Instrução de um só passo na direção dada (tecla do jogador, fantasma sem
+   script). Uma direção que não seja W/A/S/D dá uma espera de uma jogada */
+script_op_t script_move(char direction);
+
+/* Instrução 'R' avulsa (fantasmas sem script no jogo ao vivo) */
+script_op_t script_random(void);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+/* Servidor local de jogos: um só processo aloja muitas sessões independentes.
+   Cada cliente liga-se a um socket Unix (SOCK_STREAM) e tem o seu próprio jogo,
+   que começa no primeiro nível da pasta e avança quando um Pacman chega ao portal.
+
+   Protocolo:
+   - Cliente -> servidor: um byte por tecla (W/A/S/D, I/J/K/L, G, Q; o resto é ignorado).
+   - Servidor -> cliente: um frame por jogada, em texto:
+         F <jogada> <largura> <altura> <pontos> <estado>\n
+         <altura linhas com largura caracteres: # C M . @ ou espaço>\n
+     <estado> é o nome do sim_outcome_t ("running", "win", "death", "quit").
+     Depois de um frame com estado diferente de "running" o servidor fecha a ligação.
+     Um cliente lento perde frames (recebe sempre o mais recente que couber).
+
+   Um único event loop (epoll) trata das ligações, do teclado dos clientes e de
+   um timerfd; as sessões cuja jogada venceu avançam em paralelo no pool. */
+
+/* Modo "--server <socket> <dir> [threads]" */
+int server_main(int argc, char** argv);
+
+/* Modo "--connect <socket>": cliente ncurses que desenha os frames e envia as teclas */
+int client_main(int argc, char** argv);
+
+#endif
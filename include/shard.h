@@ -0,0 +1,49 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "board.h"
+
+/* Simulação de um só tabuleiro enorme repartida por vários processos.
+   O estado do jogo (blocos de casas, Pacmans, fantasmas) é copiado para um
+   segmento de memória partilhada (shm_open + mmap) e cada processo trabalhador
+   (fork) fica dono de uma faixa de linhas, como nas faixas de tick_regions_t:
+   decide os fantasmas que começam a jogada na sua faixa e resolve os que não
+   saem dela, sem locks. Um fantasma cujas linhas (ghost_footprint_rows)
+   atravessam faixas é uma passagem: entra na fila de todas essas faixas e só é
+   resolvido, pela de cima, quando todas lá chegaram; as outras esperam que
+   acabe. As linhas vizinhas de outra faixa leem-se diretamente do segmento,
+   que é o mesmo para todos, por isso não há cópias de fronteira.
+
+   O processo coordenador joga os Pacmans (e as teclas), reparte o trabalho,
+   desenha e lê o teclado. As fases de cada jogada são separadas por uma
+   barreira partilhada entre processos (PTHREAD_PROCESS_SHARED):
+     coordenador: Pacmans       | -            | filas    | -         |
+     trabalhador: -             | decisão      | -        | resolução |
+   A ordem de resolução é a de sim_step (fantasmas por índice), por isso o
+   resultado é o mesmo jogada a jogada. */
+
+#define SHARD_MAX_WORKERS 64
+
+typedef struct shard shard_t;
+
+/* Copia o nível para um segmento novo e cria n_workers processos (<= 0 usa
+   pool_default_threads()). O nível continua a ser do chamador. NULL em erro ou
+   se o número de fantasmas pode mudar (board_has_spawning): as vagas dos
+   ninhos e as saídas não estão no segmento */
+shard_t* shard_open(const board_t* level, int n_workers);
+
+/* Tabuleiro no segmento: só o coordenador lhe mexe entre jogadas (desenho,
+   board_send_input) */
+board_t* shard_board(shard_t* shard);
+
+/* Joga uma jogada com as regras de sim_step; devolve um sim_outcome_t */
+int shard_step(shard_t* shard);
+
+/* Termina os trabalhadores e liberta o segmento */
+void shard_close(shard_t* shard);
+
+/* Modo "--shards <dir> [workers] [--verify ticks]": joga os níveis com o tabuleiro
+   repartido; com --verify joga sem ecrã ao lado de sim_step e compara o estado */
+int shard_main(int argc, char** argv);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include "board.h"
+#include "ttable.h"
+
+/* Simulação headless: uma thread avança o tabuleiro jogada a jogada,
+   com as mesmas regras de move_pacman/move_ghost mas sem ecrã nem sleeps. */
+
+typedef enum {
+    SIM_RUNNING = 0,
+    SIM_WIN = 1,     // Um Pacman chegou ao portal
+    SIM_DEATH = 2,   // Morreram todos os Pacmans
+    SIM_QUIT = 3,    // O script do Pacman executou 'Q'
+    SIM_TIMEOUT = 4, // Atingiu o limite de jogadas
+    SIM_CYCLE = 5,   // O estado repetiu-se: o jogo nunca vai terminar
+} sim_outcome_t;
+
+typedef struct {
+    int outcome;
+    int ticks;
+    int points;       // Soma dos pontos de todos os Pacmans
+    int cycle_start;  // SIM_CYCLE: jogada em que o ciclo começa
+    int cycle_length; // SIM_CYCLE: período do ciclo
+    int reused;       // 1 se o desfecho veio da tabela de transposição
+} sim_result_t;
+
+/* Avança uma jogada: primeiro os Pacmans, depois os fantasmas por ordem */
+int sim_step(board_t* board);
+
+/* As duas metades de sim_step, para quem reparte os fantasmas por vários
+   processos (shard.h): a jogada de todos os Pacmans (SIM_RUNNING se o jogo
+   continua) e a decisão de um fantasma, a resolver depois com resolve_ghost */
+int sim_step_pacmans(board_t* board);
+void sim_plan_ghost(board_t* board, int g, intent_t* intent);
+
+/* Limite de jogadas do modo --headless quando não é dado */
+#define SIM_DEFAULT_MAX_TICKS 100000
+
+/* Joga até haver um desfecho ou até max_ticks jogadas */
+void sim_run(board_t* board, int max_ticks, sim_result_t* result);
+
+/* Como sim_run, mas guarda cada estado na tabela de transposição: um estado
+   repetido na mesma corrida dá SIM_CYCLE e um estado resolvido numa corrida
+   anterior devolve logo o desfecho conhecido. Só se aplica a níveis
+   deterministas; nos outros comporta-se como sim_run */
+void sim_run_tt(board_t* board, int max_ticks, ttable_t* tt, sim_result_t* result);
+
+/* 1 se o nível não usa aleatoriedade ('R' ou fantasmas sem script) */
+int board_is_deterministic(const board_t* board);
+
+const char* sim_outcome_name(int outcome);
+
+/* Modo "--headless <dir> [max_ticks]": joga cada nível sem ecrã e mostra o veredicto */
+int sim_main(int argc, char** argv);
+
+/* Modo "--layout-bench <dir> [ticks]": joga cada nível com cada layout do tabuleiro
+   (mesma semente), confirma que o estado final é igual e compara o tempo por jogada
+   e o de percorrer as colunas */
+int layout_bench_main(int argc, char** argv);
+
+#endif
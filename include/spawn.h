@@ -0,0 +1,12 @@
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include "board.h"
+
+/* Modo "--spawn-bench <dir> [ticks]": joga cada nível com ninhos no motor, com o
+   limite dos ninhos a subir e a descer por fases (os fantasmas a mais saem por
+   despawn_ghost), e mede o custo por jogada contra o número de fantasmas vivos;
+   ao lado, um clone com sim_step tem de chegar aos mesmos hashes */
+int spawn_bench_main(int argc, char** argv);
+
+#endif
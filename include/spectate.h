@@ -0,0 +1,31 @@
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+#include "board.h"
+
+/* Transmissão do jogo para espectadores locais por memória partilhada.
+   O jogo é o único produtor de um anel (shm_open) onde escreve, a cada jogada,
+   um delta (casas que mudaram e agentes que se mexeram ou mudaram de pontos)
+   e, periodicamente, um keyframe com o estado completo. Qualquer número de
+   espectadores lê o anel sem locks: o produtor nunca espera por eles e um
+   leitor que fique para trás salta para o último keyframe. */
+
+typedef struct spec_pub spec_pub_t;
+
+/* Cria o anel "/<name>" (substitui um anterior com o mesmo nome) */
+spec_pub_t* spec_publish_open(const char* name);
+
+/* Publica o estado atual do tabuleiro: delta ou keyframe. Chamado pela thread
+   que avança o jogo, entre jogadas */
+void spec_publish(spec_pub_t* pub, const board_t* board);
+
+/* O próximo spec_publish escreve um keyframe (novo nível, restore de um save) */
+void spec_publish_reset(spec_pub_t* pub);
+
+/* Marca o anel como terminado e remove o nome; os espectadores saem */
+void spec_publish_close(spec_pub_t* pub);
+
+/* Modo "--spectate <name>": desenha o jogo publicado em <name> */
+int spectate_main(int argc, char** argv);
+
+#endif
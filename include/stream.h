@@ -0,0 +1,51 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "board.h"
+
+/* Níveis lidos de uma stream (stdin ou um FIFO) à medida que chegam, sem passar
+   por ficheiros no disco. A stream é uma sequência de níveis, cada um em quadros
+   de texto com o .lvl e os ficheiros de agentes que ele usa:
+
+     @@LEVEL nivel1.lvl
+     ... conteúdo do .lvl ...
+     @@FILE fantasma.m
+     ... conteúdo do ficheiro de agente ...
+     @@END
+
+   Os nomes dos @@FILE só valem dentro do seu nível. Nenhuma linha de um ficheiro
+   pode começar por "@@"; as linhas fora de um nível são ignoradas e um nível
+   cortado pelo fim da stream perde-se.
+
+   Uma thread lê os quadros e carrega cada nível (parse, análise estática e
+   trajetórias) até 'ahead' níveis à frente do que está a ser jogado: gerar, ler
+   e jogar sobrepõem-se, e quem joga só espera se a stream não acompanha. */
+
+#define STREAM_AHEAD 4
+
+typedef struct level_stream level_stream_t;
+
+/* Abre path ("-" = stdin; um FIFO espera aqui por quem escreva) e começa a ler.
+   NULL se não abre */
+level_stream_t* stream_open(const char* path, int ahead);
+
+/* Próximo nível por ordem, à espera que chegue. 0: o nível passou para board
+   (move_level); 1: o nível foi rejeitado (board não muda); -1: fim da stream.
+   name (se não é NULL) fica com o nome do nível */
+int stream_next(level_stream_t* stream, board_t* board, char* name, size_t name_len);
+
+/* Pára a leitura (mesmo à espera de dados) e liberta os níveis por jogar */
+void stream_close(level_stream_t* stream);
+
+/* Save com fork: a fila não muda durante o fork (freeze / thaw à volta). No filho,
+   stream_detach deixa a stream para o pai: o filho joga só os níveis que já
+   estavam carregados e depois vê o fim da stream */
+void stream_freeze(level_stream_t* stream);
+void stream_thaw(level_stream_t* stream);
+void stream_detach(level_stream_t* stream);
+
+/* Modo "--headless --stream <fifo|-> [max_ticks]": joga sem ecrã cada nível que
+   chega, como --headless, e mostra quanto tempo a simulação esperou pela stream */
+int stream_sim_main(int argc, char** argv);
+
+#endif
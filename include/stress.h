@@ -0,0 +1,23 @@
+#ifndef STRESS_H
+#define STRESS_H
+
+#include "board.h"
+
+/* Agentes mexidos por várias threads ao mesmo tempo no mesmo tabuleiro, com
+   move_pacman_shared / move_ghost_shared (compare-and-swap na casa, sem locks).
+   Cada thread é dona de uma parte dos agentes e mexe-os ao acaso (passos e
+   cargas) num campo aberto cheio de pontos. No fim confirma os invariantes que
+   o caminho sem locks promete:
+     - um 'M' por fantasma, na casa de cada um;
+     - um 'P' por Pacman vivo, na casa de cada um;
+     - pontos comidos = pontos dos Pacmans (nenhum ponto comido duas vezes);
+     - o hash incremental igual ao hash calculado de raiz (board_hash_full).
+   O caminho com compare-and-swap é experimental: só este modo o usa; o jogo e o
+   motor de ticks continuam a resolver com move_pacman / move_ghost. */
+
+/* Modo "--cas-stress [threads] [moves] [runs]": moves jogadas por thread em cada
+   uma de runs corridas, com pelo menos 2 threads por omissão (com uma só não há
+   corridas entre threads para apanhar); exit code 2 se algum invariante falhar */
+int cas_stress_main(int argc, char** argv);
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef TICK_H
+#define TICK_H
+
+#include "board.h"
+#include "pool.h"
+#include <time.h>
+#include <limits.h>
+
+/* Jogada em duas fases para o jogo ao vivo. Na fase de decisão todos os
+   agentes calculam a intenção em paralelo (só mexem no próprio estado); na
+   fase de resolução as intenções são aplicadas pela ordem fixa (Pacmans e
+   depois fantasmas, por índice): os Pacmans numa thread e os fantasmas por
+   regiões do tabuleiro em paralelo (tick_regions_t), sem mudar o resultado. Por
+   isso o resultado não depende de quem ganha os locks e é igual ao de sim_step.
+
+   Os agentes de script só entram numa jogada quando agem: enquanto esperam (passo
+   ou 'T') ficam numa agenda (min-heap pela jogada em que voltam a agir) e as
+   jogadas de espera são aplicadas de uma vez quando acordam. Os Pacmans dos
+   jogadores entram sempre (uma tecla pode chegar a qualquer momento). Os
+   fantasmas que saem deixam a agenda e os que nascem num ninho entram nela no
+   fim da jogada (board_end_tick). */
+
+/* Fase de resolução dos fantasmas por regiões. O tabuleiro é cortado em faixas
+   de linhas (retângulos da largura toda), uma por thread. Um fantasma cujas
+   linhas (ghost_footprint_rows) cabem numa faixa vai para a fila dessa faixa, que
+   a sua thread resolve por índice sem locks; um que atravessa faixas (mudança de
+   faixa ou carga vertical) passa para a fila de passagem e é resolvido sozinho,
+   depois do que as suas faixas já tinham e antes do que vem a seguir nelas. Os
+   fantasmas de faixas diferentes não se tocam, por isso o resultado é o da ordem
+   por índice. As fronteiras acompanham a densidade de fantasmas. */
+typedef struct {
+    int n;                // Número de faixas (1 = resolução numa só thread)
+    int* top;             // [n + 1] Primeira linha de cada faixa; top[n] = height
+    int* level;           // [n] Próximo nível livre de cada faixa ao distribuir
+    int* load;            // [n] Fantasmas resolvidos dentro de cada faixa nesta jogada
+    int* key;             // [n_ghosts] Nível * (n + 1) + fila de cada fantasma que se move
+    int* agent;           // [n_ghosts] Agente de cada entrada de key
+    int* items;           // [n_ghosts] Agentes por (nível, fila); a fila n é a de passagem
+    int* bucket;          // Início de cada (nível, fila) em items
+    int bucket_cap;
+    int* rows;            // [n_ghosts] Linhas dos fantasmas (para reequilibrar)
+    int current;          // Nível que as tarefas da pool estão a resolver
+    long since_rebalance; // Jogadas desde o último reequilíbrio
+    long handoffs;        // Fantasmas que passaram pela fila de passagem (estatística)
+    long rebalances;
+} tick_regions_t;
+
+typedef struct {
+    board_t* board;
+    pool_t* pool;
+    int n_tasks;          // Blocos de agentes na fase de decisão
+    const script_op_t** ops; // Instrução de cada agente nesta jogada (NULL = não joga)
+    intent_t* intents;    // [n_pacmans + n_ghosts]
+    script_op_t keyboard[MAX_PLAYERS]; // Tecla de cada jogador
+    script_op_t wander;   // Fantasmas sem script: 'R'
+    long tick;            // Próxima jogada a jogar
+    long* wake;           // [n_agents] Jogada em que o agente volta a agir (-1 = fora da agenda)
+    long* last;           // [n_agents] Última jogada já aplicada ao estado do agente
+    int* heap;            // Agentes na agenda, min-heap por (wake, índice)
+    int heap_len;
+    int* due;             // Agentes que jogam nesta jogada, por índice
+    int n_due;
+    int* spawned;         // [n_nests] Vagas dos fantasmas que nasceram nesta jogada
+    int n_spawned;
+    long woken;           // Total de agentes acordados (estatística)
+    tick_regions_t regions;
+} tick_engine_t;
+
+/* n_threads <= 0 usa pool_default_threads() (limitado ao número de agentes) */
+int tick_engine_init(tick_engine_t* engine, board_t* board, int n_threads);
+void tick_engine_free(tick_engine_t* engine);
+
+/* Joga uma jogada com board->board_lock tomado do início ao fim.
+   Devolve um sim_outcome_t (SIM_RUNNING enquanto o jogo continua) */
+int tick_step(tick_engine_t* engine);
+
+/* Jogadas seguintes em que nenhum agente age (0 se há jogadores; -1 se nada volta a agir) */
+long tick_idle(const tick_engine_t* engine);
+
+/* Salta n jogadas sem ninguém (n <= tick_idle) */
+void tick_skip(tick_engine_t* engine, long n);
+
+/* Põe em dia o passo e os 'T' dos agentes a dormir (antes de copiar o tabuleiro para um
+   save). O chamador tem de ter o board_lock */
+void tick_sync(tick_engine_t* engine);
+
+/* Refaz a agenda a partir do tabuleiro (depois de o substituir, ex.: restore de um save) */
+void tick_reschedule(tick_engine_t* engine);
+
+/* Relógio das jogadas: as jogadas acontecem em start + k * period (CLOCK_MONOTONIC),
+   com clock_nanosleep absoluto, por isso o tempo de cada jogada e a latência do
+   escalonador não se acumulam. Uma jogada que acaba depois do prazo seguinte
+   conta como atrasada; os prazos que já passaram contam como perdidos e são
+   saltados (o relógio volta à grelha em vez de jogar várias jogadas seguidas). */
+typedef struct {
+    struct timespec start;
+    struct timespec next;  // Próximo prazo
+    long period_ns;
+    long ticks;            // Prazos cumpridos ou ultrapassados
+    long overruns;         // Jogadas que acabaram depois do prazo
+    long missed;           // Prazos saltados
+    long stalls;           // Paragens longas (ex.: à espera de um save) que não contam como perdidos
+    long max_late_ns;      // Maior atraso em relação a um prazo
+} tick_clock_t;
+
+void tick_clock_start(tick_clock_t* clock, int period_ms);
+
+/* Dorme até ao próximo prazo (ou conta o atraso se já passou) */
+void tick_clock_wait(tick_clock_t* clock);
+
+/* Como tick_clock_wait, mas salta n - 1 prazos sem jogadas */
+void tick_clock_wait_ticks(tick_clock_t* clock, long n);
+
+/* Como tick_clock_wait_ticks, mas a dormir em board_sleep_until: board_wake e
+   board_finish acordam a thread antes do prazo. Devolve os prazos que passaram: n se
+   dormiu até ao fim, menos se foi acordada (o relógio fica no primeiro prazo que
+   ainda não passou). Com n = TICK_FOREVER só acorda com board_wake */
+#define TICK_FOREVER LONG_MAX
+long tick_clock_sleep(tick_clock_t* clock, long n, board_t* board);
+
+/* Jogadas por segundo conseguidas desde o início e as pretendidas */
+double tick_clock_rate(const tick_clock_t* clock);
+double tick_clock_target(const tick_clock_t* clock);
+
+#endif
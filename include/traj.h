@@ -0,0 +1,78 @@
+#ifndef TRAJ_H
+#define TRAJ_H
+
+#include "board.h"
+
+/* Trajetórias pré-calculadas dos fantasmas com script determinista (sem 'R').
+   Sozinho contra as paredes, que não mudam, um fantasma destes repete o estado
+   (posição, instrução, contadores de passo e de 'T', carga) ao fim de algumas
+   jogadas: ao carregar o nível cada um é jogado assim até o estado se repetir e
+   fica com um prefixo e um ciclo de estados, um por jogada. Enquanto nenhum
+   outro agente se aproxima, o estado numa jogada qualquer é uma consulta.
+
+   sim_run usa-as para avançar janelas de TRAJ_WINDOW jogadas: os fantasmas cuja
+   caixa (as casas por onde passam na janela) não toca na de mais ninguém saltam
+   para o estado do fim da janela; os outros e os Pacmans jogam jogada a jogada. */
+
+#define TRAJ_MAX_TICKS 2048 // Fantasmas com um prefixo + ciclo maior jogam sempre jogada a jogada
+#define TRAJ_WINDOW 32      // Jogadas por janela (e por caixa pré-calculada)
+
+typedef struct {
+    uint16_t x, y;
+    uint8_t pc;
+    uint8_t charged;
+    uint8_t issued;   // Movimento pedido nesta jogada: 'W', 'A', 'S', 'D' (minúscula se carregado) ou 0
+    int32_t left;
+    int32_t waiting;
+} traj_state_t;
+
+/* Movimentos pedidos pelo script numa janela, tenham ou não resultado. Não dependem
+   da posição: limitam por onde o fantasma pode andar mesmo que outro agente o desvie */
+typedef struct {
+    int32_t left, right, up, down;
+    int32_t charged;
+} traj_moves_t;
+
+typedef struct {
+    int32_t x0, y0, x1, y1; // Inclusivo
+} traj_box_t;
+
+typedef struct {
+    int n_prefix, n_cycle;  // n_cycle == 0: sem trajetória
+    traj_state_t* states;   // [n_prefix + n_cycle] Estado no início de cada jogada
+    traj_box_t* boxes;      // Caixa de cada bloco de TRAJ_WINDOW jogadas (com o ciclo desenrolado)
+    int32_t* index;         // Tabela de dispersão estado -> índice em states (-1 = vazio)
+    int32_t* script_index;  // O mesmo só pelo estado do script (o primeiro índice com esse estado)
+    uint32_t index_mask;
+    void* mem;              // states, boxes e as duas tabelas num só bloco
+} traj_t;
+
+typedef struct traj_set {
+    int n_ghosts;
+    traj_t* ghosts;         // [n_ghosts]
+    int n_traj;             // Fantasmas com trajetória
+} traj_set_t;
+
+/* Calcula as trajetórias dos fantasmas de board no estado atual (ao carregar).
+   NULL sem memória ou se nenhum fantasma tem trajetória */
+traj_set_t* traj_build(const board_t* board);
+void traj_free(traj_set_t* set);
+
+/* Índice em states do estado atual do fantasma, ou -1 se saiu da trajetória */
+int traj_find(const traj_t* traj, const ghost_t* ghost);
+
+/* Um índice com o mesmo estado do script, noutra posição ou não, ou -1. Depois de um
+   desvio o fantasma pede os mesmos movimentos que a partir desse índice */
+int traj_find_script(const traj_t* traj, const ghost_t* ghost);
+
+/* Estado i jogadas depois do índice at (dá a volta ao ciclo) */
+const traj_state_t* traj_state(const traj_t* traj, int at, long i);
+
+/* Caixa das casas ocupadas nas jogadas [at, at + n] (n <= TRAJ_WINDOW); pode ser maior
+   do que a exata (junta os blocos inteiros) */
+void traj_window_box(const traj_t* traj, int at, int n, traj_box_t* box);
+
+/* Movimentos pedidos nas jogadas [at, at + n) */
+void traj_window_moves(const traj_t* traj, int at, int n, traj_moves_t* moves);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef TTABLE_H
+#define TTABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Tabela de transposição: hash Zobrist do estado -> informação guardada.
+   Endereçamento aberto com sondagem linear; cresce quando fica 3/4 cheia. */
+
+#define TT_PENDING (-1) // Estado visto na corrida atual, desfecho ainda desconhecido
+
+typedef struct {
+    uint64_t key;   // 0 = entrada livre
+    int32_t tick;   // Jogada em que foi visto / jogadas até ao desfecho
+    int32_t value;  // TT_PENDING ou um sim_outcome_t
+    int32_t points; // Pontos ganhos deste estado até ao desfecho
+} tt_entry_t;
+
+typedef struct {
+    tt_entry_t* entries;
+    size_t mask;    // capacidade - 1 (capacidade é potência de 2)
+    size_t used;
+} ttable_t;
+
+int tt_init(ttable_t* tt, int log2_size);
+void tt_clear(ttable_t* tt);
+void tt_free(ttable_t* tt);
+
+/* Devolve a entrada de key, ou NULL se não existir */
+tt_entry_t* tt_lookup(const ttable_t* tt, uint64_t key);
+
+/* Devolve a entrada de key, criando-a (com value = TT_PENDING) se não existir.
+   *created fica a 1 se a entrada é nova. NULL se não houver memória */
+tt_entry_t* tt_insert(ttable_t* tt, uint64_t key, int* created);
+
+#endif
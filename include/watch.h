@@ -0,0 +1,44 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "board.h"
+
+/* Vigia de uma diretoria de níveis com inotify. Os eventos de fim de escrita
+   (IN_CLOSE_WRITE), de ficheiro que chega por rename (IN_MOVED_TO, o que os
+   editores fazem ao gravar) e de remoção são juntados por ficheiro: cada leitura
+   devolve cada .lvl, .m ou .p alterado uma só vez, para ser lido de novo sozinho.
+
+   No jogo, um .m / .p alterado troca o script dos agentes que o usam entre duas
+   jogadas (swap_agent_script) e um .lvl alterado recomeça o nível atual já lido
+   de novo; os níveis seguintes são lidos do disco quando chegar a sua vez. */
+
+typedef enum {
+    WATCH_LEVEL = 0,  // .lvl
+    WATCH_AGENT,      // .m ou .p
+    WATCH_OVERFLOW,   // O kernel perdeu eventos: tudo pode ter mudado
+} watch_kind_t;
+
+typedef struct {
+    char name[256];
+    int kind;         // watch_kind_t
+    int removed;      // Apagado ou movido para fora (o último evento do ficheiro)
+} watch_change_t;
+
+typedef struct level_watch level_watch_t;
+
+/* NULL se o inotify não está disponível ou a diretoria não existe */
+level_watch_t* watch_open(const char* dir_path);
+void watch_close(level_watch_t* watch);
+
+/* Descritor para o poll (pronto quando há eventos) */
+int watch_fd(const level_watch_t* watch);
+
+/* Lê os eventos pendentes sem bloquear. Devolve o número de ficheiros alterados
+   escritos em changes (no máximo max; os restantes ficam para a leitura seguinte) */
+int watch_read(level_watch_t* watch, watch_change_t* changes, int max);
+
+/* Modo "--watch <dir> [seconds]": analisa os níveis uma vez e, a cada ficheiro
+   gravado, volta a ler só esse ficheiro e a analisar os níveis que o usam */
+int watch_main(int argc, char** argv);
+
+#endif
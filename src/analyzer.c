@@ -0,0 +1,502 @@
+#include "analyzer.h"
+#include "files.h"
+#include "pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <dirent.h>
+
+// Bitsets do nível: uma linha do tabuleiro ocupa words_per_row palavras de 64 bits
+typedef struct {
+    int width, height;
+    int words_per_row;
+    uint64_t* open;  // 1 = célula sem parede
+    uint64_t* reach; // 1 = célula alcançável a partir do Pacman
+} level_bits_t;
+
+static void add_issue(level_report_t* report, issue_severity_t severity, const char* format, ...) {
+    if (severity == ISSUE_ERROR) report->n_errors++;
+    else report->n_warnings++;
+
+    if (report->n_issues >= ANALYZER_MAX_ISSUES) return;
+    level_issue_t* issue = &report->issues[report->n_issues++];
+    issue->severity = severity;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(issue->msg, sizeof(issue->msg), format, args);
+    va_end(args);
+}
+
+static inline int bit_get(const uint64_t* bits, const level_bits_t* lb, int x, int y) {
+    return (bits[(size_t)y * lb->words_per_row + (x >> 6)] >> (x & 63)) & 1;
+}
+
+static inline void bit_set(uint64_t* bits, const level_bits_t* lb, int x, int y) {
+    bits[(size_t)y * lb->words_per_row + (x >> 6)] |= (uint64_t)1 << (x & 63);
+}
+
+static inline int is_open(const level_bits_t* lb, int x, int y) {
+    if (x < 0 || x >= lb->width || y < 0 || y >= lb->height) return 0;
+    return bit_get(lb->open, lb, x, y);
+}
+
+// Preenchimento (Kogge-Stone) para bits mais altos, sem atravessar zeros de 'p'
+static inline uint64_t fill_up(uint64_t g, uint64_t p) {
+    g &= p;
+    g |= p & (g << 1);  p &= p << 1;
+    g |= p & (g << 2);  p &= p << 2;
+    g |= p & (g << 4);  p &= p << 4;
+    g |= p & (g << 8);  p &= p << 8;
+    g |= p & (g << 16); p &= p << 16;
+    g |= p & (g << 32);
+    return g;
+}
+
+// O mesmo, para bits mais baixos
+static inline uint64_t fill_down(uint64_t g, uint64_t p) {
+    g &= p;
+    g |= p & (g >> 1);  p &= p >> 1;
+    g |= p & (g >> 2);  p &= p >> 2;
+    g |= p & (g >> 4);  p &= p >> 4;
+    g |= p & (g >> 8);  p &= p >> 8;
+    g |= p & (g >> 16); p &= p >> 16;
+    g |= p & (g >> 32);
+    return g;
+}
+
+/* Atualiza a linha y com as sementes das linhas vizinhas e preenche os seus
+   segmentos abertos. Devolve 1 se a linha mudou. */
+static int fill_row(level_bits_t* lb, int y, uint64_t* tmp) {
+    int wpr = lb->words_per_row;
+    uint64_t* row = lb->reach + (size_t)y * wpr;
+    const uint64_t* open = lb->open + (size_t)y * wpr;
+    const uint64_t* up = (y > 0) ? row - wpr : NULL;
+    const uint64_t* down = (y < lb->height - 1) ? row + wpr : NULL;
+
+    for (int w = 0; w < wpr; w++) {
+        uint64_t seeds = row[w];
+        if (up) seeds |= up[w];
+        if (down) seeds |= down[w];
+        tmp[w] = seeds & open[w];
+    }
+
+    // Uma passagem para a direita e outra para a esquerda enchem cada segmento
+    uint64_t carry = 0;
+    for (int w = 0; w < wpr; w++) {
+        tmp[w] = fill_up(tmp[w] | carry, open[w]);
+        carry = tmp[w] >> 63;
+    }
+    carry = 0;
+    for (int w = wpr - 1; w >= 0; w--) {
+        tmp[w] = fill_down(tmp[w] | (carry << 63), open[w]);
+        carry = tmp[w] & 1;
+    }
+
+    int changed = 0;
+    for (int w = 0; w < wpr; w++) {
+        if (tmp[w] != row[w]) { row[w] = tmp[w]; changed = 1; }
+    }
+    return changed;
+}
+
+// Flood fill por linhas: cada linha que muda volta a pôr as vizinhas na pilha
+static void flood_fill(level_bits_t* lb, int start_x, int start_y) {
+    if (!is_open(lb, start_x, start_y)) return;
+
+    int* stack = malloc(sizeof(int) * lb->height);
+    char* queued = calloc(lb->height, 1);
+    uint64_t* tmp = malloc(sizeof(uint64_t) * lb->words_per_row);
+    int top = 0;
+
+    bit_set(lb->reach, lb, start_x, start_y);
+    stack[top++] = start_y;
+    queued[start_y] = 1;
+
+    while (top > 0) {
+        int y = stack[--top];
+        queued[y] = 0;
+        if (!fill_row(lb, y, tmp)) continue;
+
+        for (int ny = y - 1; ny <= y + 1; ny += 2) {
+            if (ny >= 0 && ny < lb->height && !queued[ny]) {
+                stack[top++] = ny;
+                queued[ny] = 1;
+            }
+        }
+    }
+    free(tmp);
+    free(queued);
+    free(stack);
+}
+
+static int init_bits(level_bits_t* lb, const board_t* board) {
+    lb->width = board->width;
+    lb->height = board->height;
+    lb->words_per_row = (board->width + 63) / 64;
+    size_t words = (size_t)lb->words_per_row * board->height;
+    lb->open = calloc(words, sizeof(uint64_t));
+    lb->reach = calloc(words, sizeof(uint64_t));
+    if (!lb->open || !lb->reach) return -1;
+
+    // Os blocos só de parede ficam a zero sem serem percorridos
+    for (int cy = 0; cy < board->chunks_y; cy++) {
+        for (int cx = 0; cx < board->chunks_x; cx++) {
+            if (board_chunk(board, cx, cy) == board_wall_chunk) continue;
+            int x0 = cx << board->chunk_shift_x, y0 = cy << board->chunk_shift_y;
+            for (int y = y0; y < y0 + (1 << board->chunk_shift_y) && y < board->height; y++) {
+                for (int x = x0; x < x0 + (1 << board->chunk_shift_x) && x < board->width; x++) {
+                    if (board_at(board, x, y)->content != 'W')
+                        bit_set(lb->open, lb, x, y);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static void free_bits(level_bits_t* lb) {
+    free(lb->open);
+    free(lb->reach);
+}
+
+static void check_dimensions(const board_t* board, level_report_t* report) {
+    if (board->width <= 0 || board->height <= 0) {
+        add_issue(report, ISSUE_ERROR, "DIM inválido (%d x %d)", board->height, board->width);
+        return;
+    }
+    if (board->map_rows != board->height) {
+        add_issue(report, ISSUE_ERROR, "DIM declara %d linhas mas o mapa tem %d",
+                  board->height, board->map_rows);
+    }
+    if (board->map_bad_rows > 0) {
+        add_issue(report, ISSUE_ERROR, "%d linha(s) do mapa com largura diferente de %d",
+                  board->map_bad_rows, board->width);
+    }
+}
+
+// Posições declaradas nos ficheiros, antes de o loader as corrigir
+static void check_start(const board_t* board, const level_bits_t* lb, level_report_t* report,
+                        const char* file, int x, int y) {
+    if (x < 0 || x >= board->width || y < 0 || y >= board->height) {
+        add_issue(report, ISSUE_ERROR, "%s: POS %d %d fora do tabuleiro", file, y, x);
+    }
+    else if (!is_open(lb, x, y)) {
+        add_issue(report, ISSUE_ERROR, "%s: POS %d %d é uma parede", file, y, x);
+    }
+}
+
+static void check_agent_starts(const board_t* board, const level_bits_t* lb, level_report_t* report) {
+    for (int p = 0; p < board->n_pacmans; p++) {
+        if (board->pacman_files[p][0] == '\0') continue; // Pacman manual sem ficheiro
+        const pacman_t* pac = &board->pacmans[p];
+        check_start(board, lb, report, board->pacman_files[p], pac->start_x, pac->start_y);
+    }
+
+    for (int g = 0; g < board->spawn_base; g++) {
+        const ghost_t* ghost = &board->ghosts[g];
+        int before = report->n_errors;
+        check_start(board, lb, report, board->ghosts_files[g], ghost->start_x, ghost->start_y);
+        if (report->n_errors != before) continue;
+
+        // Dois agentes na mesma casa: o loader muda um deles de sítio
+        for (int p = 0; p < board->n_pacmans; p++) {
+            if (board->pacman_files[p][0] != '\0' &&
+                ghost->start_x == board->pacmans[p].start_x && ghost->start_y == board->pacmans[p].start_y) {
+                add_issue(report, ISSUE_WARNING, "%s: começa em cima de %s",
+                          board->ghosts_files[g], board->pacman_files[p]);
+                break;
+            }
+        }
+        for (int o = 0; o < g; o++) {
+            if (board->ghosts[o].start_x == ghost->start_x && board->ghosts[o].start_y == ghost->start_y) {
+                add_issue(report, ISSUE_WARNING, "%s: começa na mesma casa que %s",
+                          board->ghosts_files[g], board->ghosts_files[o]);
+                break;
+            }
+        }
+    }
+}
+
+// Ninhos: a casa tem de estar aberta e o ninho tem de ter vagas
+static void check_nests(const board_t* board, const level_bits_t* lb, level_report_t* report) {
+    for (int i = 0; i < board->n_nests; i++) {
+        const nest_t* nest = &board->nests[i];
+        if (nest->x < 0 || nest->x >= board->width || nest->y < 0 || nest->y >= board->height)
+            add_issue(report, ISSUE_ERROR, "NINHO %d %d (%s) fora do tabuleiro", nest->y, nest->x, nest->file);
+        else if (!is_open(lb, nest->x, nest->y))
+            add_issue(report, ISSUE_ERROR, "NINHO %d %d (%s) é uma parede", nest->y, nest->x, nest->file);
+        if (nest->slots == 0)
+            add_issue(report, ISSUE_WARNING, "NINHO %d %d (%s) sem vagas: nunca faz nascer fantasmas",
+                      nest->y, nest->x, nest->file);
+    }
+}
+
+// Fantasmas a analisar: os do MON e uma vaga por ninho (as outras têm o mesmo script)
+static int is_analyzed(const board_t* board, int g) {
+    const ghost_t* ghost = &board->ghosts[g];
+    return ghost->nest < 0 || g == board->nests[ghost->nest].first;
+}
+
+static void check_reachability(const board_t* board, level_bits_t* lb, level_report_t* report) {
+    // Uma casa é alcançável se algum Pacman lá chegar
+    for (int p = 0; p < board->n_pacmans; p++) {
+        const pacman_t* pac = &board->pacmans[p];
+        if (is_open(lb, pac->pos_x, pac->pos_y) && !bit_get(lb->reach, lb, pac->pos_x, pac->pos_y))
+            flood_fill(lb, pac->pos_x, pac->pos_y);
+    }
+
+    // Percorre só os bits abertos (os tabuleiros grandes são quase só parede)
+    for (int y = 0; y < board->height; y++) {
+        for (int w = 0; w < lb->words_per_row; w++) {
+            for (uint64_t bits = lb->open[(size_t)y * lb->words_per_row + w]; bits; bits &= bits - 1) {
+                int x = (w << 6) + __builtin_ctzll(bits);
+                const board_pos_t* cell = board_at(board, x, y);
+                int reachable = bit_get(lb->reach, lb, x, y);
+
+                report->open_cells++;
+                report->reachable_cells += reachable;
+                if (cell->has_dot) {
+                    report->total_dots++;
+                    report->reachable_dots += reachable;
+                }
+                if (cell->has_portal) {
+                    report->n_portals++;
+                    report->reachable_portals += reachable;
+                }
+            }
+        }
+    }
+
+    if (report->n_portals == 0) {
+        add_issue(report, ISSUE_ERROR, "nível sem portal ('@')");
+    }
+    else if (report->reachable_portals == 0) {
+        add_issue(report, ISSUE_ERROR, "portal inalcançável a partir do Pacman");
+    }
+    if (report->reachable_dots < report->total_dots) {
+        add_issue(report, ISSUE_WARNING, "%d ponto(s) inalcançáveis",
+                  report->total_dots - report->reachable_dots);
+    }
+}
+
+static int direction_delta(char c, int* dx, int* dy) {
+    *dx = 0; *dy = 0;
+    switch (c) {
+        case 'W': *dy = -1; return 1;
+        case 'S': *dy = 1;  return 1;
+        case 'A': *dx = -1; return 1;
+        case 'D': *dx = 1;  return 1;
+        default:  return 0;
+    }
+}
+
+// Deslocamento carregado contra as paredes (mesmas regras de resolve_ghost_charged)
+static void charged_slide(const level_bits_t* lb, int dx, int dy, int* x, int* y) {
+    while (is_open(lb, *x + dx, *y + dy)) {
+        *x += dx;
+        *y += dy;
+    }
+}
+
+/* Estados vistos no início de cada passagem do dry run. Há no máximo
+   ANALYZER_MAX_PASSES, por isso uma tabela de dispersão fixa chega (um bitset
+   por casa do tabuleiro não cabe em níveis enormes) */
+#define SEEN_BITS 13
+_Static_assert((1 << SEEN_BITS) >= 2 * ANALYZER_MAX_PASSES, "tabela de estados pequena demais");
+
+// Devolve 1 se key já estava na tabela (key != 0)
+static int seen_insert(uint64_t* seen, uint64_t key) {
+    size_t mask = ((size_t)1 << SEEN_BITS) - 1;
+    for (size_t i = (key * 0x9E3779B97F4A7C15ull) >> (64 - SEEN_BITS); ; i = (i + 1) & mask) {
+        if (seen[i] == key) return 1;
+        if (seen[i] == 0) { seen[i] = key; return 0; }
+    }
+}
+
+/* Corre o script de um fantasma determinista só contra as paredes até o estado
+   no início do script se repetir, e marca os movimentos que nunca resultam. */
+static void dry_run_ghost(const board_t* board, const level_bits_t* lb, int g, level_report_t* report) {
+    const ghost_t* ghost = &board->ghosts[g];
+    const char* file = board->ghosts_files[g];
+    int n = ghost->n_moves;
+    if (ghost->n_code == 0) return; // Fantasma aleatório ou script inválido (check_scripts)
+
+    for (int i = 0; i < n; i++) {
+        if (ghost->moves[i].command == 'R') return; // Não determinista
+    }
+    if (!is_open(lb, ghost->pos_x, ghost->pos_y)) return;
+
+    // Estado visto no início de cada passagem: (carregado, x, y)
+    uint64_t* seen = calloc((size_t)1 << SEEN_BITS, sizeof(uint64_t));
+    if (!seen) return;
+    int attempts[MAX_MOVES] = {0};
+    int successes[MAX_MOVES] = {0};
+
+    int x = ghost->pos_x, y = ghost->pos_y, charged = 0, cur = 0;
+    for (int passes = 0; passes < ANALYZER_MAX_PASSES; ) {
+        if (cur == 0) {
+            uint64_t key = ((uint64_t)charged << 63 | get_board_index(board, x, y)) + 1;
+            if (seen_insert(seen, key)) break;
+            passes++;
+        }
+
+        char c = ghost->moves[cur].command;
+        int dx, dy;
+        if (c == 'X') break; // Sai do tabuleiro: o resto nunca corre a partir daqui
+        if (c == 'C') {
+            charged = 1;
+        }
+        else if (direction_delta(c, &dx, &dy)) {
+            int nx = x, ny = y;
+            attempts[cur]++;
+            if (charged) {
+                charged = 0;
+                charged_slide(lb, dx, dy, &nx, &ny);
+            }
+            else if (is_open(lb, x + dx, y + dy)) {
+                nx = x + dx;
+                ny = y + dy;
+            }
+            if (nx != x || ny != y) successes[cur]++;
+            x = nx;
+            y = ny;
+        }
+        cur = (cur + 1) % n;
+    }
+    free(seen);
+
+    for (int i = 0; i < n; i++) {
+        if (attempts[i] > 0 && successes[i] == 0) {
+            add_issue(report, ISSUE_WARNING, "%s: comando %d ('%c') bate sempre numa parede",
+                      file, i + 1, ghost->moves[i].command);
+        }
+    }
+}
+
+// Os scripts são compilados ao carregar; um comando inválido é um erro do nível
+static void check_scripts(const board_t* board, level_report_t* report) {
+    script_op_t code[MAX_MOVES];
+    char err[128];
+    for (int p = 0; p < board->n_pacmans; p++) {
+        const pacman_t* pac = &board->pacmans[p];
+        if (script_compile(pac->moves, pac->n_moves, 0, code, err, sizeof(err)) < 0)
+            add_issue(report, ISSUE_ERROR, "%s: %s", board->pacman_files[p], err);
+    }
+    for (int g = 0; g < board->n_ghosts; g++) {
+        const ghost_t* ghost = &board->ghosts[g];
+        if (!is_analyzed(board, g)) continue;
+        if (script_compile(ghost->moves, ghost->n_moves, 1, code, err, sizeof(err)) < 0)
+            add_issue(report, ISSUE_ERROR, "%s: %s", board->ghosts_files[g], err);
+    }
+}
+
+int analyze_level(const board_t* board, level_report_t* report) {
+    memset(report, 0, sizeof(*report));
+    snprintf(report->level_name, sizeof(report->level_name), "%s", board->level_name);
+
+    check_dimensions(board, report);
+    if (!board->chunks || board->width <= 0 || board->height <= 0) return report->n_errors;
+
+    level_bits_t lb;
+    if (init_bits(&lb, board) != 0) {
+        free_bits(&lb);
+        add_issue(report, ISSUE_ERROR, "sem memória para analisar o nível");
+        return report->n_errors;
+    }
+
+    check_agent_starts(board, &lb, report);
+    check_nests(board, &lb, report);
+    check_reachability(board, &lb, report);
+    for (int g = 0; g < board->n_ghosts; g++) {
+        if (is_analyzed(board, g)) dry_run_ghost(board, &lb, g, report);
+    }
+    check_scripts(board, report);
+
+    free_bits(&lb);
+    return report->n_errors;
+}
+
+// ==================================================================
+// ANÁLISE DE UMA DIRETORIA EM PARALELO
+// ==================================================================
+typedef struct {
+    const char* dir_path;
+    struct dirent** namelist;
+    level_report_t* reports;
+} dir_job_t;
+
+static void analyze_one(void* ctx, int index) {
+    dir_job_t* job = (dir_job_t*)ctx;
+    const char* name = job->namelist[index]->d_name;
+    level_report_t* report = &job->reports[index];
+
+    board_t board;
+    memset(&board, 0, sizeof(board));
+    if (parse_level(&board, job->dir_path, name, 0) != 0) {
+        memset(report, 0, sizeof(*report));
+        snprintf(report->level_name, sizeof(report->level_name), "%s", name);
+        add_issue(report, ISSUE_ERROR, "não foi possível ler o nível (falta DIM?)");
+        board_free_cells(&board);
+        return;
+    }
+    analyze_level(&board, report);
+    unload_level(&board);
+}
+
+int analyze_directory(const char* dir_path, int n_threads, level_report_t** reports, int* n_reports) {
+    struct dirent** namelist;
+    int n = scandir(dir_path, &namelist, filter_levels, alphasort);
+    if (n < 0) return -1;
+
+    dir_job_t job = { dir_path, namelist, calloc(n > 0 ? n : 1, sizeof(level_report_t)) };
+    pool_t* pool = pool_create(n_threads);
+    pool_parallel_for(pool, n, analyze_one, &job);
+    pool_destroy(pool);
+
+    for (int i = 0; i < n; i++) free(namelist[i]);
+    free(namelist);
+
+    *reports = job.reports;
+    *n_reports = n;
+    return 0;
+}
+
+void print_level_report(FILE* out, const level_report_t* report) {
+    fprintf(out, "[%s] %s (células %d/%d, pontos %d/%d)\n",
+            report->n_errors ? "ERRO" : "OK", report->level_name,
+            report->reachable_cells, report->open_cells,
+            report->reachable_dots, report->total_dots);
+    for (int i = 0; i < report->n_issues; i++) {
+        fprintf(out, "    %s: %s\n",
+                report->issues[i].severity == ISSUE_ERROR ? "erro" : "aviso", report->issues[i].msg);
+    }
+}
+
+void log_level_report(const level_report_t* report) {
+    debug("[ANALYZER] %s: %d erro(s), %d aviso(s)\n", report->level_name, report->n_errors, report->n_warnings);
+    for (int i = 0; i < report->n_issues; i++) {
+        debug("[ANALYZER]   %s: %s\n",
+              report->issues[i].severity == ISSUE_ERROR ? "erro" : "aviso", report->issues[i].msg);
+    }
+}
+
+int analyzer_main(int argc, char** argv) {
+    if (argc < 2) { printf("Usage: %s <dir> [threads]\n", argv[0]); return 1; }
+
+    int n_threads = (argc >= 3) ? atoi(argv[2]) : pool_default_threads();
+    level_report_t* reports;
+    int n;
+    if (analyze_directory(argv[1], n_threads, &reports, &n) != 0) { perror("scandir"); return 1; }
+
+    int broken = 0;
+    for (int i = 0; i < n; i++) {
+        print_level_report(stdout, &reports[i]);
+        if (reports[i].n_errors > 0) broken++;
+    }
+    printf("%d nível(is) analisado(s), %d com erros\n", n, broken);
+    free(reports);
+    return broken ? 2 : 0;
+}
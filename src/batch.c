@@ -0,0 +1,641 @@
+#include "batch.h"
+#include "files.h"
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BATCH_DEFAULT_LANES 1024
+#define BATCH_DEFAULT_TICKS 1000
+#define BATCH_VERIFY_LANES 64
+
+// Palavra de uma instrução em code_word: op, carga e (dx, dy) + 1
+#define WORD_OP(w) ((w) & 15)
+#define WORD_CHARGE(w) (((w) >> 4) & 1)
+#define WORD_DX(w) ((((w) >> 5) & 3) - 1)
+#define WORD_DY(w) ((((w) >> 7) & 3) - 1)
+
+// O que uma lane vê na casa de chegada (seen)
+#define SEEN_CONTENT 0xff
+#define SEEN_WALL (1 << 8)
+#define SEEN_PORTAL (1 << 9)
+#define SEEN_DOT (1 << 10)
+
+// Escritas de um passo nas grelhas (word, depois da decisão)
+#define MOVE_LEAVE 1
+#define MOVE_ARRIVE 2
+#define MOVE_EAT 4
+
+// Reparte uma única alocação pelos arrays de uma lane de agente
+static int32_t* carve(char** cursor, int K) {
+    int32_t* p = (int32_t*)*cursor;
+    *cursor += sizeof(int32_t) * (size_t)K;
+    return p;
+}
+
+static void carve_agent(agent_lanes_t* a, char** cursor, int K) {
+    a->x = carve(cursor, K);
+    a->y = carve(cursor, K);
+    a->pc = carve(cursor, K);
+    a->wait = carve(cursor, K);
+    a->left = carve(cursor, K);
+    a->charged = carve(cursor, K);
+    a->alive = carve(cursor, K);
+    a->points = carve(cursor, K);
+    a->rng = (uint32_t*)carve(cursor, K);
+}
+
+static void copy_code(agent_lanes_t* a, const script_op_t* code, int n_code) {
+    a->n_code = n_code;
+    for (int i = 0; i < n_code; i++) {
+        a->code_word[i] = code[i].op | (code[i].charge << 4) | ((code[i].dx + 1) << 5) | ((code[i].dy + 1) << 7);
+        a->code_count[i] = code[i].count;
+    }
+}
+
+int batch_init(batch_t* batch, const board_t* level, int K, uint32_t seed) {
+    memset(batch, 0, sizeof(*batch));
+    size_t cells = (size_t)level->width * level->height;
+    int agents = level->n_pacmans + level->n_ghosts;
+
+    batch->K = K;
+    batch->P = level->n_pacmans;
+    batch->G = level->n_ghosts;
+    batch->width = level->width;
+    batch->height = level->height;
+
+    // Tudo numa só alocação: estáticos, grelhas por lane e arrays dos agentes
+    size_t bytes = 2 * cells + 2 * cells * K
+                 + sizeof(int32_t) * (size_t)K * (9 * (size_t)agents + 11);
+    batch->arena = calloc(1, bytes);
+    batch->pac = calloc(batch->P ? batch->P : 1, sizeof(agent_lanes_t));
+    batch->ghost = calloc(batch->G ? batch->G : 1, sizeof(agent_lanes_t));
+    if (!batch->arena || !batch->pac || !batch->ghost) { batch_free(batch); return -1; }
+
+    // Os arrays de int32 primeiro, para ficarem alinhados
+    char* cursor = batch->arena;
+    for (int p = 0; p < batch->P; p++) carve_agent(&batch->pac[p], &cursor, K);
+    for (int g = 0; g < batch->G; g++) carve_agent(&batch->ghost[g], &cursor, K);
+    batch->status = carve(&cursor, K);
+    batch->ticks = carve(&cursor, K);
+    batch->lane = carve(&cursor, K);
+    batch->slot = carve(&cursor, K);
+    batch->dx = carve(&cursor, K);
+    batch->dy = carve(&cursor, K);
+    batch->act = carve(&cursor, K);
+    batch->word = carve(&cursor, K);
+    batch->from = carve(&cursor, K);
+    batch->cell = carve(&cursor, K);
+    batch->seen = carve(&cursor, K);
+    batch->content = cursor; cursor += cells * K;
+    batch->dot = (uint8_t*)cursor; cursor += cells * K;
+    batch->wall = (uint8_t*)cursor; cursor += cells;
+    batch->portal = (uint8_t*)cursor;
+
+    for (size_t c = 0; c < cells; c++) {
+        const board_pos_t* cell = board_at(level, c % level->width, c / level->width);
+        batch->wall[c] = (cell->content == 'W');
+        batch->portal[c] = (uint8_t)cell->has_portal;
+        char content = (cell->content == 'P' || cell->content == 'M') ? cell->content : ' ';
+        memset(&batch->content[c * K], content, K);
+        memset(&batch->dot[c * K], cell->has_dot ? 1 : 0, K);
+    }
+
+    for (int p = 0; p < batch->P; p++) {
+        const pacman_t* src = &level->pacmans[p];
+        agent_lanes_t* a = &batch->pac[p];
+        a->passo = src->passo;
+        copy_code(a, src->code, src->n_code);
+    }
+    for (int g = 0; g < batch->G; g++) {
+        const ghost_t* src = &level->ghosts[g];
+        agent_lanes_t* a = &batch->ghost[g];
+        a->passo = src->passo;
+        copy_code(a, src->code, src->n_code);
+    }
+
+    // As sementes vêm de um clone para serem exatamente as do caminho escalar
+    board_t scratch;
+    memset(&scratch, 0, sizeof(scratch));
+    if (board_clone(&scratch, level) != 0) { batch_free(batch); return -1; }
+    batch->active = K;
+    for (int k = 0; k < K; k++) {
+        batch->lane[k] = batch->slot[k] = k;
+        board_seed(&scratch, seed + (uint32_t)k);
+        for (int p = 0; p < batch->P; p++) {
+            const pacman_t* src = &level->pacmans[p];
+            agent_lanes_t* a = &batch->pac[p];
+            a->x[k] = src->pos_x; a->y[k] = src->pos_y;
+            a->pc[k] = src->pc; a->wait[k] = src->waiting; a->left[k] = src->left;
+            a->alive[k] = src->alive; a->points[k] = src->points; a->charged[k] = 0;
+            a->rng[k] = scratch.pacmans[p].rng;
+        }
+        for (int g = 0; g < batch->G; g++) {
+            const ghost_t* src = &level->ghosts[g];
+            agent_lanes_t* a = &batch->ghost[g];
+            a->x[k] = src->pos_x; a->y[k] = src->pos_y;
+            a->pc[k] = src->pc; a->wait[k] = src->waiting; a->left[k] = src->left;
+            a->charged[k] = src->charged; a->alive[k] = 1; a->points[k] = 0;
+            a->rng[k] = scratch.ghosts[g].rng;
+        }
+    }
+    board_free_clone(&scratch);
+    return 0;
+}
+
+void batch_free(batch_t* batch) {
+    free(batch->arena);
+    free(batch->pac);
+    free(batch->ghost);
+    memset(batch, 0, sizeof(*batch));
+}
+
+/* Kernel comum a Pacmans e fantasmas: contagem do passo.
+   À entrada act[k] diz se a lane joga; à saída, se corre o comando nesta
+   jogada (waiting chegou a 0). Sem ramos: vetoriza. */
+static void kernel_passo(int K, int32_t* restrict wait, int32_t* restrict act, int passo) {
+    for (int k = 0; k < K; k++) {
+        int32_t w = wait[k];
+        int32_t run = act[k];
+        act[k] = run & (w == 0);
+        wait[k] = run ? (w > 0 ? w - 1 : passo) : w;
+    }
+}
+
+/* Direção de um sorteio d (0..3) em aritmética, para os kernels vetorizarem. 'R'
+   usa a ordem {'W', 'S', 'A', 'D'} do interpretador de board.c; um fantasma sem
+   script (sim_step) usa {'W', 'A', 'S', 'D'} */
+static inline int32_t rand_dir_dx(uint32_t d) { return (int32_t)(d >> 1) * ((int32_t)(d & 1) * 2 - 1); }
+static inline int32_t rand_dir_dy(uint32_t d) { return (int32_t)((d >> 1) ^ 1) * ((int32_t)(d & 1) * 2 - 1); }
+static inline int32_t wander_dir_dx(uint32_t d) { return (int32_t)(d & 1) * ((int32_t)(d >> 1) * 2 - 1); }
+static inline int32_t wander_dir_dy(uint32_t d) { return (int32_t)((d & 1) ^ 1) * ((int32_t)(d >> 1) * 2 - 1); }
+
+// Instrução atual (word) e contador da seguinte (seen) de cada lane
+static void gather_op(batch_t* b, const agent_lanes_t* a) {
+    int n = a->n_code;
+    for (int k = 0; k < b->active; k++) {
+        int32_t i = a->pc[k];
+        b->word[k] = a->code_word[i];
+        b->seen[k] = a->code_count[i + 1 == n ? 0 : i + 1];
+    }
+}
+
+/* Kernel da instrução (run_op em board.c) sobre as lanes em act. A última jogada
+   da instrução executa-a e passa à seguinte; as anteriores só descontam o
+   contador (e carregam, num movimento com 'C'). À saída act[k] diz se a lane se
+   move, com a direção em dx/dy. O gerador avança sempre numa cópia, que só fica
+   na lane se a instrução for um 'R'. Sem ramos: vetoriza */
+static void kernel_op(int lanes, int n_code, const int32_t* restrict word, const int32_t* restrict seen,
+                      int32_t* restrict act, int32_t* restrict dx, int32_t* restrict dy, int32_t* restrict pc,
+                      int32_t* restrict left, int32_t* restrict charged, uint32_t* restrict rng) {
+    for (int k = 0; k < lanes; k++) {
+        int32_t w = word[k], op = WORD_OP(w), l = left[k], i = pc[k];
+        int32_t more = act[k] & (l > 1);
+        int32_t last = act[k] & (l <= 1);
+        int32_t is_random = last & (op == OP_RANDOM);
+
+        uint32_t s = rng[k], r = s, keep = (uint32_t)is_random - 1;
+        agent_rand(&r);
+        rng[k] = (s & keep) | (r & ~keep);
+        int32_t wdx = WORD_DX(w), wdy = WORD_DY(w);
+        dx[k] = wdx + is_random * (rand_dir_dx(r & 3) - wdx);
+        dy[k] = wdy + is_random * (rand_dir_dy(r & 3) - wdy);
+
+        charged[k] |= (more & WORD_CHARGE(w)) | (last & (op == OP_CHARGE));
+        int32_t next = (i + 1) * (i + 1 != n_code);
+        pc[k] = i + last * (next - i);
+        left[k] = l - more + last * (seen[k] - l);
+        act[k] = last & ((op == OP_MOVE) | is_random);
+    }
+}
+
+/* Kernel do destino: casa de partida (from) e de chegada (cell) de cada lane.
+   Uma lane parada ou que sairia do tabuleiro fica com cell = from. Vetoriza */
+static void kernel_target(int lanes, int w, int h, const int32_t* restrict x, const int32_t* restrict y,
+                          const int32_t* restrict dx, const int32_t* restrict dy,
+                          int32_t* restrict act, int32_t* restrict from, int32_t* restrict cell) {
+    for (int k = 0; k < lanes; k++) {
+        int32_t nx = x[k] + dx[k], ny = y[k] + dy[k];
+        int32_t go = act[k] & (nx >= 0) & (nx < w) & (ny >= 0) & (ny < h);
+        int32_t here = y[k] * w + x[k];
+        from[k] = here;
+        cell[k] = here + go * (dy[k] * w + dx[k]);
+        act[k] = go;
+    }
+}
+
+// O que cada lane vê na casa de chegada, numa palavra (SEEN_*)
+static void gather_cells(batch_t* b) {
+    int K = b->K;
+    for (int k = 0; k < b->active; k++) {
+        size_t c = (size_t)b->cell[k], i = c * K + k;
+        b->seen[k] = (uint8_t)b->content[i] | (b->wall[c] << 8) | (b->portal[c] << 9) | (b->dot[i] << 10);
+    }
+}
+
+/* Escreve o passo nas grelhas: sai de from (MOVE_LEAVE), entra em cell com o
+   conteúdo 'who' (MOVE_ARRIVE) e come o ponto (MOVE_EAT), segundo word[k] */
+static void scatter_cells(batch_t* b, char who) {
+    int K = b->K;
+    for (int k = 0; k < b->active; k++) {
+        size_t oi = (size_t)b->from[k] * K + k, ni = (size_t)b->cell[k] * K + k;
+        int32_t m = b->word[k];
+        b->content[oi] = (m & MOVE_LEAVE) ? ' ' : b->content[oi];
+        b->content[ni] = (m & MOVE_ARRIVE) ? who : b->content[ni];
+        b->dot[ni] &= !(m & MOVE_EAT);
+    }
+}
+
+/* Kernel do passo de um Pacman (resolve_pacman): portal, paredes, outro Pacman,
+   fantasma e ponto, como máscaras sobre o que a lane viu na casa de chegada.
+   Vetoriza */
+static void kernel_pacman_move(int lanes, const int32_t* restrict act, const int32_t* restrict seen,
+                               const int32_t* restrict dx, const int32_t* restrict dy, int32_t* restrict x,
+                               int32_t* restrict y, int32_t* restrict alive, int32_t* restrict points,
+                               int32_t* restrict status, int32_t* restrict word) {
+    for (int k = 0; k < lanes; k++) {
+        int32_t s = seen[k], target = s & SEEN_CONTENT;
+        int32_t win = act[k] & ((s & SEEN_PORTAL) != 0);
+        int32_t open = act[k] & (win ^ 1) & ((s & SEEN_WALL) == 0) & (target != 'P');
+        int32_t dies = open & (target == 'M');
+        int32_t moves = open & (target != 'M');
+        int32_t eat = moves & ((s & SEEN_DOT) != 0);
+
+        points[k] += eat;
+        status[k] += win * (SIM_WIN - status[k]);
+        alive[k] &= dies ^ 1; // A lane só acaba quando morrerem todos
+        x[k] += moves * dx[k];
+        y[k] += moves * dy[k];
+        word[k] = (win | dies | moves) * MOVE_LEAVE | (win | moves) * MOVE_ARRIVE | eat * MOVE_EAT;
+    }
+}
+
+/* Kernel do passo de um fantasma não carregado (resolve_ghost): parado por
+   parede ou outro fantasma; um Pacman na casa morre. À saída act[k] diz se a
+   lane matou um Pacman na nova casa do fantasma. Vetoriza */
+static void kernel_ghost_move(int lanes, int32_t* restrict act, const int32_t* restrict seen,
+                              const int32_t* restrict dx, const int32_t* restrict dy,
+                              int32_t* restrict x, int32_t* restrict y, int32_t* restrict word) {
+    for (int k = 0; k < lanes; k++) {
+        int32_t s = seen[k], target = s & SEEN_CONTENT;
+        int32_t moves = act[k] & ((s & SEEN_WALL) == 0) & (target != 'M');
+
+        x[k] += moves * dx[k];
+        y[k] += moves * dy[k];
+        word[k] = moves * (MOVE_LEAVE | MOVE_ARRIVE);
+        act[k] = moves & (target == 'P');
+    }
+}
+
+// Kernel do sorteio de um fantasma sem script (sim_step), nas lanes em act
+static void kernel_wander(int lanes, const int32_t* restrict act, uint32_t* restrict rng,
+                          int32_t* restrict dx, int32_t* restrict dy) {
+    for (int k = 0; k < lanes; k++) {
+        uint32_t s = rng[k], r = s, keep = (uint32_t)act[k] - 1;
+        agent_rand(&r);
+        rng[k] = (s & keep) | (r & ~keep);
+        dx[k] = wander_dir_dx(r & 3);
+        dy[k] = wander_dir_dy(r & 3);
+    }
+}
+
+// Kernel das mortes por um fantasma: o Pacman vivo na casa (gx, gy), nas lanes em kill
+static void kernel_kill(int lanes, const int32_t* restrict kill, const int32_t* restrict gx,
+                        const int32_t* restrict gy, const int32_t* restrict px, const int32_t* restrict py,
+                        int32_t* restrict alive) {
+    for (int k = 0; k < lanes; k++) alive[k] &= (kill[k] & (px[k] == gx[k]) & (py[k] == gy[k])) ^ 1;
+}
+
+static inline void kill_pacman_at(batch_t* b, int k, int x, int y) {
+    int K = b->K;
+    for (int p = 0; p < b->P; p++) {
+        agent_lanes_t* pac = &b->pac[p];
+        if (pac->alive[k] && pac->x[k] == x && pac->y[k] == y) {
+            pac->alive[k] = 0;
+            b->content[((size_t)y * b->width + x) * K + k] = ' ';
+            return;
+        }
+    }
+}
+
+static void step_pacman_lanes(batch_t* b, int p) {
+    agent_lanes_t* a = &b->pac[p];
+    int lanes = b->active, n = a->n_code;
+    if (n == 0) return; // Sem script (e sem teclado) o Pacman fica parado
+
+    // Lanes ativas: 'G' é saltado e 'Q' termina antes da contagem do passo
+    for (int k = 0; k < lanes; k++) {
+        b->act[k] = 0;
+        if (b->status[k] != SIM_RUNNING || !a->alive[k]) continue;
+        for (int skipped = 0; WORD_OP(a->code_word[a->pc[k]]) == OP_SAVE && skipped < n; skipped++) {
+            a->pc[k] = (a->pc[k] + 1 == n) ? 0 : a->pc[k] + 1;
+            a->left[k] = a->code_count[a->pc[k]];
+        }
+        int op = WORD_OP(a->code_word[a->pc[k]]);
+        if (op == OP_QUIT) { b->status[k] = SIM_QUIT; continue; }
+        b->act[k] = (op != OP_SAVE);
+    }
+    kernel_passo(lanes, a->wait, b->act, a->passo);
+    gather_op(b, a);
+    kernel_op(lanes, n, b->word, b->seen, b->act, b->dx, b->dy, a->pc, a->left, a->charged, a->rng);
+    kernel_target(lanes, b->width, b->height, a->x, a->y, b->dx, b->dy, b->act, b->from, b->cell);
+    gather_cells(b);
+    kernel_pacman_move(lanes, b->act, b->seen, b->dx, b->dy, a->x, a->y, a->alive, a->points, b->status, b->word);
+    scatter_cells(b, 'P');
+}
+
+// Movimento carregado de uma lane (resolve_ghost_charged)
+static void charged_move_lane(batch_t* b, agent_lanes_t* a, int k, int dx, int dy) {
+    int K = b->K, w = b->width, h = b->height;
+    int x = a->x[k], y = a->y[k];
+    a->charged[k] = 0;
+
+    if ((dx < 0 && x == 0) || (dx > 0 && x == w - 1) || (dy < 0 && y == 0) || (dy > 0 && y == h - 1))
+        return; // Já está encostado ao limite: INVALID_MOVE
+
+    // Sem colisão vai até ao limite do tabuleiro
+    int nx = dx < 0 ? 0 : (dx > 0 ? w - 1 : x);
+    int ny = dy < 0 ? 0 : (dy > 0 ? h - 1 : y);
+    for (int cx = x + dx, cy = y + dy; cx >= 0 && cx < w && cy >= 0 && cy < h; cx += dx, cy += dy) {
+        size_t ci = (size_t)cy * w + cx;
+        char c = b->wall[ci] ? 'W' : b->content[ci * K + k];
+        if (c == 'W' || c == 'M') { nx = cx - dx; ny = cy - dy; break; }
+        if (c == 'P') { nx = cx; ny = cy; kill_pacman_at(b, k, cx, cy); break; }
+    }
+
+    b->content[((size_t)y * w + x) * K + k] = ' ';
+    a->x[k] = nx; a->y[k] = ny;
+    b->content[((size_t)ny * w + nx) * K + k] = 'M';
+}
+
+static void step_ghost_lanes(batch_t* b, int g) {
+    agent_lanes_t* a = &b->ghost[g];
+    int lanes = b->active;
+    int32_t* act = b->act;
+
+    for (int k = 0; k < lanes; k++) act[k] = (b->status[k] == SIM_RUNNING);
+
+    // Fantasma sem script: a direção é sorteada em todas as jogadas, mesmo à espera
+    if (a->n_code == 0) kernel_wander(lanes, act, a->rng, b->dx, b->dy);
+    kernel_passo(lanes, a->wait, act, a->passo);
+    if (a->n_code > 0) {
+        gather_op(b, a);
+        kernel_op(lanes, a->n_code, b->word, b->seen, act, b->dx, b->dy, a->pc, a->left, a->charged, a->rng);
+    }
+
+    // A investida anda casa a casa até bater: fica fora dos kernels
+    for (int k = 0; k < lanes; k++) {
+        if (!act[k] || !a->charged[k]) continue;
+        charged_move_lane(b, a, k, b->dx[k], b->dy[k]);
+        act[k] = 0;
+    }
+    kernel_target(lanes, b->width, b->height, a->x, a->y, b->dx, b->dy, act, b->from, b->cell);
+    gather_cells(b);
+    kernel_ghost_move(lanes, act, b->seen, b->dx, b->dy, a->x, a->y, b->word);
+    scatter_cells(b, 'M');
+    for (int p = 0; p < b->P; p++) {
+        agent_lanes_t* pac = &b->pac[p];
+        kernel_kill(lanes, act, a->x, a->y, pac->x, pac->y, pac->alive);
+    }
+}
+
+// Lanes sem nenhum Pacman vivo acabam em SIM_DEATH; devolve quantas continuam
+static int mark_dead_lanes(batch_t* b) {
+    int lanes = b->active, running = 0;
+    int32_t* restrict any = b->act;
+    int32_t* restrict status = b->status;
+
+    for (int k = 0; k < lanes; k++) any[k] = 0;
+    for (int p = 0; p < b->P; p++) {
+        const int32_t* restrict alive = b->pac[p].alive;
+        for (int k = 0; k < lanes; k++) any[k] |= alive[k];
+    }
+    for (int k = 0; k < lanes; k++) {
+        int32_t live = (status[k] == SIM_RUNNING);
+        status[k] = (live & !any[k]) ? SIM_DEATH : status[k];
+        running += live & any[k];
+    }
+    return running;
+}
+
+static inline void swap_i32(int32_t* v, int s, int t) {
+    int32_t tmp = v[s];
+    v[s] = v[t];
+    v[t] = tmp;
+}
+
+static void swap_agent(agent_lanes_t* a, int s, int t) {
+    swap_i32(a->x, s, t);
+    swap_i32(a->y, s, t);
+    swap_i32(a->pc, s, t);
+    swap_i32(a->wait, s, t);
+    swap_i32(a->left, s, t);
+    swap_i32(a->charged, s, t);
+    swap_i32(a->alive, s, t);
+    swap_i32(a->points, s, t);
+    swap_i32((int32_t*)a->rng, s, t);
+}
+
+/* Passa a lane do slot s (ainda a jogar) para o slot t (já acabou): o estado dos
+   agentes, o desfecho e as jogadas trocam de slot. As grelhas ficam para
+   compact_slots */
+static void move_slot(batch_t* b, int s, int t) {
+    for (int p = 0; p < b->P; p++) swap_agent(&b->pac[p], s, t);
+    for (int g = 0; g < b->G; g++) swap_agent(&b->ghost[g], s, t);
+    swap_i32(b->status, s, t);
+    swap_i32(b->ticks, s, t);
+    swap_i32(b->lane, s, t);
+    b->slot[b->lane[s]] = s;
+    b->slot[b->lane[t]] = t;
+}
+
+/* Junta as lanes que ainda jogam nos primeiros slots, passando-as para os slots
+   das que já acabaram (a grelha de uma lane que acabou já não é lida). As
+   colunas das grelhas vão todas numa só passagem pelas casas, com as linhas de
+   K lanes de cada casa seguidas na memória. Só se faz quando metade dos slots
+   ativos já não joga */
+static void compact_slots(batch_t* b, int running) {
+    int32_t* src = b->from;
+    int32_t* dst = b->cell;
+    int n_moves = 0, lo = 0, hi = b->active - 1;
+    for (;;) {
+        while (lo < hi && b->status[lo] == SIM_RUNNING) lo++;
+        while (hi > lo && b->status[hi] != SIM_RUNNING) hi--;
+        if (lo >= hi) break;
+        move_slot(b, hi, lo);
+        src[n_moves] = hi;
+        dst[n_moves++] = lo;
+    }
+
+    size_t cells = (size_t)b->width * b->height, K = b->K;
+    for (size_t c = 0; c < cells; c++) {
+        char* content = &b->content[c * K];
+        uint8_t* dot = &b->dot[c * K];
+        for (int m = 0; m < n_moves; m++) {
+            content[dst[m]] = content[src[m]];
+            dot[dst[m]] = dot[src[m]];
+        }
+    }
+    b->active = running;
+}
+
+int batch_step(batch_t* b) {
+    int lanes = b->active;
+    for (int k = 0; k < lanes; k++) b->ticks[k] += (b->status[k] == SIM_RUNNING);
+
+    for (int p = 0; p < b->P; p++) step_pacman_lanes(b, p);
+    mark_dead_lanes(b);
+    for (int g = 0; g < b->G; g++) step_ghost_lanes(b, g);
+
+    // Morte passiva e contagem das lanes que continuam
+    int running = mark_dead_lanes(b);
+    if (running <= lanes / 2) compact_slots(b, running);
+    return running;
+}
+
+// ==================================================================
+// VERIFICAÇÃO CONTRA O CAMINHO ESCALAR
+// ==================================================================
+static int compare_lane(const batch_t* b, const board_t* s, int k, int tick, char* err, size_t err_len) {
+    int slot = b->slot[k];
+    for (int p = 0; p < b->P; p++) {
+        const agent_lanes_t* a = &b->pac[p];
+        const pacman_t* pac = &s->pacmans[p];
+        if (a->x[slot] != pac->pos_x || a->y[slot] != pac->pos_y || a->alive[slot] != pac->alive ||
+            a->points[slot] != pac->points || a->pc[slot] != pac->pc || a->left[slot] != pac->left || a->wait[slot] != pac->waiting) {
+            snprintf(err, err_len, "lane %d, jogada %d: Pacman %d difere (batch %d,%d vs %d,%d)",
+                     k, tick, p, a->x[slot], a->y[slot], pac->pos_x, pac->pos_y);
+            return -1;
+        }
+    }
+    for (int g = 0; g < b->G; g++) {
+        const agent_lanes_t* a = &b->ghost[g];
+        const ghost_t* ghost = &s->ghosts[g];
+        if (a->x[slot] != ghost->pos_x || a->y[slot] != ghost->pos_y || a->charged[slot] != ghost->charged ||
+            a->pc[slot] != ghost->pc || a->left[slot] != ghost->left || a->wait[slot] != ghost->waiting) {
+            snprintf(err, err_len, "lane %d, jogada %d: fantasma %d difere (batch %d,%d vs %d,%d)",
+                     k, tick, g, a->x[slot], a->y[slot], ghost->pos_x, ghost->pos_y);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int batch_verify(const board_t* level, int K, int ticks, uint32_t seed, char* err, size_t err_len) {
+    batch_t b;
+    if (batch_init(&b, level, K, seed) != 0) { snprintf(err, err_len, "sem memória"); return -1; }
+
+    board_t* clones = calloc(K, sizeof(board_t));
+    int* status = calloc(K, sizeof(int));
+    for (int k = 0; k < K; k++) {
+        board_clone(&clones[k], level);
+        board_seed(&clones[k], seed + (uint32_t)k);
+    }
+
+    int rc = 0;
+    for (int t = 1; t <= ticks && rc == 0; t++) {
+        batch_step(&b);
+        for (int k = 0; k < K && rc == 0; k++) {
+            if (status[k] == SIM_RUNNING) status[k] = sim_step(&clones[k]);
+            if (status[k] != b.status[b.slot[k]]) {
+                snprintf(err, err_len, "lane %d, jogada %d: desfecho %s vs %s", k, t,
+                         sim_outcome_name(b.status[b.slot[k]]), sim_outcome_name(status[k]));
+                rc = -1;
+            }
+            else if (status[k] == SIM_RUNNING) {
+                rc = compare_lane(&b, &clones[k], k, t, err, err_len);
+            }
+        }
+    }
+
+    for (int k = 0; k < K; k++) board_free_clone(&clones[k]);
+    free(clones);
+    free(status);
+    batch_free(&b);
+    return rc;
+}
+
+// ==================================================================
+// MODO --batch
+// ==================================================================
+static double elapsed(const struct timespec* t0, const struct timespec* t1) {
+    return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+static void bench_level(const board_t* level, const char* name, int K, int ticks, uint32_t seed) {
+    char err[256];
+    int verify_lanes = K < BATCH_VERIFY_LANES ? K : BATCH_VERIFY_LANES;
+    if (batch_verify(level, verify_lanes, ticks, seed, err, sizeof(err)) != 0) {
+        printf("%s: VERIFICAÇÃO FALHOU: %s\n", name, err);
+        return;
+    }
+
+    struct timespec t0, t1;
+    long scalar_ticks = 0, batch_ticks = 0;
+
+    // K board_t jogados um a um com sim_step, as mesmas regras que as lanes (sem
+    // as janelas de trajetórias de sim_run, que medem outra coisa)
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    board_t clone;
+    memset(&clone, 0, sizeof(clone));
+    for (int k = 0; k < K; k++) {
+        board_clone(&clone, level);
+        board_seed(&clone, seed + (uint32_t)k);
+        int t = 0;
+        while (t < ticks) {
+            t++;
+            if (sim_step(&clone) != SIM_RUNNING) break;
+        }
+        scalar_ticks += t;
+    }
+    board_free_clone(&clone);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double scalar_secs = elapsed(&t0, &t1);
+
+    // K lanes em lockstep
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    batch_t b;
+    if (batch_init(&b, level, K, seed) != 0) return;
+    for (int t = 0; t < ticks && batch_step(&b) > 0; t++) { }
+    for (int k = 0; k < K; k++) batch_ticks += b.ticks[k];
+    batch_free(&b);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double batch_secs = elapsed(&t0, &t1);
+
+    printf("%s: verificado (%d lanes), K=%d\n", name, verify_lanes, K);
+    printf("  escalar: %ld jogadas em %.3f s (%.0f jogadas/s)\n", scalar_ticks, scalar_secs, scalar_ticks / scalar_secs);
+    printf("  batch:   %ld jogadas em %.3f s (%.0f jogadas/s, %.1fx)\n", batch_ticks, batch_secs,
+           batch_ticks / batch_secs, (batch_ticks / batch_secs) / (scalar_ticks / scalar_secs));
+}
+
+int batch_main(int argc, char** argv) {
+    if (argc < 2) { printf("Usage: %s <dir> [K] [ticks]\n", argv[0]); return 1; }
+    const char* dir_path = argv[1];
+    int K = (argc >= 3) ? atoi(argv[2]) : BATCH_DEFAULT_LANES;
+    int ticks = (argc >= 4) ? atoi(argv[3]) : BATCH_DEFAULT_TICKS;
+    if (K < 1) K = 1;
+
+    struct dirent** namelist;
+    int n = scandir(dir_path, &namelist, filter_levels, alphasort);
+    if (n < 0) { perror("scandir"); return 1; }
+
+    srand(time(NULL));
+    uint32_t seed = (uint32_t)rand();
+    for (int i = 0; i < n; i++) {
+        board_t level;
+        memset(&level, 0, sizeof(level));
+        if (load_level(&level, dir_path, namelist[i]->d_name, 0) == 0) {
+            // As lanes têm um número fixo de fantasmas
+            if (board_has_spawning(&level)) printf("%s: nível com ninhos ou 'X' (sem batch)\n", namelist[i]->d_name);
+            else bench_level(&level, namelist[i]->d_name, K, ticks, seed);
+            unload_level(&level);
+        }
+        else {
+            printf("%s: nível rejeitado\n", namelist[i]->d_name);
+        }
+        free(namelist[i]);
+    }
+    free(namelist);
+    return 0;
+}
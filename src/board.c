@@ -4,25 +4,218 @@
 #include <time.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <string.h>
+#include <errno.h>
 
 FILE * debugfile;
 
+// Tipos de chave Zobrist (cada componente do estado tem a sua família de chaves)
+enum {
+    ZK_PAC_POS = 1, ZK_PAC_CURSOR, ZK_PAC_WAIT, ZK_PAC_TURNS, ZK_PAC_ALIVE,
+    ZK_GHOST_POS, ZK_GHOST_CURSOR, ZK_GHOST_WAIT, ZK_GHOST_TURNS, ZK_GHOST_CHARGED,
+    ZK_DOT,
+};
+
+// Chave pseudo-aleatória de (tipo, agente, valor): finalizador splitmix64, sem tabelas
+static inline uint64_t zobrist_key(uint64_t kind, uint64_t a, uint64_t b) {
+    uint64_t z = (kind << 56) ^ (a << 32) ^ b;
+    z += 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// As threads dos agentes alteram o hash em paralelo: o XOR é comutativo, basta ser atómico
+static inline void hash_toggle(board_t* board, uint64_t key) {
+    __atomic_fetch_xor(&board->hash, key, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t cell_key(const board_t* board, int x, int y) {
+    return (uint64_t)y * board->width + x;
+}
+
+static inline uint64_t pacman_alive_key(int p) {
+    return zobrist_key(ZK_PAC_ALIVE, p, 0);
+}
+
+// Estado do Pacman sem a flag de vivo (as mortes sem locks atualizam-na à parte)
+static uint64_t pacman_state_key(const board_t* board, int p) {
+    const pacman_t* pac = &board->pacmans[p];
+    int turns = pac->n_code > 0 ? pac->left : 0;
+    return zobrist_key(ZK_PAC_POS, p, cell_key(board, pac->pos_x, pac->pos_y))
+         ^ zobrist_key(ZK_PAC_CURSOR, p, pac->pc)
+         ^ zobrist_key(ZK_PAC_WAIT, p, pac->waiting)
+         ^ zobrist_key(ZK_PAC_TURNS, p, turns);
+}
+
+static uint64_t pacman_key(const board_t* board, int p) {
+    uint64_t k = pacman_state_key(board, p);
+    return board->pacmans[p].alive ? k ^ pacman_alive_key(p) : k;
+}
+
+// Uma vaga livre não conta para o estado
+static uint64_t ghost_key(const board_t* board, int g) {
+    const ghost_t* ghost = &board->ghosts[g];
+    if (!ghost->active) return 0;
+    int turns = ghost->n_code > 0 ? ghost->left : 0;
+    return zobrist_key(ZK_GHOST_POS, g, cell_key(board, ghost->pos_x, ghost->pos_y))
+         ^ zobrist_key(ZK_GHOST_CURSOR, g, ghost->pc)
+         ^ zobrist_key(ZK_GHOST_WAIT, g, ghost->waiting)
+         ^ zobrist_key(ZK_GHOST_TURNS, g, turns)
+         ^ zobrist_key(ZK_GHOST_CHARGED, g, ghost->charged);
+}
+
+static inline uint64_t dot_key(uint64_t index) {
+    return zobrist_key(ZK_DOT, 0, index);
+}
+
+uint64_t board_hash_full(const board_t* board) {
+    uint64_t h = 0;
+    for (int p = 0; p < board->n_pacmans; p++) h ^= pacman_key(board, p);
+    for (int g = 0; g < board->n_ghosts; g++) h ^= ghost_key(board, g);
+
+    // Só os blocos reais podem ter pontos
+    int cw = 1 << board->chunk_shift_x, ch = 1 << board->chunk_shift_y;
+    for (int cy = 0; cy < board->chunks_y; cy++) {
+        for (int cx = 0; cx < board->chunks_x; cx++) {
+            if (board_chunk(board, cx, cy) == board_wall_chunk) continue;
+            for (int y = cy * ch; y < (cy + 1) * ch && y < board->height; y++) {
+                for (int x = cx * cw; x < (cx + 1) * cw && x < board->width; x++) {
+                    if (board_at(board, x, y)->has_dot) h ^= dot_key(cell_key(board, x, y));
+                }
+            }
+        }
+    }
+    return h;
+}
+
+void board_rehash(board_t* board) {
+    board->hash = board_hash_full(board);
+}
+
+// Um fantasma apanhou o Pacman: a casa fica com o fantasma. A flag passa a 0 uma só
+// vez, mesmo com dois fantasmas a chegar ao mesmo tempo
+static int kill_once(board_t* board, int p) {
+    if (!__atomic_exchange_n(&board->pacmans[p].alive, 0, __ATOMIC_SEQ_CST)) return 0;
+    debug("Killing %d pacman\n\n", p);
+    hash_toggle(board, pacman_alive_key(p));
+    return 1;
+}
+
 // Helper private function to find and kill pacman at specific position
 static int find_and_kill_pacman(board_t* board, int new_x, int new_y) {
     for (int p = 0; p < board->n_pacmans; p++) {
         pacman_t* pac = &board->pacmans[p];
-        if (pac->pos_x == new_x && pac->pos_y == new_y && pac->alive) {
-            pac->alive = 0;
-            kill_pacman(board, p);
+        if (__atomic_load_n(&pac->pos_x, __ATOMIC_SEQ_CST) == new_x &&
+            __atomic_load_n(&pac->pos_y, __ATOMIC_SEQ_CST) == new_y && kill_once(board, p))
             return DEAD_PACMAN;
-        }
     }
     return VALID_MOVE;
 }
 
-// Helper private function for getting board position index
-int get_board_index(board_t* board, int x, int y) {
-    return y * board->width + x;
+size_t get_board_index(const board_t* board, int x, int y) {
+    return (size_t)y * board->width + x;
+}
+
+// ==================================================================
+// ARMAZENAMENTO ESPARSO POR BLOCOS
+// ==================================================================
+board_pos_t board_wall_chunk[BOARD_CHUNK_CELLS];
+static pthread_once_t wall_chunk_once = PTHREAD_ONCE_INIT;
+
+const uint16_t board_morton_spread[1 << BOARD_TILE_SHIFT] = {
+       0,    1,    4,    5,   16,   17,   20,   21,   64,   65,   68,   69,   80,   81,   84,   85,
+     256,  257,  260,  261,  272,  273,  276,  277,  320,  321,  324,  325,  336,  337,  340,  341,
+    1024, 1025, 1028, 1029, 1040, 1041, 1044, 1045, 1088, 1089, 1092, 1093, 1104, 1105, 1108, 1109,
+    1280, 1281, 1284, 1285, 1296, 1297, 1300, 1301, 1344, 1345, 1348, 1349, 1360, 1361, 1364, 1365,
+};
+
+static const char* layout_names[BOARD_N_LAYOUTS] = { "tiled", "morton", "rows" };
+static int default_layout = -1; // -1 = ainda não escolhido (ver board_default_layout)
+
+static void init_wall_chunk(void) {
+    for (int i = 0; i < BOARD_CHUNK_CELLS; i++) board_wall_chunk[i].content = 'W';
+}
+
+void board_set_layout(int layout) {
+    default_layout = layout;
+}
+
+int board_parse_layout(const char* name) {
+    for (int l = 0; l < BOARD_N_LAYOUTS; l++) {
+        if (strcmp(name, layout_names[l]) == 0) return l;
+    }
+    return -1;
+}
+
+int board_default_layout(void) {
+    if (default_layout < 0) {
+        const char* env = getenv("PACMANIST_LAYOUT");
+        int l = env ? board_parse_layout(env) : -1;
+        default_layout = l >= 0 ? l : BOARD_LAYOUT_MORTON;
+    }
+    return default_layout;
+}
+
+const char* board_layout_name(int layout) {
+    return (layout >= 0 && layout < BOARD_N_LAYOUTS) ? layout_names[layout] : "?";
+}
+
+int board_alloc_cells(board_t* board, int width, int height) {
+    return board_alloc_cells_layout(board, width, height, board_default_layout());
+}
+
+int board_alloc_cells_layout(board_t* board, int width, int height, int layout) {
+    board->chunks = NULL;
+    board->chunks_x = board->chunks_y = 0;
+    if (width <= 0 || height <= 0 || width > MAX_BOARD_DIM || height > MAX_BOARD_DIM) return -1;
+    if (layout < 0 || layout >= BOARD_N_LAYOUTS) return -1;
+    pthread_once(&wall_chunk_once, init_wall_chunk);
+
+    // Todos os layouts têm blocos do mesmo tamanho: só muda a forma e a ordem lá dentro
+    board->layout = layout;
+    board->chunk_shift_x = (layout == BOARD_LAYOUT_ROWS) ? BOARD_CHUNK_BITS : BOARD_TILE_SHIFT;
+    board->chunk_shift_y = BOARD_CHUNK_BITS - board->chunk_shift_x;
+    int cx = (int)(((size_t)width + (1u << board->chunk_shift_x) - 1) >> board->chunk_shift_x);
+    int cy = (int)(((size_t)height + (1u << board->chunk_shift_y) - 1) >> board->chunk_shift_y);
+    size_t n = (size_t)cx * cy;
+    board_pos_t** chunks = malloc(n * sizeof(board_pos_t*));
+    if (!chunks) return -1;
+    for (size_t i = 0; i < n; i++) chunks[i] = board_wall_chunk;
+
+    board->chunks = chunks;
+    board->chunks_x = cx;
+    board->chunks_y = cy;
+    return 0;
+}
+
+void board_free_cells(board_t* board) {
+    if (!board->chunks) return;
+    size_t n = (size_t)board->chunks_x * board->chunks_y;
+    for (size_t i = 0; i < n; i++) {
+        if (board->chunks[i] != board_wall_chunk) free(board->chunks[i]);
+    }
+    free(board->chunks);
+    board->chunks = NULL;
+    board->chunks_x = board->chunks_y = 0;
+}
+
+size_t board_chunks_used(const board_t* board) {
+    size_t n = (size_t)board->chunks_x * board->chunks_y, used = 0;
+    for (size_t i = 0; i < n; i++) used += board->chunks[i] != board_wall_chunk;
+    return used;
+}
+
+board_pos_t* board_at_mut(board_t* board, int x, int y) {
+    board_pos_t** slot = &board->chunks[(size_t)(y >> board->chunk_shift_y) * board->chunks_x + (x >> board->chunk_shift_x)];
+    if (*slot == board_wall_chunk) {
+        board_pos_t* chunk = malloc(sizeof(board_wall_chunk));
+        if (!chunk) return NULL;
+        memcpy(chunk, board_wall_chunk, sizeof(board_wall_chunk));
+        *slot = chunk;
+    }
+    // O bloco já é só deste tabuleiro: a casa pode ser escrita
+    return (board_pos_t*)board_at(board, x, y);
 }
 
 // Helper private function for checking valid position
@@ -30,6 +223,159 @@ static inline int is_valid_position(board_t* board, int x, int y) {
     return (x >= 0 && x < board->width) && (y >= 0 && y < board->height); // Inside of the board boundaries
 }
 
+// Casas de um tabuleiro partilhado entre threads (move_*_shared): cada casa é lida e
+// trocada inteira. Os outros caminhos têm o tabuleiro só para si e escrevem as casas
+// diretamente.
+_Static_assert(sizeof(board_pos_t) == sizeof(uint16_t), "board_pos_t tem de caber numa palavra de 16 bits");
+
+static inline board_pos_t cell_load(const board_pos_t* cell) {
+    board_pos_t seen;
+    __atomic_load(cell, &seen, __ATOMIC_SEQ_CST);
+    return seen;
+}
+
+// Troca a casa se ainda está como *seen; senão *seen fica com o que lá está agora
+static inline int cell_cas(board_pos_t* cell, board_pos_t* seen, board_pos_t want) {
+    return __atomic_compare_exchange(cell, seen, &want, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline char cell_content(const board_pos_t* cell) {
+    return __atomic_load_n(&cell->content, __ATOMIC_RELAXED);
+}
+
+// Deixa a casa vazia se o agente (who) ainda lá está; um fantasma que entrou entretanto fica
+static void cell_release(board_pos_t* cell, char who) {
+    board_pos_t seen = cell_load(cell);
+    while (seen.content == who) {
+        board_pos_t empty = seen;
+        empty.content = ' ';
+        if (cell_cas(cell, &seen, empty)) return;
+    }
+}
+
+void lock_all_rows(board_t* board) {
+    if (!board->row_locks) return;
+    // Ordem crescente obrigatória
+    for (int i = 0; i < board->height; i++) {
+        pthread_mutex_lock(&board->row_locks[i]);
+    }
+}
+
+void unlock_all_rows(board_t* board) {
+    if (!board->row_locks) return;
+    for (int i = 0; i < board->height; i++) {
+        pthread_mutex_unlock(&board->row_locks[i]);
+    }
+}
+
+// splitmix32 para espalhar a semente por agentes (o estado nunca pode ser 0)
+static uint32_t mix_seed(uint32_t seed, uint32_t salt) {
+    uint32_t z = seed + 0x9E3779B9u * (salt + 1);
+    z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+    z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+    z ^= z >> 16;
+    return z ? z : 0x6D2B79F5u;
+}
+
+void board_seed(board_t* board, uint32_t seed) {
+    board->seed = seed;
+    for (int p = 0; p < board->n_pacmans; p++)
+        board->pacmans[p].rng = mix_seed(seed, 2 * p);
+    for (int g = 0; g < board->n_ghosts; g++)
+        board->ghosts[g].rng = mix_seed(seed, 2 * g + 1);
+}
+
+// Copia os blocos de src para dst (mesmas dimensões), reutilizando os blocos reais de dst
+static int clone_chunks(board_t* dst, const board_t* src) {
+    size_t n = (size_t)src->chunks_x * src->chunks_y;
+    for (size_t i = 0; i < n; i++) {
+        if (src->chunks[i] == board_wall_chunk) {
+            if (dst->chunks[i] != board_wall_chunk) free(dst->chunks[i]);
+            dst->chunks[i] = board_wall_chunk;
+            continue;
+        }
+        if (dst->chunks[i] == board_wall_chunk) {
+            board_pos_t* chunk = malloc(sizeof(board_wall_chunk));
+            if (!chunk) return -1;
+            dst->chunks[i] = chunk;
+        }
+        memcpy(dst->chunks[i], src->chunks[i], sizeof(board_wall_chunk));
+    }
+    return 0;
+}
+
+// Ninhos e listas de vagas: cada clone tem as suas (as vagas livres mudam ao jogar)
+static int clone_slots(board_t* dst, const board_t* src) {
+    int spare = src->n_ghosts - src->spawn_base;
+    if (!dst->leaving || dst->n_ghosts != src->n_ghosts || dst->n_nests != src->n_nests ||
+        dst->spawn_base != src->spawn_base) {
+        nest_t* nests = realloc(dst->nests, (src->n_nests ? src->n_nests : 1) * sizeof(nest_t));
+        if (nests) dst->nests = nests;
+        int* free_slots = realloc(dst->free_slots, (spare ? spare : 1) * sizeof(int));
+        if (free_slots) dst->free_slots = free_slots;
+        int* leaving = realloc(dst->leaving, (src->n_ghosts ? src->n_ghosts : 1) * sizeof(int));
+        if (leaving) dst->leaving = leaving;
+        if (!nests || !free_slots || !leaving) return -1;
+    }
+    dst->n_nests = src->n_nests;
+    dst->spawn_base = src->spawn_base;
+    dst->n_leaving = src->n_leaving;
+    memcpy(dst->nests, src->nests, src->n_nests * sizeof(nest_t));
+    if (src->free_slots) memcpy(dst->free_slots, src->free_slots, spare * sizeof(int));
+    if (src->leaving) memcpy(dst->leaving, src->leaving, src->n_leaving * sizeof(int));
+    return 0;
+}
+
+int board_clone(board_t* dst, const board_t* src) {
+    // Reutilizar os buffers de dst quando as dimensões e o layout batem certo
+    if (!dst->chunks || dst->width != src->width || dst->height != src->height || dst->layout != src->layout) {
+        board_free_cells(dst);
+        if (board_alloc_cells_layout(dst, src->width, src->height, src->layout) != 0) return -1;
+    }
+    if (clone_chunks(dst, src) != 0) return -1;
+    if (!dst->pacmans || dst->n_pacmans != src->n_pacmans) {
+        pacman_t* p = realloc(dst->pacmans, (src->n_pacmans ? src->n_pacmans : 1) * sizeof(pacman_t));
+        if (!p) return -1;
+        dst->pacmans = p;
+    }
+    if (!dst->ghosts || dst->n_ghosts != src->n_ghosts) {
+        ghost_t* g = realloc(dst->ghosts, (src->n_ghosts ? src->n_ghosts : 1) * sizeof(ghost_t));
+        if (!g) return -1;
+        dst->ghosts = g;
+    }
+    if (clone_slots(dst, src) != 0) return -1;
+
+    dst->width = src->width;
+    dst->height = src->height;
+    dst->n_pacmans = src->n_pacmans;
+    dst->n_ghosts = src->n_ghosts;
+    dst->tempo = src->tempo;
+    dst->seed = src->seed;
+    dst->hash = src->hash;
+    dst->trajs = src->trajs;
+    atomic_store(&dst->state, atomic_load(&src->state));
+    atomic_store(&dst->save_request, 0);
+    dst->row_locks = NULL; // Clone de uma só thread
+    memcpy(dst->level_name, src->level_name, sizeof(dst->level_name));
+
+    memcpy(dst->pacmans, src->pacmans, src->n_pacmans * sizeof(pacman_t));
+    memcpy(dst->ghosts, src->ghosts, src->n_ghosts * sizeof(ghost_t));
+    return 0;
+}
+
+void board_free_clone(board_t* clone) {
+    board_free_cells(clone);
+    free(clone->pacmans);
+    free(clone->ghosts);
+    free(clone->nests);
+    free(clone->free_slots);
+    free(clone->leaving);
+    clone->pacmans = NULL;
+    clone->ghosts = NULL;
+    clone->nests = NULL;
+    clone->free_slots = clone->leaving = NULL;
+}
+
 void sleep_ms(int milliseconds) {
     struct timespec ts;
     ts.tv_sec = milliseconds / 1000;
@@ -37,136 +383,265 @@ void sleep_ms(int milliseconds) {
     nanosleep(&ts, NULL);
 }
 
-int move_pacman(board_t* board, int pacman_index, command_t* command) {
-    if (pacman_index < 0 || !board->pacmans[pacman_index].alive) {
-        return DEAD_PACMAN; // Invalid or dead pacman
-    }
+// ==================================================================
+// ESTADO DO NÍVEL E SONO DA THREAD DE JOGO
+// ==================================================================
+int board_init_wake(board_t* board) {
+    pthread_condattr_t attr;
+    if (pthread_condattr_init(&attr) != 0) return -1;
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC); // Os prazos do relógio das jogadas
+    int err = pthread_cond_init(&board->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    if (err != 0) return -1;
+    pthread_mutex_init(&board->wake_lock, NULL);
+    board->wake_pending = 0;
+    return 0;
+}
 
-    pacman_t* pac = &board->pacmans[pacman_index];
-    int old_x = pac->pos_x;
-    int old_y = pac->pos_y;
-    int new_x = old_x;
-    int new_y = old_y;
+void board_destroy_wake(board_t* board) {
+    pthread_cond_destroy(&board->wake);
+    pthread_mutex_destroy(&board->wake_lock);
+}
 
-    // check passo
-    if (pac->waiting > 0) {
-        pac->waiting -= 1;
-        return VALID_MOVE;        
-    }
-    pac->waiting = pac->passo;
+int board_running(board_t* board) {
+    return atomic_load(&board->state) == GAME_RUNNING;
+}
 
-    char direction = command->command;
+int board_finish(board_t* board, int state) {
+    int running = GAME_RUNNING;
+    if (!atomic_compare_exchange_strong(&board->state, &running, state)) return 0;
+    board_wake(board);
+    return 1;
+}
 
-    if (direction == 'R') {
-        char directions[] = {'W', 'S', 'A', 'D'};
-        direction = directions[rand() % 4];
+// O pedido fica marcado: uma thread que ainda não adormeceu não o perde
+void board_wake(board_t* board) {
+    pthread_mutex_lock(&board->wake_lock);
+    board->wake_pending = 1;
+    pthread_cond_signal(&board->wake);
+    pthread_mutex_unlock(&board->wake_lock);
+}
+
+int board_sleep_until(board_t* board, const struct timespec* deadline) {
+    pthread_mutex_lock(&board->wake_lock);
+    int err = 0;
+    while (!board->wake_pending && err != ETIMEDOUT) {
+        err = deadline ? pthread_cond_timedwait(&board->wake, &board->wake_lock, deadline)
+                       : pthread_cond_wait(&board->wake, &board->wake_lock);
     }
+    int woken = board->wake_pending;
+    board->wake_pending = 0;
+    pthread_mutex_unlock(&board->wake_lock);
+    return woken;
+}
 
-    // Calculate new position based on direction
-    switch (direction) {
-        case 'W': // Up
-            new_y--;
+// 'R' sorteia entre estas direções (a ordem faz parte da sequência de cada semente)
+static const script_op_t random_moves[4] = {
+    { .op = OP_MOVE, .direction = 'W', .dy = -1, .count = 1 },
+    { .op = OP_MOVE, .direction = 'S', .dy = 1,  .count = 1 },
+    { .op = OP_MOVE, .direction = 'A', .dx = -1, .count = 1 },
+    { .op = OP_MOVE, .direction = 'D', .dx = 1,  .count = 1 },
+};
+
+// Passa à instrução seguinte do script; sem script (teclado, fantasma sem script) não há cursor
+static inline void next_op(const script_op_t* code, int n_code, int* pc, int* left) {
+    if (n_code == 0) return;
+    *pc = (*pc + 1 == n_code) ? 0 : *pc + 1;
+    *left = code[*pc].count;
+}
+
+/* Uma jogada de ação (o passo já foi descontado). As jogadas de uma instrução
+   antes da última só descontam o contador: voltas de um 'T' ou a carga de um
+   'C' fundido. Devolve o movimento a fazer, ou NULL se a jogada é de espera;
+   *runnable fica a 0 se a instrução não se executa aqui ('G' e 'Q') */
+static const script_op_t* run_op(const script_op_t* op, const script_op_t* code, int n_code,
+                                 int* pc, int* left, uint32_t* rng, int* charged, int* runnable) {
+    *runnable = 1;
+    if (*left > 1) {
+        *left -= 1;
+        *charged |= op->charge;
+        return NULL;
+    }
+    const script_op_t* move = op;
+    switch (op->op) {
+        case OP_MOVE:
             break;
-        case 'S': // Down
-            new_y++;
+        case OP_RANDOM:
+            move = &random_moves[agent_rand(rng) % 4];
             break;
-        case 'A': // Left
-            new_x--;
+        case OP_CHARGE:
+            *charged = 1;
+            move = NULL;
             break;
-        case 'D': // Right
-            new_x++;
+        case OP_WAIT:
+            move = NULL;
             break;
-        case 'T': // Wait
-            if (command->turns_left == 1) {
-                pac->current_move += 1; // move on
-                command->turns_left = command->turns;
-            }
-            else command->turns_left -= 1;
-            return VALID_MOVE;
         default:
-            return INVALID_MOVE; // Invalid direction
+            *runnable = 0;
+            return NULL;
+    }
+    next_op(code, n_code, pc, left);
+    return move;
+}
+
+static inline void set_intent(intent_t* intent, const script_op_t* move) {
+    intent->move = 1;
+    intent->direction = move->direction;
+    intent->dx = move->dx;
+    intent->dy = move->dy;
+}
+
+/* Fase de decisão do Pacman: só mexe no estado do próprio agente (passo,
+   cursor, contador da instrução, gerador). Não lê nem escreve o tabuleiro. */
+static int plan_pacman_impl(board_t* board, int pacman_index, const script_op_t* op, intent_t* intent) {
+    pacman_t* pac = &board->pacmans[pacman_index];
+    intent->move = 0;
+    intent->charged = 0;
+
+    // check passo
+    if (pac->waiting > 0) {
+        pac->waiting -= 1;
+        return VALID_MOVE;        
     }
+    pac->waiting = pac->passo;
+
+    int charged = 0, runnable; // O compilador não deixa um Pacman carregar
+    const script_op_t* move = run_op(op, pac->code, pac->n_code, &pac->pc, &pac->left,
+                                     &pac->rng, &charged, &runnable);
+    if (!runnable) return INVALID_MOVE;
+    if (move) set_intent(intent, move);
+    return VALID_MOVE;
+}
+
+/* Fase de resolução do Pacman: aplica a intenção ao tabuleiro.
+   O chamador tem de ter acesso exclusivo ao tabuleiro. */
+static int resolve_pacman_impl(board_t* board, int pacman_index, const intent_t* intent) {
+    pacman_t* pac = &board->pacmans[pacman_index];
+    if (!pac->alive) return DEAD_PACMAN;
 
-    // Logic for the WASD movement
-    pac->current_move+=1;
+    int old_x = pac->pos_x;
+    int old_y = pac->pos_y;
+    int new_x = old_x + intent->dx;
+    int new_y = old_y + intent->dy;
 
     // Check boundaries
     if (!is_valid_position(board, new_x, new_y)) {
         return INVALID_MOVE;
     }
 
-    // --- CORREÇÃO: ADICIONAR LOCKS NO PACMAN ---
-    int min_y = (old_y < new_y) ? old_y : new_y;
-    int max_y = (old_y < new_y) ? new_y : old_y;
-    
-    pthread_mutex_lock(&board->row_locks[min_y]);
-    if (min_y != max_y) pthread_mutex_lock(&board->row_locks[max_y]);
-    // ------------------------------------------
-
-    int result = VALID_MOVE;
-    int new_index = get_board_index(board, new_x, new_y);
-    int old_index = get_board_index(board, pac->pos_x, pac->pos_y);
-    char target_content = board->board[new_index].content;
+    // A casa de chegada só é pedida para escrita depois de se saber que não é parede
+    const board_pos_t* target = board_at(board, new_x, new_y);
+    board_pos_t* old_cell = board_at_mut(board, old_x, old_y);
+    char target_content = target->content;
 
-    if (board->board[new_index].has_portal) {
-        board->board[old_index].content = ' ';
-        board->board[new_index].content = 'P';
-        result = REACHED_PORTAL;
-        goto unlock_pacman;
+    if (target->has_portal) {
+        board_pos_t* new_cell = board_at_mut(board, new_x, new_y);
+        old_cell->content = ' ';
+        new_cell->content = 'P';
+        return REACHED_PORTAL;
     }
 
-    // Check for walls
-    if (target_content == 'W') {
-        result = INVALID_MOVE;
-        goto unlock_pacman;
+    // Check for walls and other Pacmans
+    if (target_content == 'W' || target_content == 'P') {
+        return INVALID_MOVE;
     }
 
     // Check for ghosts
     if (target_content == 'M') {
         kill_pacman(board, pacman_index);
-        result = DEAD_PACMAN;
-        goto unlock_pacman;
+        return DEAD_PACMAN;
     }
 
     // Collect points
-    if (board->board[new_index].has_dot) {
+    board_pos_t* new_cell = board_at_mut(board, new_x, new_y);
+    if (new_cell->has_dot) {
         pac->points++;
-        board->board[new_index].has_dot = 0;
+        new_cell->has_dot = 0;
+        hash_toggle(board, dot_key(cell_key(board, new_x, new_y)));
     }
 
-    board->board[old_index].content = ' ';
+    old_cell->content = ' ';
     pac->pos_x = new_x;
     pac->pos_y = new_y;
-    board->board[new_index].content = 'P';
+    new_cell->content = 'P';
+    return VALID_MOVE;
+}
 
-unlock_pacman:
-    // LIBERTAR LOCKS PELA ORDEM INVERSA
-    if (min_y != max_y) pthread_mutex_unlock(&board->row_locks[max_y]);
-    pthread_mutex_unlock(&board->row_locks[min_y]);
+/* O mesmo sem locks, com outras threads a mexer agentes no tabuleiro: a casa de
+   chegada é tomada com compare-and-swap (com o ponto, que só um Pacman come) e só
+   depois a de partida é libertada. Um fantasma que toma a casa de partida antes
+   de a posição mudar mata o Pacman (find_and_kill_pacman); um que toma a de
+   chegada antes disso é visto ao voltar a ler a casa. O hash da flag de vivo é
+   atualizado por quem mata (kill_once) */
+static int resolve_pacman_atomic(board_t* board, int pacman_index, const intent_t* intent) {
+    pacman_t* pac = &board->pacmans[pacman_index];
+    if (!__atomic_load_n(&pac->alive, __ATOMIC_SEQ_CST)) return DEAD_PACMAN;
 
-    return result;
+    int new_x = pac->pos_x + intent->dx;
+    int new_y = pac->pos_y + intent->dy;
+    if (!is_valid_position(board, new_x, new_y)) {
+        return INVALID_MOVE;
+    }
+
+    // As paredes não mudam: uma casa que não é parede já tem o bloco e nada é alocado
+    board_pos_t seen = cell_load(board_at(board, new_x, new_y));
+    if (seen.content == 'W') return INVALID_MOVE;
+    board_pos_t* new_cell = board_at_mut(board, new_x, new_y);
+    board_pos_t* old_cell = board_at_mut(board, pac->pos_x, pac->pos_y);
+    for (;;) {
+        board_pos_t want = seen;
+        want.content = 'P';
+        if (seen.has_portal) {
+            if (!cell_cas(new_cell, &seen, want)) continue;
+            cell_release(old_cell, 'P');
+            return REACHED_PORTAL;
+        }
+        if (seen.content == 'W' || seen.content == 'P') return INVALID_MOVE;
+        if (seen.content == 'M') {
+            if (kill_once(board, pacman_index)) cell_release(old_cell, 'P');
+            return DEAD_PACMAN;
+        }
+        want.has_dot = 0;
+        if (cell_cas(new_cell, &seen, want)) break;
+    }
+
+    if (seen.has_dot) {
+        pac->points++;
+        hash_toggle(board, dot_key(cell_key(board, new_x, new_y)));
+    }
+    __atomic_store_n(&pac->pos_x, new_x, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&pac->pos_y, new_y, __ATOMIC_SEQ_CST);
+    if (cell_content(new_cell) != 'P') kill_once(board, pacman_index);
+    cell_release(old_cell, 'P');
+
+    if (__atomic_load_n(&pac->alive, __ATOMIC_SEQ_CST)) return VALID_MOVE;
+    cell_release(new_cell, 'P');
+    return DEAD_PACMAN;
 }
 
-// Helper private function for charged ghost movement in one direction
-static int move_ghost_charged_direction(board_t* board, ghost_t* ghost, char direction, int* new_x, int* new_y) {
+/* Casa onde um fantasma carregado para: antes da primeira parede ou fantasma, ou
+   a do primeiro Pacman (*hit = 1). Só lê o tabuleiro */
+static int charged_target(board_t* board, const ghost_t* ghost, char direction, int* new_x, int* new_y, int* hit) {
     int x = ghost->pos_x;
     int y = ghost->pos_y;
     *new_x = x;
     *new_y = y;
-    
+    *hit = 0;
+
     switch (direction) {
         case 'W': // Up
             if (y == 0) return INVALID_MOVE;
             *new_y = 0; // In case there is no colision
             for (int i = y - 1; i >= 0; i--) {
-                char target_content = board->board[get_board_index(board, x, i)].content;
+                char target_content = cell_content(board_at(board, x, i));
                 if (target_content == 'W' || target_content == 'M') {
                     *new_y = i + 1; // stop before colision
                     return VALID_MOVE;
                 }
                 else if (target_content == 'P') {
                     *new_y = i;
-                    return find_and_kill_pacman(board, *new_x, *new_y);
+                    *hit = 1;
+                    return VALID_MOVE;
                 }
             }
             break;
@@ -175,14 +650,15 @@ static int move_ghost_charged_direction(board_t* board, ghost_t* ghost, char dir
             if (y == board->height - 1) return INVALID_MOVE;
             *new_y = board->height - 1; // In case there is no colision
             for (int i = y + 1; i < board->height; i++) {
-                char target_content = board->board[get_board_index(board, x, i)].content;
+                char target_content = cell_content(board_at(board, x, i));
                 if (target_content == 'W' || target_content == 'M') {
                     *new_y = i - 1; // stop before colision
                     return VALID_MOVE;
                 }
                 if (target_content == 'P') {
                     *new_y = i;
-                    return find_and_kill_pacman(board, *new_x, *new_y);
+                    *hit = 1;
+                    return VALID_MOVE;
                 }
             }
             break;
@@ -191,14 +667,15 @@ static int move_ghost_charged_direction(board_t* board, ghost_t* ghost, char dir
             if (x == 0) return INVALID_MOVE;
             *new_x = 0; // In case there is no colision
             for (int j = x - 1; j >= 0; j--) {
-                char target_content = board->board[get_board_index(board, j, y)].content;
+                char target_content = cell_content(board_at(board, j, y));
                 if (target_content == 'W' || target_content == 'M') {
                     *new_x = j + 1; // stop before colision
                     return VALID_MOVE;
                 }
                 if (target_content == 'P') {
                     *new_x = j;
-                    return find_and_kill_pacman(board, *new_x, *new_y);
+                    *hit = 1;
+                    return VALID_MOVE;
                 }
             }
             break;
@@ -207,14 +684,15 @@ static int move_ghost_charged_direction(board_t* board, ghost_t* ghost, char dir
             if (x == board->width - 1) return INVALID_MOVE;
             *new_x = board->width - 1; // In case there is no colision
             for (int j = x + 1; j < board->width; j++) {
-                char target_content = board->board[get_board_index(board, j, y)].content;
+                char target_content = cell_content(board_at(board, j, y));
                 if (target_content == 'W' || target_content == 'M') {
                     *new_x = j - 1; // stop before colision
                     return VALID_MOVE;
                 }
                 if (target_content == 'P') {
                     *new_x = j;
-                    return find_and_kill_pacman(board, *new_x, *new_y);
+                    *hit = 1;
+                    return VALID_MOVE;
                 }
             }
             break;
@@ -223,130 +701,92 @@ static int move_ghost_charged_direction(board_t* board, ghost_t* ghost, char dir
             return INVALID_MOVE;
     }
     return VALID_MOVE;
-}   
+}
 
-int move_ghost_charged(board_t* board, int ghost_index, char direction) {
+// Junta o fantasma aos que saem no fim da jogada. Cada fantasma só mexe na sua
+// flag; a posição na lista é atómica porque a fase de decisão corre em paralelo
+static void mark_leaving(board_t* board, int ghost_index) {
     ghost_t* ghost = &board->ghosts[ghost_index];
-    int old_x = ghost->pos_x;
-    int old_y = ghost->pos_y;
-    int new_x = old_x;
-    int new_y = old_y;
+    if (!board->leaving || ghost->leaving) return;
+    ghost->leaving = 1;
+    board->leaving[__atomic_fetch_add(&board->n_leaving, 1, __ATOMIC_RELAXED)] = ghost_index;
+}
 
+/* Fase de decisão do fantasma: só mexe no estado do próprio agente.
+   A carga ('C') é consumida aqui e passa para a intenção; 'X' só marca a saída,
+   que board_end_tick aplica depois de todos os fantasmas jogarem. */
+static int plan_ghost_impl(board_t* board, int ghost_index, const script_op_t* op, intent_t* intent) {
+    ghost_t* ghost = &board->ghosts[ghost_index];
+    intent->move = 0;
+    intent->charged = 0;
+
+    // check passo
+    if (ghost->waiting > 0) {
+        ghost->waiting -= 1;
+        return VALID_MOVE;
+    }
+    ghost->waiting = ghost->passo;
+
+    if (op->op == OP_DESPAWN) {
+        next_op(ghost->code, ghost->n_code, &ghost->pc, &ghost->left);
+        mark_leaving(board, ghost_index);
+        return VALID_MOVE;
+    }
+
+    int runnable;
+    const script_op_t* move = run_op(op, ghost->code, ghost->n_code, &ghost->pc, &ghost->left,
+                                     &ghost->rng, &ghost->charged, &runnable);
+    if (!runnable) return INVALID_MOVE;
+    if (!move) return VALID_MOVE;
+
+    set_intent(intent, move);
+    intent->charged = ghost->charged;
     ghost->charged = 0; //uncharge
-    
-    // CORREÇÃO: Bloquear para evitar leituras sujas
-    // Para simplificar, bloqueamos a linha original e a possível nova linha "grosseiramente"
-    // ou apenas executamos sob proteção. Como o charged varre o tabuleiro,
-    // o ideal era bloquear tudo, mas vamos bloquear apenas a linha onde ele começa
-    // e confiar que a colisão de leitura é rara. 
-    // Para ser SEGURO sem bloquear tudo, teríamos de bloquear colunas, o que não temos.
-    // Assumimos risco de leitura, mas bloqueamos escrita (final).
-    
-    int result = move_ghost_charged_direction(board, ghost, direction, &new_x, &new_y);
-    if (result == INVALID_MOVE) {
+    return VALID_MOVE;
+}
+
+static int resolve_ghost_charged(board_t* board, int ghost_index, char direction) {
+    ghost_t* ghost = &board->ghosts[ghost_index];
+    int new_x, new_y, hit;
+    if (charged_target(board, ghost, direction, &new_x, &new_y, &hit) == INVALID_MOVE) {
         debug("DEFAULT CHARGED MOVE - direction = %c\n", direction);
         return INVALID_MOVE;
     }
-
-    // Locks para escrita
-    int min_y = (old_y < new_y) ? old_y : new_y;
-    int max_y = (old_y < new_y) ? new_y : old_y;
-    pthread_mutex_lock(&board->row_locks[min_y]);
-    if (min_y != max_y) pthread_mutex_lock(&board->row_locks[max_y]);
-
-    // Get board indices
-    int old_index = get_board_index(board, ghost->pos_x, ghost->pos_y);
-    int new_index = get_board_index(board, new_x, new_y);
+    int result = hit ? find_and_kill_pacman(board, new_x, new_y) : VALID_MOVE;
 
     // Update board - clear old position (restore what was there)
-    board->board[old_index].content = ' '; 
+    board_at_mut(board, ghost->pos_x, ghost->pos_y)->content = ' ';
     // Update ghost position
     ghost->pos_x = new_x;
     ghost->pos_y = new_y;
     // Update board - set new position
-    board->board[new_index].content = 'M';
-    
-    if (min_y != max_y) pthread_mutex_unlock(&board->row_locks[max_y]);
-    pthread_mutex_unlock(&board->row_locks[min_y]);
-    
+    board_at_mut(board, new_x, new_y)->content = 'M';
     return result;
 }
 
-int move_ghost(board_t* board, int ghost_index, command_t* command) {
+/* Fase de resolução do fantasma: aplica a intenção ao tabuleiro (acesso exclusivo) */
+static int resolve_ghost_impl(board_t* board, int ghost_index, const intent_t* intent) {
     ghost_t* ghost = &board->ghosts[ghost_index];
+    if (intent->charged)
+        return resolve_ghost_charged(board, ghost_index, intent->direction);
 
     int old_x = ghost->pos_x;
     int old_y = ghost->pos_y;
-    int new_x = old_x;
-    int new_y = old_y;
-    // check passo
-    if (ghost->waiting > 0) {
-        ghost->waiting -= 1;
-        return VALID_MOVE;
-    }
-    ghost->waiting = ghost->passo;
-
-    char direction = command->command;
-    
-    if (direction == 'R') {
-        char directions[] = {'W', 'S', 'A', 'D'};
-        direction = directions[rand() % 4];
-    }
-
-    // Calculate new position based on direction
-    switch (direction) {
-        case 'W': // Up
-            new_y--;
-            break;
-        case 'S': // Down
-            new_y++;
-            break;
-        case 'A': // Left
-            new_x--;
-            break;
-        case 'D': // Right
-            new_x++;
-            break;
-        case 'C': // Charge
-            ghost->current_move += 1;
-            ghost->charged = 1;
-            return VALID_MOVE;
-        case 'T': // Wait
-            if (command->turns_left == 1) {
-                ghost->current_move += 1; // move on
-                command->turns_left = command->turns;
-            }
-            else command->turns_left -= 1;
-            return VALID_MOVE;
-        default:
-            return INVALID_MOVE; // Invalid direction
-    }
-
-    // Logic for the WASD movement
-    ghost->current_move++;
-    if (ghost->charged)
-        return move_ghost_charged(board, ghost_index, direction);
+    int new_x = old_x + intent->dx;
+    int new_y = old_y + intent->dy;
 
     // Check boundaries
     if (!is_valid_position(board, new_x, new_y)) {
         return INVALID_MOVE;
     }
-    int min_y = (old_y < new_y) ? old_y : new_y;
-    int max_y = (old_y < new_y) ? new_y : old_y;
-
-    pthread_mutex_lock(&board->row_locks[min_y]);
-    if (min_y != max_y) pthread_mutex_lock(&board->row_locks[max_y]);
 
     // Check board position
     int result = VALID_MOVE;
-    int new_index = get_board_index(board, new_x, new_y);
-    int old_index = get_board_index(board, ghost->pos_x, ghost->pos_y);
-    char target_content = board->board[new_index].content;
+    char target_content = board_at(board, new_x, new_y)->content;
 
     // Check for walls and ghosts
     if (target_content == 'W' || target_content == 'M') {
-        result = INVALID_MOVE; // CORREÇÃO: Não retornar direto sem unlock
-        goto unlock_ghost;
+        return INVALID_MOVE;
     }
 
     // Check for pacman
@@ -355,29 +795,413 @@ int move_ghost(board_t* board, int ghost_index, command_t* command) {
     }
 
     // Update board - clear old position (restore what was there)
-    board->board[old_index].content = ' '; 
+    board_at_mut(board, old_x, old_y)->content = ' ';
 
     // Update ghost position
     ghost->pos_x = new_x;
     ghost->pos_y = new_y;
 
     // Update board - set new position
-    board->board[new_index].content = 'M';
+    board_at_mut(board, new_x, new_y)->content = 'M';
+    return result;
+}
+
+/* O mesmo sem locks (ver resolve_pacman_atomic): toma a casa de chegada ('P' ou
+   vazia) com compare-and-swap e só depois liberta a de partida. Uma carga volta a
+   procurar o destino se outro agente lá entrou entre a procura e a troca */
+static int resolve_ghost_atomic(board_t* board, int ghost_index, const intent_t* intent) {
+    ghost_t* ghost = &board->ghosts[ghost_index];
+    board_pos_t* old_cell = board_at_mut(board, ghost->pos_x, ghost->pos_y);
+    board_pos_t* new_cell;
+    board_pos_t seen;
+    int new_x, new_y;
+    for (;;) {
+        int hit = 0;
+        if (intent->charged) {
+            if (charged_target(board, ghost, intent->direction, &new_x, &new_y, &hit) == INVALID_MOVE) {
+                debug("DEFAULT CHARGED MOVE - direction = %c\n", intent->direction);
+                return INVALID_MOVE;
+            }
+            if (new_x == ghost->pos_x && new_y == ghost->pos_y) return VALID_MOVE;
+        }
+        else {
+            new_x = ghost->pos_x + intent->dx;
+            new_y = ghost->pos_y + intent->dy;
+            if (!is_valid_position(board, new_x, new_y)) return INVALID_MOVE;
+        }
+        seen = cell_load(board_at(board, new_x, new_y));
+        if (seen.content == 'W' || seen.content == 'M') {
+            if (!intent->charged) return INVALID_MOVE;
+            continue;
+        }
+        new_cell = board_at_mut(board, new_x, new_y); // Não é parede: nada é alocado
+        if (intent->charged && (seen.content == 'P') != hit) continue;
+        board_pos_t want = seen;
+        want.content = 'M';
+        if (cell_cas(new_cell, &seen, want)) break;
+    }
+
+    ghost->pos_x = new_x;
+    ghost->pos_y = new_y;
+    int result = seen.content == 'P' ? find_and_kill_pacman(board, new_x, new_y) : VALID_MOVE;
+    cell_release(old_cell, 'M');
+    return result;
+}
+
+// O hash do agente é atualizado à volta de cada fase
+// (a decisão nunca muda a flag de vivo, que um fantasma pode mudar ao mesmo tempo)
+int plan_pacman(board_t* board, int pacman_index, const script_op_t* op, intent_t* intent) {
+    if (pacman_index < 0 || !__atomic_load_n(&board->pacmans[pacman_index].alive, __ATOMIC_SEQ_CST)) {
+        intent->move = 0;
+        return DEAD_PACMAN;
+    }
+    uint64_t before = pacman_state_key(board, pacman_index);
+    int result = plan_pacman_impl(board, pacman_index, op, intent);
+    hash_toggle(board, before ^ pacman_state_key(board, pacman_index));
+    return result;
+}
 
-unlock_ghost:
-    if (min_y != max_y) pthread_mutex_unlock(&board->row_locks[max_y]);
-    pthread_mutex_unlock(&board->row_locks[min_y]);
+int plan_ghost(board_t* board, int ghost_index, const script_op_t* op, intent_t* intent) {
+    uint64_t before = ghost_key(board, ghost_index);
+    int result = plan_ghost_impl(board, ghost_index, op, intent);
+    hash_toggle(board, before ^ ghost_key(board, ghost_index));
+    return result;
+}
+
+// Sem locks, a flag de vivo pode mudar noutra thread: quem mata é que a conta no hash
+static int resolve_pacman_hashed(board_t* board, int pacman_index, const intent_t* intent, int atomic) {
+    if (!intent->move) return VALID_MOVE;
+    if (atomic) {
+        uint64_t before = pacman_state_key(board, pacman_index);
+        int result = resolve_pacman_atomic(board, pacman_index, intent);
+        hash_toggle(board, before ^ pacman_state_key(board, pacman_index));
+        return result;
+    }
+    uint64_t before = pacman_key(board, pacman_index);
+    int result = resolve_pacman_impl(board, pacman_index, intent);
+    hash_toggle(board, before ^ pacman_key(board, pacman_index));
+    return result;
+}
 
+static int resolve_ghost_hashed(board_t* board, int ghost_index, const intent_t* intent, int atomic) {
+    if (!intent->move) return VALID_MOVE;
+    uint64_t before = ghost_key(board, ghost_index);
+    int result = atomic ? resolve_ghost_atomic(board, ghost_index, intent)
+                        : resolve_ghost_impl(board, ghost_index, intent);
+    hash_toggle(board, before ^ ghost_key(board, ghost_index));
     return result;
 }
 
+int resolve_pacman(board_t* board, int pacman_index, const intent_t* intent) {
+    return resolve_pacman_hashed(board, pacman_index, intent, 0);
+}
+
+int resolve_ghost(board_t* board, int ghost_index, const intent_t* intent) {
+    return resolve_ghost_hashed(board, ghost_index, intent, 0);
+}
+
+// Mesmas regras de resolve_ghost_impl: as paredes não mudam durante o jogo, por isso uma
+// carga vertical nunca passa da primeira parede (e também não lê para lá dela)
+void ghost_footprint_rows(const board_t* board, int ghost_index, const intent_t* intent, int* top, int* bottom) {
+    const ghost_t* ghost = &board->ghosts[ghost_index];
+    int x = ghost->pos_x, y = ghost->pos_y;
+    *top = *bottom = y;
+    if (!intent->move || intent->dy == 0) return;
+
+    if (!intent->charged) {
+        int ny = y + intent->dy;
+        if (ny < 0 || ny >= board->height) return;
+        if (ny < y) *top = ny;
+        else *bottom = ny;
+        return;
+    }
+    int i = y + intent->dy;
+    while (i >= 0 && i < board->height && board_at(board, x, i)->content != 'W') i += intent->dy;
+    if (intent->dy < 0) *top = i + 1 < y ? i + 1 : y;
+    else *bottom = i - 1 > y ? i - 1 : y;
+}
+
+void place_ghost(board_t* board, int ghost_index, int x, int y, int pc, int left, int waiting, int charged) {
+    uint64_t before = ghost_key(board, ghost_index);
+    ghost_t* ghost = &board->ghosts[ghost_index];
+    board_at_mut(board, ghost->pos_x, ghost->pos_y)->content = ' ';
+    ghost->pos_x = x;
+    ghost->pos_y = y;
+    ghost->pc = pc;
+    ghost->left = left;
+    ghost->waiting = waiting;
+    ghost->charged = charged;
+    board_at_mut(board, x, y)->content = 'M';
+    hash_toggle(board, before ^ ghost_key(board, ghost_index));
+}
+
+void skip_pacman_command(board_t* board, int pacman_index) {
+    uint64_t before = pacman_key(board, pacman_index);
+    pacman_t* pac = &board->pacmans[pacman_index];
+    next_op(pac->code, pac->n_code, &pac->pc, &pac->left);
+    hash_toggle(board, before ^ pacman_key(board, pacman_index));
+}
+
+// Jogadas de espera a partir da próxima: o resto do passo e, numa espera, as voltas que
+// faltam antes da última (cada volta gasta uma jogada de ação mais o passo)
+static long idle_ticks(int waiting, int passo, const script_op_t* op, int left) {
+    long idle = waiting;
+    if (op && op->op == OP_WAIT && left > 1)
+        idle += (long)(left - 1) * (passo + 1);
+    return idle;
+}
+
+// n jogadas de espera de uma vez: o que plan_*_impl faria em n chamadas
+static void skip_idle(int* waiting, int passo, const script_op_t* op, int* left, long n) {
+    long wait = n < *waiting ? n : *waiting;
+    *waiting -= (int)wait;
+    n -= wait;
+    if (n == 0 || !op || op->op != OP_WAIT) return;
+
+    // Voltas completas da espera (ação + passo), e talvez uma ação a meio do passo seguinte
+    long cycle = (long)passo + 1;
+    *left -= (int)(n / cycle);
+    long rem = n % cycle;
+    if (rem > 0) {
+        *left -= 1;
+        *waiting = passo - (int)(rem - 1);
+    }
+}
+
+const script_op_t* pacman_op(const board_t* board, int pacman_index) {
+    const pacman_t* pac = &board->pacmans[pacman_index];
+    return pac->n_code > 0 ? &pac->code[pac->pc] : NULL;
+}
+
+const script_op_t* ghost_op(const board_t* board, int ghost_index) {
+    const ghost_t* ghost = &board->ghosts[ghost_index];
+    return ghost->n_code > 0 ? &ghost->code[ghost->pc] : NULL;
+}
+
+long pacman_idle_ticks(const board_t* board, int pacman_index) {
+    const pacman_t* pac = &board->pacmans[pacman_index];
+    const script_op_t* op = pacman_op(board, pacman_index);
+    if (op && (op->op == OP_SAVE || op->op == OP_QUIT)) return 0;
+    return idle_ticks(pac->waiting, pac->passo, op, pac->left);
+}
+
+long ghost_idle_ticks(const board_t* board, int ghost_index) {
+    const ghost_t* ghost = &board->ghosts[ghost_index];
+    return idle_ticks(ghost->waiting, ghost->passo, ghost_op(board, ghost_index), ghost->left);
+}
+
+void skip_pacman_ticks(board_t* board, int pacman_index, long n) {
+    if (n <= 0) return;
+    pacman_t* pac = &board->pacmans[pacman_index];
+    uint64_t before = pacman_key(board, pacman_index);
+    skip_idle(&pac->waiting, pac->passo, pacman_op(board, pacman_index), &pac->left, n);
+    hash_toggle(board, before ^ pacman_key(board, pacman_index));
+}
+
+void skip_ghost_ticks(board_t* board, int ghost_index, long n) {
+    if (n <= 0) return;
+    ghost_t* ghost = &board->ghosts[ghost_index];
+    uint64_t before = ghost_key(board, ghost_index);
+    skip_idle(&ghost->waiting, ghost->passo, ghost_op(board, ghost_index), &ghost->left, n);
+    hash_toggle(board, before ^ ghost_key(board, ghost_index));
+}
+
+// ==================================================================
+// VAGAS DOS FANTASMAS (ninhos e saídas)
+// ==================================================================
+static inline int* nest_heap(board_t* board, const nest_t* nest) {
+    return board->free_slots + (nest->first - board->spawn_base);
+}
+
+static void free_push(board_t* board, nest_t* nest, int g) {
+    int* heap = nest_heap(board, nest);
+    int i = nest->n_free++;
+    while (i > 0 && heap[(i - 1) / 2] > g) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = g;
+}
+
+static int free_pop(board_t* board, nest_t* nest) {
+    int* heap = nest_heap(board, nest);
+    int top = heap[0];
+    int last = heap[--nest->n_free];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= nest->n_free) break;
+        if (child + 1 < nest->n_free && heap[child + 1] < heap[child]) child++;
+        if (heap[child] >= last) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (nest->n_free > 0) heap[i] = last;
+    return top;
+}
+
+ghost_handle_t ghost_handle(const board_t* board, int g) {
+    const ghost_t* ghost = &board->ghosts[g];
+    if (!ghost->active) return GHOST_NONE;
+    // O bit de cima fica a 0: um handle nunca é GHOST_NONE
+    return ((ghost->gen << GHOST_SLOT_BITS) | (uint32_t)g) & 0x7FFFFFFFu;
+}
+
+int ghost_slot(const board_t* board, ghost_handle_t handle) {
+    if (handle == GHOST_NONE) return -1;
+    int g = (int)(handle & ((1u << GHOST_SLOT_BITS) - 1));
+    if (g >= board->n_ghosts || ghost_handle(board, g) != handle) return -1;
+    return g;
+}
+
+int despawn_ghost(board_t* board, ghost_handle_t handle) {
+    int g = ghost_slot(board, handle);
+    if (g < 0) return -1;
+    mark_leaving(board, g);
+    return 0;
+}
+
+// O fantasma sai: a casa fica vazia e a vaga volta ao seu ninho com o script do início
+static void remove_ghost(board_t* board, int g) {
+    ghost_t* ghost = &board->ghosts[g];
+    hash_toggle(board, ghost_key(board, g));
+    board_at_mut(board, ghost->pos_x, ghost->pos_y)->content = ' ';
+    ghost->active = 0;
+    ghost->leaving = 0;
+    ghost->gen++;
+    ghost->pc = 0;
+    ghost->left = ghost->n_code > 0 ? ghost->code[0].count : 1;
+    ghost->waiting = 0;
+    ghost->charged = 0;
+    if (ghost->nest >= 0) free_push(board, &board->nests[ghost->nest], g);
+}
+
+static int spawn_ghost(board_t* board, nest_t* nest) {
+    int alive = nest->slots - nest->n_free;
+    if (nest->n_free == 0 || alive >= nest->max) return -1;
+    if (board_at(board, nest->x, nest->y)->content != ' ') return -1;
+    board_pos_t* cell = board_at_mut(board, nest->x, nest->y);
+
+    int g = free_pop(board, nest);
+    ghost_t* ghost = &board->ghosts[g];
+    ghost->pos_x = nest->x;
+    ghost->pos_y = nest->y;
+    ghost->active = 1;
+    // O gerador depende da geração: cada fantasma que nasce na vaga tem a sua sequência
+    ghost->rng = mix_seed(board->seed ^ ghost->gen * 0x85EBCA6Bu, 2 * g + 1);
+    cell->content = 'M';
+    hash_toggle(board, ghost_key(board, g));
+    return g;
+}
+
+int board_end_tick(board_t* board, int* spawned) {
+    for (int k = 0; k < board->n_leaving; k++) remove_ghost(board, board->leaving[k]);
+    board->n_leaving = 0;
+    int n = 0;
+    for (int i = 0; i < board->n_nests; i++) {
+        int g = spawn_ghost(board, &board->nests[i]);
+        if (g < 0) continue;
+        if (spawned) spawned[n] = g;
+        n++;
+    }
+    return n;
+}
+
+void board_rebuild_slots(board_t* board) {
+    // Por ordem crescente o array já é um heap
+    for (int i = 0; i < board->n_nests; i++) {
+        nest_t* nest = &board->nests[i];
+        nest->n_free = 0;
+        for (int g = nest->first; g < nest->first + nest->slots; g++) {
+            if (!board->ghosts[g].active) nest_heap(board, nest)[nest->n_free++] = g;
+        }
+    }
+    for (int g = 0; g < board->n_ghosts; g++) board->ghosts[g].leaving = 0;
+    board->n_leaving = 0;
+}
+
+int board_has_spawning(const board_t* board) {
+    if (board->n_nests > 0) return 1;
+    for (int g = 0; g < board->n_ghosts; g++) {
+        const ghost_t* ghost = &board->ghosts[g];
+        for (int i = 0; i < ghost->n_code; i++)
+            if (ghost->code[i].op == OP_DESPAWN) return 1;
+    }
+    return 0;
+}
+
+static int move_pacman_mode(board_t* board, int pacman_index, const script_op_t* op, int atomic) {
+    intent_t intent;
+    int result = plan_pacman(board, pacman_index, op, &intent);
+    if (result != VALID_MOVE || !intent.move) return result;
+    return resolve_pacman_hashed(board, pacman_index, &intent, atomic);
+}
+
+static int move_ghost_mode(board_t* board, int ghost_index, const script_op_t* op, int atomic) {
+    intent_t intent;
+    int result = plan_ghost(board, ghost_index, op, &intent);
+    if (result != VALID_MOVE || !intent.move) return result;
+    return resolve_ghost_hashed(board, ghost_index, &intent, atomic);
+}
+
+int move_pacman(board_t* board, int pacman_index, const script_op_t* op) {
+    return move_pacman_mode(board, pacman_index, op, 0);
+}
+
+int move_ghost(board_t* board, int ghost_index, const script_op_t* op) {
+    return move_ghost_mode(board, ghost_index, op, 0);
+}
+
+int move_pacman_shared(board_t* board, int pacman_index, const script_op_t* op) {
+    return move_pacman_mode(board, pacman_index, op, 1);
+}
+
+int move_ghost_shared(board_t* board, int ghost_index, const script_op_t* op) {
+    return move_ghost_mode(board, ghost_index, op, 1);
+}
+
+int board_points(const board_t* board) {
+    int points = 0;
+    for (int p = 0; p < board->n_pacmans; p++) points += board->pacmans[p].points;
+    return points;
+}
+
+int board_players(const board_t* board) {
+    int players = 0;
+    for (int p = 0; p < board->n_pacmans; p++) players += (board->pacmans[p].player >= 0);
+    return players;
+}
+
+// Tecla de movimento -> jogador (W/A/S/D = 0, I/J/K/L = 1) e direção; -1 se não for movimento
+static int key_player(char key, char* direction) {
+    switch (key) {
+        case 'W': case 'A': case 'S': case 'D': *direction = key; return 0;
+        case 'I': *direction = 'W'; return 1;
+        case 'J': *direction = 'A'; return 1;
+        case 'K': *direction = 'S'; return 1;
+        case 'L': *direction = 'D'; return 1;
+        default: return -1;
+    }
+}
+
+// Entrega a tecla ao Pacman desse jogador (a thread de jogo consome-a na próxima jogada)
+void board_send_input(board_t* board, char key) {
+    char direction;
+    int player = key_player(key, &direction);
+    if (player < 0) return;
+    for (int p = 0; p < board->n_pacmans; p++) {
+        if (board->pacmans[p].player == player && __atomic_load_n(&board->pacmans[p].alive, __ATOMIC_SEQ_CST)) {
+            atomic_store(&board->pacmans[p].next_cmd, direction);
+            return;
+        }
+    }
+}
+
 void kill_pacman(board_t* board, int pacman_index) {
     debug("Killing %d pacman\n\n", pacman_index);
     pacman_t* pac = &board->pacmans[pacman_index];
-    int index = pac->pos_y * board->width + pac->pos_x;
-
     // Remove pacman from the board
-    board->board[index].content = ' ';
+    board_at_mut(board, pac->pos_x, pac->pos_y)->content = ' ';
 
     // Mark pacman as dead
     pac->alive = 0;
@@ -391,10 +1215,12 @@ void open_debug_file(char *filename) {
 }
 
 void close_debug_file() {
-    fclose(debugfile);
+    if (debugfile) fclose(debugfile);
+    debugfile = NULL;
 }
 
 void debug(const char * format, ...) {
+    if (!debugfile) return; // Modos sem ficheiro de debug (ex: --check)
     va_list args;
     va_start(args, format);
     vfprintf(debugfile, format, args);
@@ -403,8 +1229,20 @@ void debug(const char * format, ...) {
     fflush(debugfile);
 }
 
+// snprintf no fim do buffer que satura: um texto que não cabe fica cortado e offset
+// nunca passa de size - 1 (com muitos agentes a lista de ficheiros não cabe toda)
+static size_t append_text(char* buffer, size_t size, size_t offset, const char* format, ...) {
+    if (offset >= size - 1) return size - 1;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer + offset, size - offset, format, args);
+    va_end(args);
+    if (n < 0) return offset;
+    return offset + n < size - 1 ? offset + n : size - 1;
+}
+
 void print_board(board_t *board) {
-    if (!board || !board->board) {
+    if (!board || !board->chunks) {
         debug("[%d] Board is empty or not initialized.\n", getpid());
         return;
     }
@@ -413,36 +1251,39 @@ void print_board(board_t *board) {
     char buffer[8192];
     size_t offset = 0;
 
-    offset += snprintf(buffer + offset, sizeof(buffer) - offset,
-                       "=== [%d] LEVEL INFO ===\n"
-                       "Dimensions: %d x %d\n"
-                       "Tempo: %d\n"
-                       "Pacman file: %s\n",
-                       getpid(), board->height, board->width, board->tempo, board->pacman_file);
+    offset = append_text(buffer, sizeof(buffer), offset,
+                         "=== [%d] LEVEL INFO ===\n"
+                         "Dimensions: %d x %d\n"
+                         "Tempo: %d\n"
+                         "Pacman files (%d):\n",
+                         getpid(), board->height, board->width, board->tempo, board->n_pacmans);
 
-    offset += snprintf(buffer + offset, sizeof(buffer) - offset,
-                       "Monster files (%d):\n", board->n_ghosts);
+    for (int i = 0; i < board->n_pacmans; i++) {
+        offset = append_text(buffer, sizeof(buffer), offset,
+                             "  - %s\n", board->pacman_files[i]);
+    }
+
+    offset = append_text(buffer, sizeof(buffer), offset,
+                         "Monster files (%d):\n", board->n_ghosts);
 
     for (int i = 0; i < board->n_ghosts; i++) {
-        offset += snprintf(buffer + offset, sizeof(buffer) - offset,
-                           "  - %s\n", board->ghosts_files[i]);
+        offset = append_text(buffer, sizeof(buffer), offset,
+                             "  - %s\n", board->ghosts_files[i]);
     }
 
-    offset += snprintf(buffer + offset, sizeof(buffer) - offset, "\n=== BOARD ===\n");
+    offset = append_text(buffer, sizeof(buffer), offset, "\n=== BOARD ===\n");
 
-    for (int y = 0; y < board->height; y++) {
-        for (int x = 0; x < board->width; x++) {
-            int idx = y * board->width + x;
-            if (offset < sizeof(buffer) - 2) {
-                buffer[offset++] = board->board[idx].content;
-            }
+    // Tabuleiros grandes só mostram o início (o buffer é fixo)
+    for (int y = 0; y < board->height && offset < sizeof(buffer) - 2; y++) {
+        for (int x = 0; x < board->width && offset < sizeof(buffer) - 2; x++) {
+            buffer[offset++] = board_at(board, x, y)->content;
         }
         if (offset < sizeof(buffer) - 2) {
             buffer[offset++] = '\n';
         }
     }
 
-    offset += snprintf(buffer + offset, sizeof(buffer) - offset, "==================\n");
+    offset = append_text(buffer, sizeof(buffer), offset, "==================\n");
 
     buffer[offset] = '\0';
 
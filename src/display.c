@@ -1,10 +1,36 @@
 #include "display.h"
 #include "board.h"
 #include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
 #include <ctype.h>
 
+static int backend = -1; // -1 = ainda não escolhido (ver terminal_init)
+
+void display_set_backend(int b) {
+    backend = b;
+}
+
+// Uma casa do ecrã com cor e estilo, em qualquer backend
+static void put_cell(int row, int col, char c, int colour_i, int style) {
+    if (backend == DISPLAY_ANSI) {
+        ansi_put(row, col, c, colour_i, style);
+        return;
+    }
+    attr_t attrs = COLOR_PAIR(colour_i) | ((style & ANSI_BOLD) ? A_BOLD : 0) | ((style & ANSI_DIM) ? A_DIM : 0);
+    move(row, col);
+    attron(attrs);
+    addch(c);
+    attroff(attrs);
+}
 
 int terminal_init() {
+    if (backend < 0) {
+        const char* env = getenv("PACMANIST_DISPLAY");
+        backend = (env && strcmp(env, "ansi") == 0) ? DISPLAY_ANSI : DISPLAY_NCURSES;
+    }
+    if (backend == DISPLAY_ANSI) return ansi_terminal_init();
+
     // Initialize ncurses mode
     initscr();
 
@@ -44,24 +70,168 @@ int terminal_init() {
 }
 
 
+void clear_screen() {
+    if (backend == DISPLAY_ANSI) ansi_clear();
+    else clear();
+}
+
+void draw_text(int row, int colour_i, const char* format, ...) {
+    char text[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    if (backend == DISPLAY_ANSI) {
+        ansi_text(row, colour_i, text);
+        return;
+    }
+    attron(COLOR_PAIR(colour_i));
+    mvaddstr(row, 0, text);
+    clrtoeol();
+    attroff(COLOR_PAIR(colour_i));
+}
+
+// Tamanho do ecrã em casas
+static void screen_dims(int* rows, int* cols) {
+    if (backend == DISPLAY_ANSI) ansi_size(rows, cols);
+    else getmaxyx(stdscr, *rows, *cols);
+}
+
+// Câmara: canto superior esquerdo da parte visível do tabuleiro
+static int cam_x = 0, cam_y = 0;
+static int minimap_on = 0;
+
+void toggle_minimap() {
+    minimap_on = !minimap_on;
+}
+
+// Pacman que a câmara segue: o primeiro jogador vivo, senão o primeiro Pacman vivo
+static const pacman_t* followed_pacman(const board_t* board) {
+    const pacman_t* first_alive = NULL;
+    for (int p = 0; p < board->n_pacmans; p++) {
+        const pacman_t* pac = &board->pacmans[p];
+        if (!pac->alive) continue;
+        if (pac->player >= 0) return pac;
+        if (!first_alive) first_alive = pac;
+    }
+    if (first_alive) return first_alive;
+    return board->n_pacmans > 0 ? &board->pacmans[0] : NULL;
+}
+
+// Move a câmara só quando o Pacman sai da zona central (um quarto da janela de cada lado)
+static int follow_axis(int cam, int pos, int view, int size) {
+    if (size <= view) return 0;
+    int margin = view / 4;
+    if (pos < cam + margin) cam = pos - margin;
+    if (pos >= cam + view - margin) cam = pos - view + margin + 1;
+    if (cam < 0) cam = 0;
+    if (cam > size - view) cam = size - view;
+    return cam;
+}
+
+static void draw_cell(board_t* board, int x, int y, int row, int col) {
+    const board_pos_t* cell = board_at(board, x, y);
+    switch (cell->content) {
+        case 'W': // Wall
+            put_cell(row, col, '#', 3, 0);
+            break;
+
+        case 'P': // Pacman
+            put_cell(row, col, 'C', 1, ANSI_BOLD);
+            break;
+
+        case 'M': { // Monster/Ghost
+            int ghost_charged = 0;
+            for (int g = 0; g < board->n_ghosts; g++) {
+                ghost_t* ghost = &board->ghosts[g];
+                if (ghost->active && ghost->pos_x == x && ghost->pos_y == y) {
+                    ghost_charged = ghost->charged;
+                    break;
+                }
+            }
+            put_cell(row, col, 'M', 2, ANSI_BOLD | (ghost_charged ? ANSI_DIM : 0));
+            break;
+        }
+
+        case ' ': // Empty space
+            if (cell->has_portal)
+                put_cell(row, col, '@', 6, 0);
+            else if (cell->has_dot)
+                put_cell(row, col, '.', 4, 0);
+            else
+                put_cell(row, col, ' ', 0, 0);
+            break;
+
+        default:
+            put_cell(row, col, cell->content, 0, 0);
+            break;
+    }
+}
+
+// Mapa reduzido no canto superior direito: uma casa por bloco de scale x scale do
+// tabuleiro (amostrada, não percorre o bloco) e os agentes por cima
+static void draw_minimap(board_t* board, int top, int screen_cols, int view_w, int view_h) {
+    int mm_w = screen_cols / 4, mm_h = view_h - 2;
+    if (mm_w < 8 || mm_h < 4) return;
+    int scale = (board->width + mm_w - 1) / mm_w;
+    int scale_y = (board->height + mm_h - 1) / mm_h;
+    if (scale_y > scale) scale = scale_y;
+    mm_w = (board->width + scale - 1) / scale;
+    mm_h = (board->height + scale - 1) / scale;
+    int left = screen_cols - mm_w - 2;
+
+    for (int y = 0; y < mm_h; y++) {
+        for (int x = 0; x < mm_w; x++) {
+            int bx = x * scale + scale / 2, by = y * scale + scale / 2;
+            if (bx >= board->width) bx = board->width - 1;
+            if (by >= board->height) by = board->height - 1;
+            const board_pos_t* cell = board_at(board, bx, by);
+            // A parte que está no ecrã fica destacada
+            int in_view = x * scale + scale > cam_x && x * scale < cam_x + view_w &&
+                          y * scale + scale > cam_y && y * scale < cam_y + view_h;
+            if (cell->content == 'W') put_cell(top + 1 + y, left + 1 + x, '#', 3, in_view ? ANSI_BOLD : ANSI_DIM);
+            else put_cell(top + 1 + y, left + 1 + x, cell->has_dot ? '.' : ' ', 4, in_view ? ANSI_BOLD : ANSI_DIM);
+        }
+    }
+    for (int g = 0; g < board->n_ghosts; g++) {
+        if (!board->ghosts[g].active) continue;
+        put_cell(top + 1 + board->ghosts[g].pos_y / scale, left + 1 + board->ghosts[g].pos_x / scale, 'M', 2, ANSI_BOLD);
+    }
+    for (int p = 0; p < board->n_pacmans; p++) {
+        if (!board->pacmans[p].alive) continue;
+        put_cell(top + 1 + board->pacmans[p].pos_y / scale, left + 1 + board->pacmans[p].pos_x / scale, 'C', 1, ANSI_BOLD);
+    }
+
+    // Moldura
+    for (int x = 0; x < mm_w + 2; x++) {
+        put_cell(top, left + x, '-', 5, 0);
+        put_cell(top + mm_h + 1, left + x, '-', 5, 0);
+    }
+    for (int y = 1; y <= mm_h; y++) {
+        put_cell(top + y, left, '|', 5, 0);
+        put_cell(top + y, left + mm_w + 1, '|', 5, 0);
+    }
+}
+
 void draw_board(board_t* board, int mode) {
     // Clear the screen before redrawing
-    clear();
+    clear_screen();
 
     // Draw the border/title
-    attron(COLOR_PAIR(5));
-    mvprintw(0, 0, "=== PACMAN GAME ===");
+    draw_text(0, 5, "=== PACMAN GAME ===");
     switch(mode) {
     case DRAW_GAME_OVER:
-        mvprintw(1, 0, " GAME OVER ");
+        draw_text(1, 5, " GAME OVER ");
         break;
 
     case DRAW_WIN:
-        mvprintw(1, 0, " VICTORY ");
+        draw_text(1, 5, " VICTORY ");
         break;
 
     case DRAW_MENU:
-        mvprintw(1, 0, "Level: %s | Use W/A/S/D to move | Q to quit | G to quicksave ", board->level_name);
+        draw_text(1, 5, "Level: %s | Use W/A/S/D to move%s | Q to quit | G to quicksave ", board->level_name,
+                  (board_players(board) > 1) ? " (P2: I/J/K/L)" : "");
         break;
     }
 
@@ -69,90 +239,64 @@ void draw_board(board_t* board, int mode) {
     // Starting row for the game board (leave space for UI)
     int start_row = 3;
 
-    // Draw the board
-    for (int y = 0; y < board->height; y++) {
-        for (int x = 0; x < board->width; x++) {
-            int index = y * board->width + x;
-            char ch = board->board[index].content;
-            int ghost_charged = 0;
-
-            for (int g = 0; g < board->n_ghosts; g++) {
-                ghost_t* ghost = &board->ghosts[g];
-                if (ghost->pos_x == x && ghost->pos_y == y) {
-                    if (ghost->charged)
-                        ghost_charged = 1;
-                    break;
-                }
-            }
-
-            // Move cursor to position
-            move(start_row + y, x);
-
-            // Draw with appropriate color
-            switch (ch) {
-                case 'W': // Wall
-                    attron(COLOR_PAIR(3));
-                    addch('#');
-                    attroff(COLOR_PAIR(3));
-                    break;
-
-                case 'P': // Pacman
-                    attron(COLOR_PAIR(1) | A_BOLD);
-                    addch('C');
-                    attroff(COLOR_PAIR(1) | A_BOLD);
-                    break;
-
-                case 'M': // Monster/Ghost
-                    attron((COLOR_PAIR(2) | A_BOLD) | ((ghost_charged) ? (A_DIM) : (0)));
-                    addch('M');
-                    attroff((COLOR_PAIR(2) | A_BOLD) | ((ghost_charged) ? (A_DIM) : (0)));
-                    break;
-
-                case ' ': // Empty space
-                    if (board->board[index].has_portal) {
-                        attron(COLOR_PAIR(6));
-                        addch('@');
-                        attroff(COLOR_PAIR(6));
-                    }
-                    else if (board->board[index].has_dot) {
-                        attron(COLOR_PAIR(4));
-                        addch('.');
-                        attroff(COLOR_PAIR(4));
-                    }
-                    else
-                        addch(' ');
-                    break;
+    // Só se desenha a parte do tabuleiro que cabe no ecrã (menos a linha dos pontos)
+    int screen_rows, screen_cols;
+    screen_dims(&screen_rows, &screen_cols);
+    int view_w = board->width < screen_cols ? board->width : screen_cols;
+    int view_h = screen_rows - start_row - 2;
+    if (view_h > board->height) view_h = board->height;
+    if (view_h < 1) view_h = 1;
+
+    const pacman_t* pac = followed_pacman(board);
+    if (pac) {
+        cam_x = follow_axis(cam_x, pac->pos_x, view_w, board->width);
+        cam_y = follow_axis(cam_y, pac->pos_y, view_h, board->height);
+    }
+    else {
+        cam_x = cam_y = 0;
+    }
 
-                default:
-                    addch(ch);
-                    break;
-            }
+    // Draw the board
+    for (int y = 0; y < view_h; y++) {
+        for (int x = 0; x < view_w; x++) {
+            draw_cell(board, cam_x + x, cam_y + y, start_row + y, x);
         }
     }
 
+    int scrolled = view_w < board->width || view_h < board->height;
+    if (minimap_on && scrolled) draw_minimap(board, start_row, screen_cols, view_w, view_h);
+
     // Draw score/status at the bottom
-    attron(COLOR_PAIR(5));
-    mvprintw(start_row + board->height + 1, 0, "Points: %d",
-             board->pacmans[0].points); // Assuming first pacman for now
-    attroff(COLOR_PAIR(5));
+    char status[512];
+    int len = snprintf(status, sizeof(status), "Points: %d", board_points(board));
+    if (board->n_pacmans > 1) {
+        // Pontos de cada Pacman (x = morto)
+        for (int p = 0; p < board->n_pacmans && len < (int)sizeof(status); p++) {
+            len += snprintf(status + len, sizeof(status) - len, " | P%d: %d%s", p + 1,
+                            board->pacmans[p].points, board->pacmans[p].alive ? "" : "x");
+        }
+    }
+    if (scrolled && len < (int)sizeof(status)) {
+        snprintf(status + len, sizeof(status) - len, " | View %d,%d of %dx%d | N: minimap",
+                 cam_x, cam_y, board->width, board->height);
+    }
+    draw_text(start_row + view_h + 1, 5, "%s", status);
 }
 
 void draw(char c, int colour_i, int pos_x, int pos_y) {
-    move(pos_y, pos_x);
-    attron(COLOR_PAIR(colour_i) | A_BOLD);
-    addch(c);
-    attroff(COLOR_PAIR(colour_i) | A_BOLD);
+    put_cell(pos_y, pos_x, c, colour_i, ANSI_BOLD);
 }
 
 void refresh_screen() {
     // Update the physical screen with the virtual screen
-    refresh();
+    if (backend == DISPLAY_ANSI) ansi_refresh();
+    else refresh();
 }
 
 
 char get_input() {
     // Get a character from the keyboard
-    int ch = getch();
+    int ch = (backend == DISPLAY_ANSI) ? ansi_getch() : getch();
 
     // getch() returns ERR if no input is available
     if (ch == ERR) {
@@ -166,8 +310,14 @@ char get_input() {
         case 'S':
         case 'A':
         case 'D':
+        case 'I': // Segundo jogador
+        case 'J':
+        case 'K':
+        case 'L':
         case 'Q':
         case 'G':
+        case 'N': // Mapa reduzido
+        case 'B': // Voltar atrás (jornal das jogadas)
             return (char)ch;
         
         default:
@@ -177,5 +327,6 @@ char get_input() {
 
 void terminal_cleanup() {
     // Restore terminal settings and clean up ncurses
-    endwin();
+    if (backend == DISPLAY_ANSI) ansi_terminal_cleanup();
+    else endwin();
 }
\ No newline at end of file
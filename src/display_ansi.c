@@ -0,0 +1,336 @@
+#include "display.h"
+#include "board.h"
+#include "files.h"
+#include "sim.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+// Pior caso de uma casa no buffer: "\x1b[0;1;2;33;40m" + o carácter
+#define ANSI_CELL_MAX 16
+#define ANSI_ROW_EXTRA 16 // "\x1b[0m\x1b[K\r\n"
+
+typedef struct {
+    char ch;
+    unsigned char colour; // Par de cores 0..7 (0 = cor do terminal)
+    unsigned char style;  // ANSI_BOLD | ANSI_DIM
+} ansi_cell_t;
+
+typedef struct {
+    int rows, cols;
+    ansi_cell_t* cells;
+    char* out;          // Buffer do frame, pré-alocado para o pior caso
+    size_t out_cap;
+    int tty;            // stdin é um terminal (termios alterado)
+    struct termios saved;
+} ansi_screen_t;
+
+static ansi_screen_t screen;
+
+// Cor de frente de cada par (ver terminal_init do ncurses); o fundo é sempre preto
+static const char* const fg_codes[8] = { "", "33", "31", "34", "37", "32", "35", "36" };
+
+static const ansi_cell_t blank = { ' ', 0, 0 };
+
+static void screen_size(int* rows, int* cols) {
+    struct winsize ws;
+    *rows = 24;
+    *cols = 80;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+        *rows = ws.ws_row;
+        *cols = ws.ws_col;
+        return;
+    }
+    // Sem terminal (ex.: --render-bench): como o ncurses, usar LINES/COLUMNS
+    const char* l = getenv("LINES");
+    const char* c = getenv("COLUMNS");
+    if (l && atoi(l) > 0) *rows = atoi(l);
+    if (c && atoi(c) > 0) *cols = atoi(c);
+}
+
+static void write_all(const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+int ansi_terminal_init() {
+    screen_size(&screen.rows, &screen.cols);
+    screen.cells = malloc((size_t)screen.rows * screen.cols * sizeof(ansi_cell_t));
+    screen.out_cap = (size_t)screen.rows * (screen.cols * ANSI_CELL_MAX + ANSI_ROW_EXTRA) + 64;
+    screen.out = malloc(screen.out_cap);
+    if (!screen.cells || !screen.out) {
+        free(screen.cells);
+        free(screen.out);
+        return -1;
+    }
+    ansi_clear();
+
+    // Teclas sem buffer de linha nem eco; read() não bloqueia (VMIN = VTIME = 0)
+    screen.tty = tcgetattr(STDIN_FILENO, &screen.saved) == 0;
+    if (screen.tty) {
+        struct termios raw = screen.saved;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    }
+
+    // Ecrã alternativo, cursor escondido, ecrã limpo
+    const char enter[] = "\x1b[?1049h\x1b[?25l\x1b[0m\x1b[2J";
+    write_all(enter, sizeof(enter) - 1);
+    return 0;
+}
+
+void ansi_size(int* rows, int* cols) {
+    *rows = screen.rows;
+    *cols = screen.cols;
+}
+
+void ansi_clear() {
+    for (int i = 0; i < screen.rows * screen.cols; i++) screen.cells[i] = blank;
+}
+
+void ansi_put(int row, int col, char c, int colour_i, int style) {
+    // Como o ncurses, o que sai do ecrã é cortado
+    if (row < 0 || row >= screen.rows || col < 0 || col >= screen.cols) return;
+    ansi_cell_t* cell = &screen.cells[row * screen.cols + col];
+    cell->ch = c;
+    cell->colour = (unsigned char)(colour_i & 7);
+    cell->style = (unsigned char)style;
+}
+
+void ansi_text(int row, int colour_i, const char* text) {
+    if (row < 0 || row >= screen.rows) return;
+    int col = 0;
+    for (; text[col] && col < screen.cols; col++) ansi_put(row, col, text[col], colour_i, 0);
+    for (; col < screen.cols; col++) screen.cells[row * screen.cols + col] = blank;
+}
+
+static int same_attr(const ansi_cell_t* a, const ansi_cell_t* b) {
+    return a->colour == b->colour && a->style == b->style;
+}
+
+// Escape mínima para passar da cor 'from' para 'to': só um reset se for preciso tirar um estilo
+static size_t put_sgr(char* p, const ansi_cell_t* from, int from_valid, const ansi_cell_t* to) {
+    char* start = p;
+    int reset = !from_valid || (from->style & ~to->style) != 0;
+    int style = reset ? to->style : (to->style & ~from->style);
+    int colour_from = reset ? 0 : from->colour;
+
+    memcpy(p, "\x1b[", 2);
+    p += 2;
+    if (reset) *p++ = '0';
+    if (style & ANSI_BOLD) { memcpy(p, ";1", 2); p += 2; }
+    if (style & ANSI_DIM) { memcpy(p, ";2", 2); p += 2; }
+    if (to->colour != colour_from) {
+        if (to->colour) {
+            *p++ = ';';
+            memcpy(p, fg_codes[to->colour], 2);
+            p += 2;
+            if (!colour_from) { memcpy(p, ";40", 3); p += 3; }
+        }
+        else {
+            memcpy(p, ";39;49", 6);
+            p += 6;
+        }
+    }
+    *p++ = 'm';
+    // Sem reset, "\x1b[;33m" fica "\x1b[33m"
+    if (!reset) {
+        memmove(start + 2, start + 3, (p - start) - 3);
+        p--;
+    }
+    return p - start;
+}
+
+// Compõe o frame inteiro e escreve-o de uma vez; devolve os bytes escritos
+size_t ansi_refresh() {
+    char* p = screen.out;
+    memcpy(p, "\x1b[H", 3);
+    p += 3;
+
+    ansi_cell_t cur = blank;
+    int cur_valid = 0; // Depois do "\x1b[H" não se sabe a cor ativa
+
+    for (int y = 0; y < screen.rows; y++) {
+        const ansi_cell_t* row = &screen.cells[y * screen.cols];
+
+        // As casas vazias no fim da linha saem com um só "apagar até ao fim"
+        int last = screen.cols - 1;
+        while (last >= 0 && row[last].ch == ' ' && same_attr(&row[last], &blank)) last--;
+
+        for (int x = 0; x <= last; x++) {
+            // Uma escape só quando a cor ou o estilo mudam
+            if (!cur_valid || !same_attr(&row[x], &cur)) {
+                p += put_sgr(p, &cur, cur_valid, &row[x]);
+                cur = row[x];
+                cur_valid = 1;
+            }
+            *p++ = row[x].ch;
+        }
+
+        if (!cur_valid || !same_attr(&cur, &blank)) {
+            memcpy(p, "\x1b[0m", 4);
+            p += 4;
+            cur = blank;
+            cur_valid = 1;
+        }
+        memcpy(p, "\x1b[K", 3);
+        p += 3;
+        if (y + 1 < screen.rows) {
+            memcpy(p, "\r\n", 2);
+            p += 2;
+        }
+    }
+
+    size_t len = p - screen.out;
+    write_all(screen.out, len);
+    return len;
+}
+
+// Um byte por read(): o que não foi lido fica no kernel e o poll() da UI continua a vê-lo
+int ansi_getch() {
+    unsigned char c;
+    while (read(STDIN_FILENO, &c, 1) == 1) {
+        if (c != 0x1b) return c;
+
+        // Sequência de escape (setas, teclas de função): descartar até ao byte final
+        if (read(STDIN_FILENO, &c, 1) != 1) return ERR;
+        if (c != '[' && c != 'O') continue;
+        while (read(STDIN_FILENO, &c, 1) == 1 && (c < 0x40 || c > 0x7e)) {
+        }
+    }
+    return ERR;
+}
+
+void ansi_terminal_cleanup() {
+    const char leave[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+    write_all(leave, sizeof(leave) - 1);
+    if (screen.tty) tcsetattr(STDIN_FILENO, TCSANOW, &screen.saved);
+    free(screen.cells);
+    free(screen.out);
+    memset(&screen, 0, sizeof(screen));
+}
+
+// ==================================================================
+// COMPARAÇÃO COM O NCURSES (--render-bench)
+// ==================================================================
+typedef struct {
+    double secs[2];
+    long bytes[2];
+    int width, height;
+} bench_level_t;
+
+static double elapsed(const struct timespec* t0, const struct timespec* t1) {
+    return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+// Desenha 'frames' frames de um nível, com uma jogada headless entre eles; só o desenho conta no tempo
+static double bench_frames(const char* dir, const char* level, int frames) {
+    board_t board;
+    if (load_level(&board, dir, level, 0) != 0) return -1;
+    board_seed(&board, 1); // A mesma sequência de jogadas nos dois backends
+
+    double secs = 0;
+    for (int f = 0; f < frames; f++) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        draw_board(&board, DRAW_MENU);
+        refresh_screen();
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        secs += elapsed(&t0, &t1);
+
+        if (sim_step(&board) != SIM_RUNNING) {
+            unload_level(&board);
+            if (load_level(&board, dir, level, 0) != 0) return -1;
+            board_seed(&board, 1);
+        }
+    }
+    unload_level(&board);
+    return secs;
+}
+
+int render_bench_main(int argc, char** argv) {
+    if (argc < 2) { printf("Usage: %s <dir> [frames]\n", argv[0]); return 1; }
+    const char* dir = argv[1];
+    int frames = (argc >= 3) ? atoi(argv[2]) : 500;
+    if (frames <= 0) frames = 500;
+
+    struct dirent** namelist;
+    int n = scandir(dir, &namelist, filter_levels, alphasort);
+    if (n < 0) { perror("scandir"); return 1; }
+
+    // O "ecrã" tem de caber o maior tabuleiro, senão os dois backends cortam-no
+    bench_level_t* results = calloc(n ? n : 1, sizeof(bench_level_t));
+    int rows = 24, cols = 80;
+    for (int i = 0; i < n; i++) {
+        board_t board;
+        results[i].width = -1;
+        if (parse_level(&board, dir, namelist[i]->d_name, 0) != 0) continue;
+        results[i].width = board.width;
+        results[i].height = board.height;
+        if (board.height + 6 > rows) rows = board.height + 6;
+        if (board.width + 1 > cols) cols = board.width + 1;
+        unload_level(&board);
+    }
+    char num[16];
+    snprintf(num, sizeof(num), "%d", rows);
+    setenv("LINES", num, 1);
+    snprintf(num, sizeof(num), "%d", cols);
+    setenv("COLUMNS", num, 1);
+
+    // Os frames vão para um ficheiro temporário: o tamanho dele são os bytes enviados
+    FILE* sink = tmpfile();
+    int saved_stdout = dup(STDOUT_FILENO);
+    if (!sink || saved_stdout < 0) { perror("tmpfile"); return 1; }
+    fflush(stdout);
+
+    for (int b = 0; b < 2; b++) {
+        dup2(fileno(sink), STDOUT_FILENO);
+        display_set_backend(b == 0 ? DISPLAY_NCURSES : DISPLAY_ANSI);
+        terminal_init();
+        for (int i = 0; i < n; i++) {
+            if (results[i].width < 0) continue;
+            off_t before = lseek(STDOUT_FILENO, 0, SEEK_END);
+            results[i].secs[b] = bench_frames(dir, namelist[i]->d_name, frames);
+            results[i].bytes[b] = lseek(STDOUT_FILENO, 0, SEEK_END) - before;
+        }
+        terminal_cleanup();
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+    }
+    close(saved_stdout);
+    fclose(sink);
+
+    printf("%-20s %9s %12s %12s %12s %12s\n", "level", "size", "ncurses us", "ansi us", "ncurses B", "ansi B");
+    for (int i = 0; i < n; i++) {
+        if (results[i].width < 0 || results[i].secs[0] < 0 || results[i].secs[1] < 0) {
+            printf("%-20s erro ao carregar\n", namelist[i]->d_name);
+        }
+        else {
+            char size[24];
+            snprintf(size, sizeof(size), "%dx%d", results[i].width, results[i].height);
+            printf("%-20s %9s %12.1f %12.1f %12ld %12ld\n", namelist[i]->d_name, size,
+                   results[i].secs[0] * 1e6 / frames, results[i].secs[1] * 1e6 / frames,
+                   results[i].bytes[0] / frames, results[i].bytes[1] / frames);
+        }
+        free(namelist[i]);
+    }
+    printf("(por frame, média de %d frames)\n", frames);
+    free(namelist);
+    free(results);
+    return 0;
+}
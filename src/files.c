@@ -1,4 +1,6 @@
 #include "files.h"
+#include "analyzer.h"
+#include "traj.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -48,6 +50,52 @@ static char* read_file_to_buffer(const char* filepath) {
     return buffer;
 }
 
+/* De onde vêm os ficheiros de um nível: uma diretoria ou um pacote em memória
+   (bundle != NULL, ex.: um nível recebido por stream) */
+typedef struct {
+    const char* dir_path;
+    const level_bundle_t* bundle;
+} level_source_t;
+
+static const bundle_file_t* bundle_find(const level_bundle_t* bundle, const char* name) {
+    for (int i = 0; i < bundle->n_files; i++)
+        if (strcmp(bundle->files[i].name, name) == 0) return &bundle->files[i];
+    return NULL;
+}
+
+// O ficheiro inteiro num buffer terminado em '\0' (a libertar com free)
+static char* read_source(const level_source_t* src, const char* name) {
+    if (!src->bundle) {
+        char filepath[512];
+        snprintf(filepath, sizeof(filepath), "%s/%s", src->dir_path, name);
+        return read_file_to_buffer(filepath);
+    }
+    const bundle_file_t* f = bundle_find(src->bundle, name);
+    if (!f) {
+        debug("[LOAD] %s: ficheiro em falta no pacote\n", name);
+        return NULL;
+    }
+    char* buffer = malloc(f->len + 1);
+    if (!buffer) return NULL;
+    if (f->len) memcpy(buffer, f->data, f->len);
+    buffer[f->len] = '\0';
+    return buffer;
+}
+
+// O ficheiro para ler linha a linha; no pacote lê-se o buffer sem o copiar
+static FILE* open_source(const level_source_t* src, const char* name) {
+    if (!src->bundle) {
+        char filepath[512];
+        snprintf(filepath, sizeof(filepath), "%s/%s", src->dir_path, name);
+        FILE* file = fopen(filepath, "r");
+        if (!file) perror("Erro ao abrir ficheiro");
+        return file;
+    }
+    const bundle_file_t* f = bundle_find(src->bundle, name);
+    if (!f || f->len == 0) return NULL;
+    return fmemopen(f->data, f->len, "r");
+}
+
 static char* next_line(char* current) {
     char* eol = strchr(current, '\n');
     if (!eol) return NULL;
@@ -55,8 +103,8 @@ static char* next_line(char* current) {
 }
 
 // Parser de Agentes (movido do board.c)
-static int parse_agent_file(const char* filepath, int* start_x, int* start_y, int* passo, command_t* moves, int* n_moves) {
-    char* buffer = read_file_to_buffer(filepath);
+static int parse_agent_file(const level_source_t* src, const char* file, int* start_x, int* start_y, int* passo, command_t* moves, int* n_moves) {
+    char* buffer = read_source(src, file);
     if (!buffer) return -1;
 
     char* line = buffer;
@@ -91,7 +139,6 @@ static int parse_agent_file(const char* filepath, int* start_x, int* start_y, in
                 if (*n_moves < MAX_MOVES) {
                     moves[*n_moves].command = cmd_char;
                     moves[*n_moves].turns = turns;
-                    moves[*n_moves].turns_left = turns;
                     (*n_moves)++;
                 }
             }
@@ -102,48 +149,134 @@ static int parse_agent_file(const char* filepath, int* start_x, int* start_y, in
     return 0;
 }
 
+/* Compila o script lido. Um script inválido fica sem código (o agente não age)
+   e o analyzer, que o volta a compilar para dar o erro, rejeita o nível */
+static int compile_agent_script(const char* file, const command_t* moves, int n_moves, int is_ghost,
+                                script_op_t* code, int* left) {
+    char err[128];
+    int n_code = script_compile(moves, n_moves, is_ghost, code, err, sizeof(err));
+    if (n_code < 0) {
+        debug("[LOAD] %s: %s\n", file, err);
+        n_code = 0;
+    }
+    *left = n_code > 0 ? code[0].count : 1;
+    return n_code;
+}
+
+/* Reserva as vagas dos ninhos depois dos fantasmas do MON: o script de cada ninho
+   é lido uma vez e copiado para as suas vagas, que começam livres na casa do ninho.
+   Durante o jogo um fantasma nasce sem alocar nada (board_end_tick) */
+static int add_nest_slots(board_t* board, const level_source_t* src) {
+    board->spawn_base = board->n_ghosts;
+    int total = board->n_ghosts;
+    for (int i = 0; i < board->n_nests; i++) {
+        nest_t* nest = &board->nests[i];
+        if (nest->slots < 0) nest->slots = 0;
+        if (nest->slots > MAX_GHOSTS - total) nest->slots = MAX_GHOSTS - total;
+        nest->max = nest->slots;
+        nest->first = total;
+        total += nest->slots;
+    }
+    int spare = total - board->spawn_base;
+    board->ghosts = calloc(total ? total : 1, sizeof(ghost_t));
+    board->leaving = malloc(sizeof(int) * (total ? total : 1));
+    board->free_slots = malloc(sizeof(int) * (spare ? spare : 1));
+    if (!board->ghosts || !board->leaving || !board->free_slots) return -1;
+    if (spare > 0) {
+        char (*files)[256] = realloc(board->ghosts_files, sizeof(*files) * total);
+        if (!files) return -1;
+        board->ghosts_files = files;
+    }
+
+    for (int i = 0; i < board->n_nests; i++) {
+        nest_t* nest = &board->nests[i];
+        if (nest->slots == 0) continue;
+        ghost_t* g = &board->ghosts[nest->first];
+        int pos_x = -1, pos_y = -1; // A POS do ficheiro não conta: nascem no ninho
+        parse_agent_file(src, nest->file, &pos_x, &pos_y, &g->passo, g->moves, &g->n_moves);
+        g->n_code = compile_agent_script(nest->file, g->moves, g->n_moves, 1, g->code, &g->left);
+        g->pos_x = g->start_x = nest->x;
+        g->pos_y = g->start_y = nest->y;
+        g->nest = i;
+        for (int s = nest->first; s < nest->first + nest->slots; s++) {
+            if (s > nest->first) board->ghosts[s] = *g;
+            strcpy(board->ghosts_files[s], nest->file);
+        }
+    }
+    board->n_ghosts = total;
+    board_rebuild_slots(board);
+    return 0;
+}
+
 // A função Principal de carregamento (movida do board.c)
-int load_level(board_t* board, const char* dir_path, const char* level_file, int accumulated_points) {
-    char filepath[512];
-    snprintf(filepath, sizeof(filepath), "%s/%s", dir_path, level_file);
-    
-    char* buffer = read_file_to_buffer(filepath);
-    if (!buffer) return -1;
+static int parse_level_src(board_t* board, const level_source_t* src, const char* level_file, int accumulated_points) {
+    // O nível é lido linha a linha (um mapa enorme nunca está todo em memória)
+    FILE* file = open_source(src, level_file);
+    if (!file) return -1;
 
     board->n_pacmans = 0;
     board->n_ghosts = 0;
-    board->pacman_file[0] = '\0';
+    board->chunks = NULL;
+    board->ghosts_files = NULL;
+    board->trajs = NULL;
+    board->nests = NULL;
+    board->n_nests = 0;
+    board->free_slots = NULL;
+    board->leaving = NULL;
+    board->n_leaving = 0;
+    board->map_rows = 0;
+    board->map_bad_rows = 0;
     snprintf(board->level_name, sizeof(board->level_name), "%s", level_file);
 
-    char* line = buffer;
+    char* line = NULL;
+    size_t line_cap = 0;
     int reading_map = 0;
     int map_row = 0;
+    int failed = 0;
+    int ghosts_cap = 0;
 
     // 1. Parsing do Cabeçalho e Mapa
-    while (line && *line) {
-        if (*line == '#' && !reading_map) { line = next_line(line); continue; }
+    while (!failed && getline(&line, &line_cap, file) != -1) {
+        if (*line == '#' && !reading_map) continue;
         
         char key[16];
         if (!reading_map && sscanf(line, "%15s", key) == 1) {
             if (strcmp(key, "DIM") == 0) {
                 sscanf(line, "DIM %d %d", &board->height, &board->width);
-                board->board = calloc(board->width * board->height, sizeof(board_pos_t));
+                board_free_cells(board); // DIM repetido
+                board_alloc_cells(board, board->width, board->height);
             }
             else if (strcmp(key, "TEMPO") == 0) {
                 sscanf(line, "TEMPO %d", &board->tempo);
             }
             else if (strcmp(key, "PAC") == 0) {
-                sscanf(line, "PAC %s", board->pacman_file);
-                board->n_pacmans = 1;
+                char* p = line;
+                while (*p && isspace(*p)) p++; // Skip indent
+                while (*p && !isspace(*p)) p++; // Skip PAC word
+
+                // Um Pacman por ficheiro; pode haver vários PAC e vários ficheiros por linha
+                while (*p && *p != '\n' && board->n_pacmans < MAX_PACMANS) {
+                    while (*p && *p != '\n' && isspace(*p)) p++;
+                    if (!*p || *p == '\n') break;
+
+                    char* pac_file = board->pacman_files[board->n_pacmans];
+                    int len = 0;
+                    while (*p && !isspace(*p) && len < 255) {
+                        pac_file[len++] = *p++;
+                    }
+                    pac_file[len] = '\0';
+                    board->n_pacmans++;
+                }
             }
             else if (strcmp(key, "MON") == 0) {
                 char* p = line;
                 while (*p && isspace(*p)) p++; // Skip indent
                 while (*p && !isspace(*p)) p++; // Skip MON word
                 
-                while (*p && board->n_ghosts < MAX_GHOSTS) {
-                    while (*p && isspace(*p)) p++;
-                    if (!*p) break;
+                // Os ficheiros terminam no fim da linha do MON
+                while (*p && *p != '\n' && board->n_ghosts < MAX_GHOSTS) {
+                    while (*p && *p != '\n' && isspace(*p)) p++;
+                    if (!*p || *p == '\n') break;
                     
                     char mon_file[256];
                     int len = 0;
@@ -151,131 +284,260 @@ int load_level(board_t* board, const char* dir_path, const char* level_file, int
                         mon_file[len++] = *p++;
                     }
                     mon_file[len] = '\0';
+                    if (board->n_ghosts == ghosts_cap) {
+                        int cap = ghosts_cap ? 2 * ghosts_cap : 16;
+                        char (*files)[256] = realloc(board->ghosts_files, sizeof(*files) * cap);
+                        if (!files) { failed = 1; break; }
+                        board->ghosts_files = files;
+                        ghosts_cap = cap;
+                    }
                     strcpy(board->ghosts_files[board->n_ghosts], mon_file);
                     board->n_ghosts++;
                 }
             }
+            else if (strcmp(key, "NINHO") == 0) {
+                // NINHO <y> <x> <ficheiro.m> <max> (a posição na mesma ordem que o POS)
+                if (board->n_nests == MAX_NESTS) continue;
+                if (!board->nests) {
+                    board->nests = calloc(MAX_NESTS, sizeof(nest_t));
+                    if (!board->nests) { failed = 1; continue; }
+                }
+                nest_t* nest = &board->nests[board->n_nests];
+                memset(nest, 0, sizeof(*nest));
+                nest->x = nest->y = -1;
+                if (sscanf(line, "NINHO %d %d %255s %d", &nest->y, &nest->x, nest->file, &nest->slots) >= 3)
+                    board->n_nests++;
+            }
             else if (strchr("Xo@", *line)) {
                 reading_map = 1;
             }
         }
         
         if (reading_map) {
-             for (int i = 0; i < board->width && line[i] != '\0' && line[i] != '\n'; i++) {
-                 int idx = map_row * board->width + i;
+             // Largura real da linha (sem '\n' nem '\r') para comparar com DIM
+             int len = 0;
+             while (line[len] != '\0' && line[len] != '\n' && line[len] != '\r') len++;
+             if (len != board->width) board->map_bad_rows++;
+
+             // Linhas a mais que o DIM ou mapa sem DIM não podem ser escritas
+             if (!board->chunks || map_row >= board->height) {
+                 map_row++;
+                 continue;
+             }
+             // As casas começam como parede: só as abertas são escritas (e só elas alocam blocos)
+             for (int i = 0; i < board->width && i < len; i++) {
                  char c = line[i];
-                 if (c == 'X') board->board[idx].content = 'W';
-                 else if (c == '@') {
-                     board->board[idx].content = ' ';
-                     board->board[idx].has_portal = 1;
-                 }
-                 else if (c == 'o' || c == '0') {
-                     board->board[idx].content = ' ';
-                     board->board[idx].has_dot = 1;
-                 }
-                 else {
-                     board->board[idx].content = ' ';
-                 }
+                 if (c == 'X') continue;
+                 board_pos_t* cell = board_at_mut(board, i, map_row);
+                 if (!cell) { failed = 1; break; }
+                 cell->content = ' ';
+                 if (c == '@') cell->has_portal = 1;
+                 else if (c == 'o' || c == '0') cell->has_dot = 1;
              }
              map_row++;
         }
-        line = next_line(line);
     }
-    free(buffer);
+    free(line);
+    fclose(file);
+    board->map_rows = map_row;
+
+    // Sem DIM não há tabuleiro onde colocar os agentes
+    if (!board->chunks || failed) {
+        board_free_cells(board);
+        free(board->ghosts_files);
+        free(board->nests);
+        board->ghosts_files = NULL;
+        board->nests = NULL;
+        board->n_nests = 0;
+        return -1;
+    }
+    if (add_nest_slots(board, src) != 0) {
+        board_free_cells(board);
+        free(board->ghosts_files);
+        free(board->nests);
+        free(board->ghosts);
+        free(board->free_slots);
+        free(board->leaving);
+        board->ghosts_files = NULL;
+        board->nests = NULL;
+        board->ghosts = NULL;
+        board->free_slots = board->leaving = NULL;
+        board->n_nests = board->n_ghosts = 0;
+        return -1;
+    }
+    debug("[LOAD] %s: %zu de %zu blocos %dx%d alocados (%zu KB, layout %s)\n", level_file,
+          board_chunks_used(board), (size_t)board->chunks_x * board->chunks_y,
+          1 << board->chunk_shift_x, 1 << board->chunk_shift_y,
+          board_chunks_used(board) * sizeof(board_wall_chunk) / 1024, board_layout_name(board->layout));
 
-    board->pacmans = calloc(1, sizeof(pacman_t));
-    board->ghosts = calloc(board->n_ghosts, sizeof(ghost_t));
+    board->pacmans = calloc(board->n_pacmans ? board->n_pacmans : 1, sizeof(pacman_t));
 
-    // 2. Carregar FANTASMAS (Com lógica de segurança)
-    for (int i = 0; i < board->n_ghosts; i++) {
+    // 2. Carregar FANTASMAS (Com lógica de segurança); as vagas dos ninhos já estão lidas
+    for (int i = 0; i < board->spawn_base; i++) {
         board->ghosts[i].pos_x = -1;
         board->ghosts[i].pos_y = -1;
 
-        snprintf(filepath, sizeof(filepath), "%s/%s", dir_path, board->ghosts_files[i]);
-        parse_agent_file(filepath, &board->ghosts[i].pos_x, &board->ghosts[i].pos_y, 
+        parse_agent_file(src, board->ghosts_files[i], &board->ghosts[i].pos_x, &board->ghosts[i].pos_y, 
                          &board->ghosts[i].passo, board->ghosts[i].moves, &board->ghosts[i].n_moves);
         
         ghost_t* g = &board->ghosts[i];
+        g->n_code = compile_agent_script(board->ghosts_files[i], g->moves, g->n_moves, 1, g->code, &g->left);
+        g->start_x = g->pos_x;
+        g->start_y = g->pos_y;
+        g->active = 1;
+        g->nest = -1;
         if (g->pos_x >= 0 && g->pos_x < board->width && 
             g->pos_y >= 0 && g->pos_y < board->height) {
             
-            int idx = get_board_index(board, g->pos_x, g->pos_y);
-            char content = board->board[idx].content;
+            char content = board_at(board, g->pos_x, g->pos_y)->content;
 
             if (content == 'W' || content == 'M') {
                 int found = 0;
                 for (int y = 0; y < board->height; y++) {
                     for (int x = 0; x < board->width; x++) {
-                        int try_idx = get_board_index(board, x, y);
-                        if (board->board[try_idx].content != 'W' && board->board[try_idx].content != 'M') {
+                        char try_content = board_at(board, x, y)->content;
+                        if (try_content != 'W' && try_content != 'M') {
                             g->pos_x = x; g->pos_y = y; found = 1; break;
                         }
                     }
                     if (found) break;
                 }
             }
-            int final_idx = get_board_index(board, g->pos_x, g->pos_y);
-            if (board->board[final_idx].content != 'W') board->board[final_idx].content = 'M';
+            if (board_at(board, g->pos_x, g->pos_y)->content != 'W')
+                board_at_mut(board, g->pos_x, g->pos_y)->content = 'M';
         }
     }
 
-    // 3. Carregar PACMAN (Com lógica de segurança)
-    if (board->n_pacmans > 0) {
-        snprintf(filepath, sizeof(filepath), "%s/%s", dir_path, board->pacman_file);
-        parse_agent_file(filepath, &board->pacmans[0].pos_x, &board->pacmans[0].pos_y, 
-                         &board->pacmans[0].passo, board->pacmans[0].moves, &board->pacmans[0].n_moves);
+    // 3. Carregar PACMANS (Com lógica de segurança)
+    int players = 0;
+    for (int i = 0; i < board->n_pacmans; i++) {
+        pacman_t* p = &board->pacmans[i];
+        parse_agent_file(src, board->pacman_files[i], &p->pos_x, &p->pos_y, &p->passo, p->moves, &p->n_moves);
+        p->n_code = compile_agent_script(board->pacman_files[i], p->moves, p->n_moves, 0, p->code, &p->left);
         
-        pacman_t* p = &board->pacmans[0];
         p->alive = 1;
-        p->points = accumulated_points;
+        p->points = (i == 0) ? accumulated_points : 0; // Os pontos da equipa passam de nível no primeiro
+        p->start_x = p->pos_x;
+        p->start_y = p->pos_y;
+        // Sem script, o Pacman é de um jogador do teclado (se ainda houver teclas livres)
+        p->player = (p->n_moves == 0 && players < MAX_PLAYERS) ? players++ : -1;
 
-        int idx = get_board_index(board, p->pos_x, p->pos_y);
-        if (board->board[idx].content == 'W' || board->board[idx].content == 'M') {
+        int inside = p->pos_x >= 0 && p->pos_x < board->width && p->pos_y >= 0 && p->pos_y < board->height;
+        if (!inside || board_at(board, p->pos_x, p->pos_y)->content != ' ') {
             int found = 0;
             for (int y = 0; y < board->height; y++) {
                 for (int x = 0; x < board->width; x++) {
-                    int try_idx = get_board_index(board, x, y);
-                    char c = board->board[try_idx].content;
-                    if (c != 'W' && c != 'M') {
+                    if (board_at(board, x, y)->content == ' ') {
                         p->pos_x = x; p->pos_y = y; found = 1; break;
                     }
                 }
                 if (found) break;
             }
         }
-        idx = get_board_index(board, p->pos_x, p->pos_y);
-        board->board[idx].content = 'P';
-        board->board[idx].has_dot = 0; 
+        // Sem casa livre o Pacman fica onde está (o analyzer rejeita o nível); as paredes
+        // podem ser o bloco partilhado e nunca são escritas
+        inside = p->pos_x >= 0 && p->pos_x < board->width && p->pos_y >= 0 && p->pos_y < board->height;
+        if (!inside) continue;
+        if (board_at(board, p->pos_x, p->pos_y)->content == 'W') continue;
+        board_pos_t* cell = board_at_mut(board, p->pos_x, p->pos_y);
+        cell->content = 'P';
+        cell->has_dot = 0; 
     } 
-    else {
+    if (board->n_pacmans == 0) {
         // Fallback Manual
         board->n_pacmans = 1;
+        board->pacman_files[0][0] = '\0';
         board->pacmans[0].alive = 1;
         board->pacmans[0].points = accumulated_points;
+        board->pacmans[0].player = 0;
         int sx = 1, sy = 1;
-        if (board->board[get_board_index(board, sx, sy)].content == 'W') {
+        if (sx >= board->width || sy >= board->height || board_at(board, sx, sy)->content == 'W') {
              // Procura simples se (1,1) for parede
-             for(int i=0; i<board->width*board->height; i++) 
-                if(board->board[i].content != 'W') { sx = i%board->width; sy = i/board->width; break; }
+             int found = 0;
+             for (int y = 0; y < board->height && !found; y++)
+                for (int x = 0; x < board->width && !found; x++)
+                    if (board_at(board, x, y)->content != 'W') { sx = x; sy = y; found = 1; }
         }
         board->pacmans[0].pos_x = sx; board->pacmans[0].pos_y = sy;
-        board->board[get_board_index(board, sx, sy)].content = 'P';
+        board->pacmans[0].start_x = sx; board->pacmans[0].start_y = sy;
+        if (sx < board->width && sy < board->height && board_at(board, sx, sy)->content != 'W')
+            board_at_mut(board, sx, sy)->content = 'P';
     }
 
+    // Geradores dos agentes ('R'): a semente vem do srand do main
+    board_seed(board, (uint32_t)rand());
+    board_rehash(board);
+
     // Inicializar o Mutex
     board->row_locks = malloc(sizeof(pthread_mutex_t) * board->height);
     for (int i = 0; i < board->height; i++) {
         pthread_mutex_init(&board->row_locks[i], NULL);
     }
     pthread_mutex_init(&board->global_stats_lock, NULL);
-    board->save_request = 0;    
-    board->game_running = 1;      // Marcar jogo como ativo
-    board->next_pacman_cmd = '\0'; // Limpar comando
-    board->exit_status = 0;
+    pthread_mutex_init(&board->board_lock, NULL);
+    board_init_wake(board);
+    atomic_store(&board->save_request, 0);
+    atomic_store(&board->state, GAME_RUNNING); // Marcar jogo como ativo
+
+    return 0;
+}
+
+int parse_level(board_t* board, const char* dir_path, const char* level_file, int accumulated_points) {
+    level_source_t src = { dir_path, NULL };
+    return parse_level_src(board, &src, level_file, accumulated_points);
+}
+
+static int load_level_src(board_t* board, const level_source_t* src, const char* level_file, int accumulated_points) {
+    if (parse_level_src(board, src, level_file, accumulated_points) != 0) {
+        debug("[LOAD] %s: nível inválido (sem DIM ou ficheiro ilegível)\n", level_file);
+        return -1;
+    }
+
+    // Análise estática: níveis partidos são rejeitados antes de serem jogados
+    level_report_t report;
+    int errors = analyze_level(board, &report);
+    log_level_report(&report);
+    if (errors > 0) {
+        unload_level(board);
+        return -1;
+    }
 
+    // Trajetórias dos fantasmas deterministas (sem memória o nível joga-se sem elas)
+    board->trajs = traj_build(board);
     return 0;
 }
 
+int load_level(board_t* board, const char* dir_path, const char* level_file, int accumulated_points) {
+    level_source_t src = { dir_path, NULL };
+    return load_level_src(board, &src, level_file, accumulated_points);
+}
+
+int load_level_bundle(board_t* board, const level_bundle_t* bundle, const char* level_file, int accumulated_points) {
+    level_source_t src = { NULL, bundle };
+    return load_level_src(board, &src, level_file, accumulated_points);
+}
+
+int bundle_add_file(level_bundle_t* bundle, const char* name, char* data, size_t len) {
+    if (bundle->n_files == bundle->cap) {
+        int cap = bundle->cap ? 2 * bundle->cap : 8;
+        bundle_file_t* files = realloc(bundle->files, sizeof(bundle_file_t) * cap);
+        if (!files) return -1;
+        bundle->files = files;
+        bundle->cap = cap;
+    }
+    bundle_file_t* f = &bundle->files[bundle->n_files++];
+    snprintf(f->name, sizeof(f->name), "%s", name);
+    f->data = data;
+    f->len = len;
+    return 0;
+}
+
+void bundle_free(level_bundle_t* bundle) {
+    for (int i = 0; i < bundle->n_files; i++) free(bundle->files[i].data);
+    free(bundle->files);
+    memset(bundle, 0, sizeof(*bundle));
+}
+
 void unload_level(board_t * board) {
     if (!board) return;
 
@@ -290,15 +552,119 @@ void unload_level(board_t * board) {
 
     // 2. Destruir mutex global
     pthread_mutex_destroy(&board->global_stats_lock);
+    pthread_mutex_destroy(&board->board_lock);
+    board_destroy_wake(board);
 
     // 3. Libertar o resto (como já tinhas)
-    if (board->board) free(board->board);
+    board_free_cells(board);
     if (board->pacmans) free(board->pacmans);
     if (board->ghosts) free(board->ghosts);
     
-    board->board = NULL;
+    free(board->ghosts_files);
+    free(board->nests);
+    free(board->free_slots);
+    free(board->leaving);
+    traj_free(board->trajs);
+    board->trajs = NULL;
+    board->nests = NULL;
+    board->free_slots = board->leaving = NULL;
+    board->n_nests = 0;
     board->pacmans = NULL;
     board->ghosts = NULL;
+    board->ghosts_files = NULL;
     board->n_ghosts = 0;
     board->n_pacmans = 0;
-}
\ No newline at end of file
+}
+
+void move_level(board_t* dst, board_t* src) {
+    pthread_mutex_destroy(&src->global_stats_lock);
+    pthread_mutex_destroy(&src->board_lock);
+    board_destroy_wake(src);
+    *dst = *src;
+    pthread_mutex_init(&dst->global_stats_lock, NULL);
+    pthread_mutex_init(&dst->board_lock, NULL);
+    board_init_wake(dst);
+    memset(src, 0, sizeof(*src));
+}
+
+// ==================================================================
+// TROCA DE SCRIPTS (ficheiro de agente alterado com o nível carregado)
+// ==================================================================
+int load_agent_script(agent_script_t* script, const char* dir_path, const char* file) {
+    level_source_t src = { dir_path, NULL };
+    snprintf(script->file, sizeof(script->file), "%s", file);
+    script->start_x = script->start_y = -1;
+    if (parse_agent_file(&src, file, &script->start_x, &script->start_y, &script->passo,
+                         script->moves, &script->n_moves) != 0) return -1;
+
+    script->n_ghost_code = script_compile(script->moves, script->n_moves, 1, script->ghost_code,
+                                          script->ghost_err, sizeof(script->ghost_err));
+    script->n_pacman_code = script_compile(script->moves, script->n_moves, 0, script->pacman_code,
+                                           script->pacman_err, sizeof(script->pacman_err));
+    return 0;
+}
+
+int level_uses_file(const board_t* board, const char* file) {
+    for (int i = 0; i < board->n_pacmans; i++)
+        if (strcmp(board->pacman_files[i], file) == 0) return 1;
+    for (int i = 0; i < board->n_ghosts; i++)
+        if (strcmp(board->ghosts_files[i], file) == 0) return 1;
+    for (int i = 0; i < board->n_nests; i++)
+        if (strcmp(board->nests[i].file, file) == 0) return 1;
+    return 0;
+}
+
+// Os agentes de um jogador não têm script: o ficheiro só volta a contar no próximo carregamento
+static int pacman_takes_script(const board_t* board, int i, const char* file) {
+    return board->pacmans[i].player < 0 && strcmp(board->pacman_files[i], file) == 0;
+}
+
+int swap_agent_script(board_t* board, const agent_script_t* script, int* moved, char* err, size_t err_len) {
+    *moved = 0;
+    int ghosts = 0, pacmans = 0;
+    for (int i = 0; i < board->n_ghosts; i++)
+        if (strcmp(board->ghosts_files[i], script->file) == 0) ghosts++;
+    for (int i = 0; i < board->n_pacmans; i++)
+        if (pacman_takes_script(board, i, script->file)) pacmans++;
+
+    // Um script partido não entra: os agentes continuam com o que tinham
+    if (ghosts && script->n_ghost_code < 0) {
+        snprintf(err, err_len, "%s", script->ghost_err);
+        return -1;
+    }
+    if (pacmans && script->n_pacman_code < 0) {
+        snprintf(err, err_len, "%s", script->pacman_err);
+        return -1;
+    }
+
+    for (int i = 0; i < board->n_ghosts; i++) {
+        if (strcmp(board->ghosts_files[i], script->file) != 0) continue;
+        ghost_t* g = &board->ghosts[i];
+        // As vagas dos ninhos nascem no ninho, não na POS do ficheiro
+        if (g->nest < 0 && (g->start_x != script->start_x || g->start_y != script->start_y)) *moved = 1;
+        g->passo = script->passo;
+        memcpy(g->moves, script->moves, sizeof(command_t) * script->n_moves);
+        g->n_moves = script->n_moves;
+        memcpy(g->code, script->ghost_code, sizeof(script_op_t) * script->n_ghost_code);
+        g->n_code = script->n_ghost_code;
+        g->pc = 0;
+        g->left = g->n_code > 0 ? g->code[0].count : 1;
+        g->waiting = 0;
+        g->charged = 0;
+    }
+    for (int i = 0; i < board->n_pacmans; i++) {
+        if (!pacman_takes_script(board, i, script->file)) continue;
+        pacman_t* p = &board->pacmans[i];
+        if (p->start_x != script->start_x || p->start_y != script->start_y) *moved = 1;
+        p->passo = script->passo;
+        memcpy(p->moves, script->moves, sizeof(command_t) * script->n_moves);
+        p->n_moves = script->n_moves;
+        memcpy(p->code, script->pacman_code, sizeof(script_op_t) * script->n_pacman_code);
+        p->n_code = script->n_pacman_code;
+        p->pc = 0;
+        p->left = p->n_code > 0 ? p->code[0].count : 1;
+        p->waiting = 0;
+    }
+    board_rehash(board);
+    return ghosts + pacmans;
+}
@@ -1,12 +1,35 @@
 #include "board.h"
 #include "display.h"
 #include "files.h"
+#include "analyzer.h"
+#include "montecarlo.h"
+#include "sim.h"
+#include "batch.h"
+#include "tick.h"
+#include "server.h"
+#include "spectate.h"
+#include "shard.h"
+#include "journal.h"
+#include "watch.h"
+#include "stream.h"
+#include "stress.h"
+#include "spawn.h"
+#include "traj.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <poll.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
 #include <sys/wait.h>
 #include <sys/types.h>
+#include <fcntl.h>
 
 // Códigos de Saída
 #define EXIT_RESTORE 10
@@ -15,209 +38,464 @@
 // Variável Global para controlar Saves
 int has_active_save = 0;
 
-// Estrutura auxiliar para passar argumentos às threads dos fantasmas
+// Período máximo de desenho do ecrã
+#define UI_FRAME_MS 33
+
+// A thread de UI dorme em poll() até haver uma tecla, uma jogada nova ou um frame
+#define UI_INPUT 1
+#define UI_EVENT 2
+#define UI_FRAME 4
+#define UI_WATCH 8
+
 typedef struct {
-    board_t* board;
-    int id; // Índice do fantasma
-} thread_arg_t;
-
-void lock_all_rows(board_t* board) {
-    // Ordem crescente obrigatória
-    for (int i = 0; i < board->height; i++) {
-        pthread_mutex_lock(&board->row_locks[i]);
-    }
-}
+    int timer_fd;  // timerfd periódico de UI_FRAME_MS
+    int event_fd;  // eventfd: a thread de jogo avisa a cada jogada e no fim
+    int stdin_eof; // stdin fechado (ex.: < /dev/null): deixa de entrar no poll
+    int watch_fd;  // inotify da diretoria dos níveis (-1 sem vigia)
+} ui_loop_t;
+
+ui_loop_t ui = { -1, -1, 0, -1 };
+
+// Motor da thread de jogo (NULL entre níveis); o save põe-no em dia antes do fork
+tick_engine_t* live_engine = NULL;
+
+// Teclas B por tratar: a thread de jogo volta REWIND_MS atrás por cada uma
+#define REWIND_MS 2000
+atomic_int rewind_request = 0;
+
+// Scripts gravados à espera da thread de jogo, que os troca entre duas jogadas
+#define MAX_SWAPS 16
+pthread_mutex_t swap_lock = PTHREAD_MUTEX_INITIALIZER;
+agent_script_t* swap_queue[MAX_SWAPS];
+atomic_int n_swaps = 0;
+
+// Anel dos espectadores ("--publish <name>"); NULL se o jogo não é transmitido
+spec_pub_t* spectate_pub = NULL;
 
-void unlock_all_rows(board_t* board) {
-    for (int i = 0; i < board->height; i++) {
-        pthread_mutex_unlock(&board->row_locks[i]);
-    }
-}
 void screen_refresh(board_t * game_board, int mode) {
     if (mode == DRAW_MENU) lock_all_rows(game_board);
     debug("REFRESH\n");
     draw_board(game_board, mode);
     refresh_screen();
     if (mode == DRAW_MENU) unlock_all_rows(game_board);
-    if(game_board->tempo != 0)
-        sleep_ms(game_board->tempo);       
 }
 
-// ==================================================================
-// THREAD DO FANTASMA
-// ==================================================================
-void* ghost_thread(void* arg) {
-    thread_arg_t* params = (thread_arg_t*)arg;
-    board_t* board = params->board;
-    int ghost_idx = params->id;
-    free(params); // Libertar memória do argumento
-
-    debug("[THREAD GHOST %d] Iniciada.\n", ghost_idx);
-    ghost_t* self = &board->ghosts[ghost_idx];
-    
-    while (board->game_running) {
-        
-        // --- 1. MOVER PRIMEIRO ---
-        // (Sem sleep aqui)
-
-        // Verificar fim
-        if (!board->game_running) break;
-
-        command_t cmd;
-        if (self->n_moves > 0) {
-            cmd = self->moves[self->current_move % self->n_moves];
-            move_ghost(board, ghost_idx, &cmd);
-        } else {
-            char opts[] = {'W','A','S','D'};
-            cmd.command = opts[rand() % 4];
-            move_ghost(board, ghost_idx, &cmd);
-        }
+static int ui_open(ui_loop_t* loop) {
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->timer_fd < 0 || loop->event_fd < 0) return -1;
+    struct itimerspec period = {
+        { UI_FRAME_MS / 1000, (UI_FRAME_MS % 1000) * 1000000L },
+        { UI_FRAME_MS / 1000, (UI_FRAME_MS % 1000) * 1000000L },
+    };
+    return timerfd_settime(loop->timer_fd, 0, &period, NULL);
+}
 
-        // --- 2. DORMIR DEPOIS ---
-        int sleep_time = (board->tempo > 0) ? board->tempo : 100;
-        sleep_ms(sleep_time);
+static void ui_close(ui_loop_t* loop) {
+    if (loop->timer_fd >= 0) close(loop->timer_fd);
+    if (loop->event_fd >= 0) close(loop->event_fd);
+    loop->timer_fd = loop->event_fd = -1;
+}
+
+// Chamado pela thread de jogo: acorda a UI
+static void ui_notify(ui_loop_t* loop) {
+    uint64_t one = 1;
+    if (loop->event_fd >= 0 && write(loop->event_fd, &one, sizeof(one)) < 0) {
+        // Contador cheio: a UI já tem uma notificação pendente
     }
-    return NULL;
+}
+
+// Bloqueia até haver alguma coisa para fazer; devolve UI_INPUT | UI_EVENT | UI_FRAME | UI_WATCH
+static int ui_wait(ui_loop_t* loop) {
+    struct pollfd fds[4] = {
+        { loop->stdin_eof ? -1 : STDIN_FILENO, POLLIN, 0 },
+        { loop->event_fd, POLLIN, 0 },
+        { loop->timer_fd, POLLIN, 0 },
+        { loop->watch_fd, POLLIN, 0 },
+    };
+    while (poll(fds, 4, -1) < 0) {
+        if (errno != EINTR) return UI_FRAME; // Sem poll: pelo menos continuar a desenhar
+    }
+
+    int woke = 0;
+    uint64_t count;
+    if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+        // Pronto para ler mas sem bytes = fim do ficheiro; senão ficava sempre pronto
+        int pending = 0;
+        if (ioctl(STDIN_FILENO, FIONREAD, &pending) == 0 && pending == 0) loop->stdin_eof = 1;
+        else woke |= UI_INPUT;
+    }
+    if ((fds[1].revents & POLLIN) && read(loop->event_fd, &count, sizeof(count)) == sizeof(count)) woke |= UI_EVENT;
+    if ((fds[2].revents & POLLIN) && read(loop->timer_fd, &count, sizeof(count)) == sizeof(count)) woke |= UI_FRAME;
+    if (fds[3].revents & POLLIN) woke |= UI_WATCH;
+    return woke;
 }
 
 // ==================================================================
-// THREAD DO PACMAN
+// THREAD DE JOGO
 // ==================================================================
-void* pacman_thread(void* arg) {
-    board_t* board = (board_t*)arg;
-    pacman_t* self = &board->pacmans[0];
-    debug("[THREAD PACMAN] Iniciada.\n");
+// Volta ticks jogadas atrás com o jornal (entre jogadas, na thread de jogo)
+static void rewind_live(tick_engine_t* engine, journal_t* journal, long ticks) {
+    board_t* board = engine->board;
+    pthread_mutex_lock(&board->board_lock);
+    lock_all_rows(board);
+    long from = engine->tick;
+    engine->tick = journal_rewind(journal, board, engine->tick - ticks);
+    tick_reschedule(engine);
+    unlock_all_rows(board);
+    pthread_mutex_unlock(&board->board_lock);
+    debug("[JOURNAL] Voltou da jogada %ld à %ld (%.1f KB de histórico)\n",
+          from, engine->tick, journal_bytes(journal) / 1024.0);
+    spec_publish_reset(spectate_pub);
+}
 
-    while (board->game_running) {
-        // Sleep pequeno para não "queimar" CPU
-        //sleep_ms(10); 
+// Troca os scripts gravados (entre jogadas, na thread de jogo)
+static void apply_swaps(tick_engine_t* engine, journal_t* journal) {
+    board_t* board = engine->board;
+    pthread_mutex_lock(&swap_lock);
+    pthread_mutex_lock(&board->board_lock);
+    lock_all_rows(board);
+    tick_sync(engine); // Os agentes a dormir ficam em dia antes de recomeçarem o script
+    int n = atomic_exchange(&n_swaps, 0);
+    for (int i = 0; i < n; i++) {
+        char err[128];
+        int moved;
+        int changed = swap_agent_script(board, swap_queue[i], &moved, err, sizeof(err));
+        if (changed < 0) debug("[WATCH] %s não entra no nível: %s\n", swap_queue[i]->file, err);
+        else debug("[WATCH] %s: script trocado em %d agente(s)%s\n", swap_queue[i]->file, changed,
+                   moved ? " (a POS nova só conta quando o nível for lido)" : "");
+        free(swap_queue[i]);
+    }
+    // As trajetórias eram dos scripts antigos; o jogo ao vivo não precisa delas
+    traj_free(board->trajs);
+    board->trajs = NULL;
+    tick_reschedule(engine);
+    // O histórico tem cursores dos scripts antigos
+    if (journal) journal_reset(journal, board, engine->tick);
+    unlock_all_rows(board);
+    pthread_mutex_unlock(&board->board_lock);
+    pthread_mutex_unlock(&swap_lock);
+}
 
-        // CORREÇÃO: Removido lock_all_rows daqui. O move_pacman trata dos locks.
+// Uma só thread avança o jogo: decisão em paralelo no pool, resolução por ordem
+void* tick_thread(void* arg) {
+    board_t* board = (board_t*)arg;
+    debug("[THREAD TICK] Iniciada.\n");
 
-        if (!board->game_running) {
-            break;
+    tick_engine_t engine;
+    if (tick_engine_init(&engine, board, 0) != 0) {
+        board_finish(board, GAME_QUIT);
+        return NULL;
+    }
+    spec_publish(spectate_pub, board);
+
+    // Prazos absolutos: o trabalho de cada jogada não atrasa as seguintes
+    tick_clock_t clock;
+    int period = (board->tempo > 0) ? board->tempo : 100;
+    tick_clock_start(&clock, period);
+
+    // Sem memória para o jornal o jogo continua, só sem B
+    journal_t* journal = journal_create(board, engine.tick, 0, 0);
+    atomic_store(&rewind_request, 0);
+
+    pthread_mutex_lock(&board->board_lock);
+    live_engine = &engine;
+    pthread_mutex_unlock(&board->board_lock);
+
+    int step = 1; // 0 = acordada antes da próxima jogada: só trata dos pedidos e volta a dormir
+    while (board_running(board)) {
+        int back = atomic_exchange(&rewind_request, 0);
+        if (back > 0 && journal) rewind_live(&engine, journal, back * (REWIND_MS / period + 1));
+        if (atomic_load(&n_swaps) > 0) apply_swaps(&engine, journal);
+
+        if (step) {
+            int outcome = tick_step(&engine);
+            if (journal) {
+                // O jornal compara o estado dos agentes: os que dormem têm de estar em dia
+                pthread_mutex_lock(&board->board_lock);
+                tick_sync(&engine);
+                journal_record(journal, board, engine.tick);
+                pthread_mutex_unlock(&board->board_lock);
+            }
+            spec_publish(spectate_pub, board);
+            ui_notify(&ui);
+
+            if (outcome == SIM_WIN) board_finish(board, GAME_WON);
+            else if (outcome == SIM_DEATH) board_finish(board, GAME_DEAD);
+            else if (outcome == SIM_QUIT) board_finish(board, GAME_QUIT);
+            if (!board_running(board)) {
+                ui_notify(&ui); // A UI sai do poll logo
+                break;
+            }
         }
 
-        command_t cmd;
-        int moved = 0;
+        // Dorme até à próxima jogada em que alguém age (sem prazo se ninguém voltar a
+        // agir); o fim do nível, B e os scripts gravados acordam-na antes (board_wake)
+        long idle = tick_idle(&engine);
+        long n = idle < 0 ? TICK_FOREVER : idle + 1;
+        long passed = tick_clock_sleep(&clock, n, board);
+        step = passed == n;
+        tick_skip(&engine, step ? idle : passed);
+    }
+    pthread_mutex_lock(&board->board_lock);
+    live_engine = NULL;
+    pthread_mutex_unlock(&board->board_lock);
+    debug("[THREAD TICK] %ld jogadas a %.2f/s (alvo %.2f/s): %ld atrasadas, %ld perdidas, %ld paragens, atraso máx %.1f ms\n",
+          clock.ticks, tick_clock_rate(&clock), tick_clock_target(&clock), clock.overruns, clock.missed,
+          clock.stalls, clock.max_late_ns / 1e6);
+    debug("[THREAD TICK] %ld agentes acordados em %ld jogadas\n", engine.woken, engine.tick);
+    journal_free(journal);
+    tick_engine_free(&engine);
+    return NULL;
+}
 
-        // Prioridade A: Comando Manual (vindo da Main Thread)
-        if (board->next_pacman_cmd != '\0') {
-            cmd.command = board->next_pacman_cmd;
-            cmd.turns = 1;
-            board->next_pacman_cmd = '\0'; // Limpar comando
-            
-            int result = move_pacman(board, 0, &cmd);
-            moved = 1;
-
-            if (result == REACHED_PORTAL) {
-                board->exit_status = 1; // Vitória
-                board->game_running = 0;
-            } else if (result == DEAD_PACMAN) {
-                board->exit_status = 2; // Morte
-                board->game_running = 0;
-            }
-        }
-    // Prioridade B: Modo Automático (Ficheiro)
-        else if (self->n_moves > 0) {
-             cmd = self->moves[self->current_move % self->n_moves];
-
-             // --- TRATAMENTO DE COMANDOS ESPECIAIS (G e Q) ---
-             
-             // Caso 1: SAVE (G)
-             if (cmd.command == 'G') {
-                 if (!has_active_save) { // Só pede save se nao houver um ativo
-                     board->save_request = 1; 
-                 }
-                 self->current_move++;    
-                 sleep_ms(50);            
-                 continue; 
-             }
-             
-             // Caso 2: QUIT (Q)
-             if (cmd.command == 'Q') {
-                 board->exit_status = 3;  // Código de saída 3 = QUIT
-                 board->game_running = 0; // Para todas as threads
-                 break; // Sai imediatamente do while da thread
-             }
-             // -----------------------------------------------
-
-             int result = move_pacman(board, 0, &cmd);
-             moved = 1;
-
-             if (result == REACHED_PORTAL) {
-                 board->exit_status = 1;
-                 board->game_running = 0;
-             } else if (result == DEAD_PACMAN) {
-                 board->exit_status = 2;
-                 board->game_running = 0;
-             }
-        }
+// O save só acontece entre jogadas: a thread de jogo fica parada no board_lock
+static void freeze_board(board_t* board) {
+    pthread_mutex_lock(&board->board_lock);
+    lock_all_rows(board);
+    // Os agentes a dormir na agenda têm o passo e os 'T' atrasados: o filho herda-os em dia
+    if (live_engine) tick_sync(live_engine);
+}
 
-        // Verificação passiva (se um fantasma me matou no turno dele)
-        if (!self->alive && board->game_running) {
-             board->exit_status = 2; 
-             board->game_running = 0;
-        }
+static void thaw_board(board_t* board) {
+    unlock_all_rows(board);
+    pthread_mutex_unlock(&board->board_lock);
+}
 
-        // Se houve movimento automático, esperar o TEMPO do jogo
-        if (moved && self->n_moves > 0) sleep_ms(board->tempo);
+// ==================================================================
+// RELOAD A QUENTE (ficheiros gravados na diretoria dos níveis)
+// ==================================================================
+// Passa um script para a thread de jogo; o mesmo ficheiro gravado outra vez substitui o anterior
+static void queue_swap(agent_script_t* script) {
+    pthread_mutex_lock(&swap_lock);
+    int n = atomic_load(&n_swaps);
+    int i = 0;
+    while (i < n && strcmp(swap_queue[i]->file, script->file) != 0) i++;
+    if (i < n) free(swap_queue[i]);
+    if (i < MAX_SWAPS) {
+        swap_queue[i] = script;
+        if (i == n) atomic_store(&n_swaps, n + 1);
     }
-    return NULL;
+    else {
+        debug("[WATCH] %s: demasiados scripts por trocar, fica para o próximo carregamento\n", script->file);
+        free(script);
+    }
+    pthread_mutex_unlock(&swap_lock);
+}
+
+// Um .lvl novo entra na lista, por ordem, se ainda não chegou a vez dele
+static void add_level_name(struct dirent*** namelist, int* n, int current, const char* name) {
+    for (int i = current; i < *n; i++)
+        if (strcmp((*namelist)[i]->d_name, name) == 0) return;
+    if (strcoll(name, (*namelist)[current]->d_name) < 0) return;
+    int at = current + 1;
+    while (at < *n && strcoll((*namelist)[at]->d_name, name) < 0) at++;
+
+    struct dirent** list = realloc(*namelist, sizeof(*list) * (*n + 1));
+    if (!list) return;
+    *namelist = list;
+    struct dirent* entry = calloc(1, sizeof(struct dirent));
+    if (!entry) return;
+    snprintf(entry->d_name, sizeof(entry->d_name), "%s", name);
+    memmove(&list[at + 1], &list[at], sizeof(*list) * (*n - at));
+    list[at] = entry;
+    (*n)++;
+    debug("[WATCH] %s: nível novo na lista\n", name);
+}
+
+/* Lê os ficheiros gravados. Um .m / .p usado pelo nível atual vai para a thread de
+   jogo (queue_swap); o .lvl atual é lido de novo para fresh, sem parar o jogo, e só
+   se for aceite o nível recomeça (devolve 1). Os outros níveis são lidos do disco
+   quando chegar a vez deles */
+static int hot_reload(level_watch_t* watch, board_t* board, board_t* fresh, int* fresh_ready,
+                      const char* dir_path, int accumulated_points, struct dirent*** namelist, int* n, int current) {
+    watch_change_t changes[64];
+    int k, restart = 0;
+    while ((k = watch_read(watch, changes, 64)) > 0) {
+        for (int c = 0; c < k; c++) {
+            const watch_change_t* change = &changes[c];
+            if (change->removed || change->kind == WATCH_OVERFLOW) continue;
+
+            if (change->kind == WATCH_AGENT) {
+                if (!level_uses_file(board, change->name)) continue;
+                agent_script_t* script = malloc(sizeof(agent_script_t));
+                if (script && load_agent_script(script, dir_path, change->name) == 0) {
+                    queue_swap(script);
+                    board_wake(board);
+                }
+                else free(script);
+                continue;
+            }
+            if (strcmp(change->name, board->level_name) != 0) {
+                add_level_name(namelist, n, current, change->name);
+                continue;
+            }
+            // Recomeçar o nível no filho de um save deitava o save fora
+            if (has_active_save) {
+                debug("[WATCH] %s: gravado durante um save, fica para o próximo carregamento\n", change->name);
+                continue;
+            }
+            if (*fresh_ready) unload_level(fresh);
+            *fresh_ready = load_level(fresh, dir_path, change->name, accumulated_points) == 0;
+            debug("[WATCH] %s: %s\n", change->name, *fresh_ready ? "lido de novo, o nível recomeça"
+                                                                  : "rejeitado, o jogo continua com o anterior");
+            restart |= *fresh_ready;
+        }
+    }
+    return restart;
 }
 
 // ==================================================================
 // MAIN (UI THREAD)
 // ==================================================================
+// Uma linha por modo; cada modo mostra os seus argumentos se faltarem
+static const char* const usage_lines[] = {
+    "<dir> [--publish <name>]",
+    "--stream <fifo|-> [--publish <name>]",
+    "--check <dir> [threads]",
+    "--montecarlo <dir> [runs] [max_ticks] [threads]",
+    "--headless <dir> [max_ticks]",
+    "--headless --stream <fifo|-> [max_ticks]",
+    "--batch <dir> [K] [ticks]",
+    "--render-bench <dir> [frames]",
+    "--layout-bench <dir> [ticks]",
+    "--spawn-bench <dir> [ticks]",
+    "--shards <dir> [workers] [--verify ticks]",
+    "--rewind <dir> [ticks] [depth]",
+    "--watch <dir> [seconds]",
+    "--cas-stress [threads] [moves] [runs]",
+    "--server <socket> <dir> [threads]",
+    "--connect <socket>",
+    "--spectate <name>",
+};
+
 int main(int argc, char** argv) {
-    if (argc < 2) { printf("Usage: %s <dir>\n", argv[0]); return 1; }
+    if (argc < 2) {
+        for (size_t i = 0; i < sizeof(usage_lines) / sizeof(usage_lines[0]); i++)
+            printf("%s %s %s\n", i == 0 ? "Usage:" : "      ", argv[0], usage_lines[i]);
+        return 1;
+    }
+
+    // Modos sem interface
+    if (strcmp(argv[1], "--check") == 0) return analyzer_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--montecarlo") == 0) return montecarlo_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--headless") == 0 && argc > 2 && strcmp(argv[2], "--stream") == 0)
+        return stream_sim_main(argc - 2, argv + 2);
+    if (strcmp(argv[1], "--headless") == 0) return sim_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--batch") == 0) return batch_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--server") == 0) return server_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--connect") == 0) return client_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--render-bench") == 0) return render_bench_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--layout-bench") == 0) return layout_bench_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--spectate") == 0) return spectate_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--shards") == 0) return shard_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--rewind") == 0) return journal_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--watch") == 0) return watch_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--spawn-bench") == 0) return spawn_bench_main(argc - 1, argv + 1);
+    if (strcmp(argv[1], "--cas-stress") == 0) return cas_stress_main(argc - 1, argv + 1);
+
+    // Os níveis vêm de uma diretoria ou, com --stream, de stdin / um FIFO à medida que chegam
+    int arg = 1;
+    if (strcmp(argv[1], "--stream") == 0) {
+        if (argc < 3) { printf("Usage: %s --stream <fifo|-> [--publish <name>]\n", argv[0]); return 1; }
+        arg = 2;
+    }
+    char* dir_path = argv[arg];
+    struct dirent **namelist = NULL;
+    int n = 0;
+    level_stream_t* stream = NULL;
+    // Antes da stream: a thread que a lê já escreve no debug.log
+    open_debug_file("debug.log");
+    if (arg == 2) {
+        stream = stream_open(dir_path, STREAM_AHEAD);
+        if (!stream) { perror(dir_path); return 1; }
+        // Os níveis vêm pelo stdin: as teclas passam a vir do terminal
+        if (strcmp(dir_path, "-") == 0) {
+            int tty = open("/dev/tty", O_RDONLY);
+            if (tty < 0) tty = open("/dev/null", O_RDONLY);
+            if (tty >= 0) { dup2(tty, STDIN_FILENO); close(tty); }
+        }
+    }
+    else if ((n = scandir(dir_path, &namelist, filter_levels, alphasort)) < 0) { perror("scandir"); return 1; }
+    if (argc >= arg + 3 && strcmp(argv[arg + 1], "--publish") == 0) {
+        spectate_pub = spec_publish_open(argv[arg + 2]);
+        if (!spectate_pub) { fprintf(stderr, "Não foi possível publicar em %s\n", argv[arg + 2]); return 1; }
+    }
 
-    char* dir_path = argv[1];
-    struct dirent **namelist;
-    int n = scandir(dir_path, &namelist, filter_levels, alphasort);
-    if (n < 0) { perror("scandir"); return 1; }
+    // Sem inotify o jogo continua, só sem reload a quente (que não se aplica a uma stream)
+    level_watch_t* watch = stream ? NULL : watch_open(dir_path);
+    ui.watch_fd = watch ? watch_fd(watch) : -1;
 
     srand(time(NULL));
-    open_debug_file("debug.log");
+    if (ui_open(&ui) != 0) { perror("timerfd/eventfd"); return 1; }
     terminal_init();
     
     board_t game_board;
     int accumulated_points = 0;
     has_active_save = 0;
-
-    for (int i = 0; i < n; i++) {
-        if (load_level(&game_board, dir_path, namelist[i]->d_name, accumulated_points) != 0) {
+    board_t fresh;      // O nível atual lido de novo depois de gravado
+    int fresh_ready = 0;
+    int preloaded = 0;  // game_board já tem o nível (veio de fresh)
+
+    for (int i = 0; stream || i < n; i++) {
+        if (!preloaded && stream) {
+            // Espera pelo próximo nível já carregado (os rejeitados saltam-se)
+            int got;
+            while ((got = stream_next(stream, &game_board, NULL, 0)) == 1) {}
+            if (got < 0) break;
+            game_board.pacmans[0].points = accumulated_points;
+        }
+        else if (!preloaded && load_level(&game_board, dir_path, namelist[i]->d_name, accumulated_points) != 0) {
             free(namelist[i]); continue;
         }
+        preloaded = 0;
 
         // --- INICIALIZAÇÃO ---
         
-        pthread_t p_thread;
-        pthread_t g_threads[MAX_GHOSTS];
-
-        // 1. Criar Threads
-        pthread_create(&p_thread, NULL, pacman_thread, &game_board);
-        for(int g=0; g < game_board.n_ghosts; g++) {
-            thread_arg_t* args = malloc(sizeof(thread_arg_t));
-            args->board = &game_board;
-            args->id = g;
-            pthread_create(&g_threads[g], NULL, ghost_thread, args);
-        }
+        pthread_t t_thread;
+
+        // Nível novo: os espectadores recebem um keyframe
+        spec_publish_reset(spectate_pub);
+
+        // 1. Criar a thread de jogo
+        pthread_create(&t_thread, NULL, tick_thread, &game_board);
 
         screen_refresh(&game_board, DRAW_MENU);
+        int dirty = 0; // Houve jogadas ou teclas desde o último desenho
 
         // --- LOOP PRINCIPAL (UI & INPUT) ---
-        while (game_board.game_running) {
-            
-            // 1. Desenhar
-            screen_refresh(&game_board, DRAW_MENU);
+        while (board_running(&game_board)) {
+
+            // 1. Esperar por uma tecla, uma jogada ou o próximo frame
+            int woke = ui_wait(&ui);
+            if (woke & (UI_EVENT | UI_INPUT)) dirty = 1;
+            if (!board_running(&game_board)) break;
+
+            // 2. Desenhar (no máximo um frame por UI_FRAME_MS)
+            if ((woke & UI_FRAME) && dirty) {
+                screen_refresh(&game_board, DRAW_MENU);
+                dirty = 0;
+            }
 
-            // 2. Ler Input
-            char input = get_input();
+            // 3. Ler Input (uma tecla por volta: se houver mais, o poll acorda logo outra vez)
+            char input = (woke & UI_INPUT) ? get_input() : '\0';
+            if (input == 'N') { toggle_minimap(); input = '\0'; }
+            if (input == 'B') {
+                atomic_fetch_add(&rewind_request, 1);
+                board_wake(&game_board);
+                input = '\0';
+            }
+
+            // Ficheiros gravados: o nível atual pode ter de recomeçar
+            if ((woke & UI_WATCH) && hot_reload(watch, &game_board, &fresh, &fresh_ready, dir_path,
+                                                accumulated_points, &namelist, &n, i)) {
+                board_finish(&game_board, GAME_RELOAD);
+                break;
+            }
             
-            // 3. Verificar Modo Automático
-            // Se n_moves > 0, estamos a ler ficheiro -> IGNORAR TECLADO
-            int is_auto_mode = (game_board.pacmans[0].n_moves > 0);
+            // 4. Verificar Modo Automático
+            // Se nenhum Pacman é de um jogador, estão todos a ler ficheiro -> IGNORAR TECLADO
+            int is_auto_mode = (board_players(&game_board) == 0);
 
             // =======================================================
             // LÓGICA DE SAVE (G) - FICHEIRO OU TECLADO (Condicional)
@@ -230,13 +508,15 @@ int main(int argc, char** argv) {
                 game_board.save_request = 0; // Limpar bandeira
 
                 // BLOQUEAR O PAI
-                lock_all_rows(&game_board);
+                freeze_board(&game_board);
+                stream_freeze(stream);
                 
                 pid_t pid = fork();
+                if (pid != 0) stream_thaw(stream);
 
                 if (pid < 0) {
                     perror("Erro fork");
-                    unlock_all_rows(&game_board);
+                    thaw_board(&game_board);
                 }
                 else if (pid > 0) {
                     // === PROCESSO PAI (Wait & Freeze) ===
@@ -253,13 +533,14 @@ int main(int argc, char** argv) {
                             // CASO 1: O Filho morreu e pediu RESTORE.
                             // O Pai deve continuar a jogar a partir daqui.
                             has_active_save = 0;
+                            spec_publish_reset(spectate_pub);
                             
                             // Forçar redesenho imediato para limpar lixo visual do filho
-                            clear(); 
-                            refresh();
+                            clear_screen();
+                            refresh_screen();
                             screen_refresh(&game_board, DRAW_MENU);
 
-                            unlock_all_rows(&game_board);
+                            thaw_board(&game_board);
                             continue; // Volta ao início do loop (Renasce no G)
                         }
                         else {
@@ -267,48 +548,34 @@ int main(int argc, char** argv) {
                             // Se o código não é RESTORE, o Pai também deve terminar.
                             // Isto impede que o Pai acorde quando o Filho ganha.
                             
-                            game_board.game_running = 0;
-                            
-                            // Se foi Game Over explícito, propagamos o status
-                            if (exit_code == EXIT_GAME_OVER) {
-                                game_board.exit_status = 3;
-                            } else {
-                                // Se foi 0 (Vitória do filho), saímos silenciosamente 
-                                // (o filho já mostrou as mensagens de vitória)
-                                game_board.exit_status = 3; 
-                            }
+                            // Game Over explícito (EXIT_GAME_OVER) ou vitória do filho (0):
+                            // saímos silenciosamente (o filho já mostrou as mensagens)
+                            board_finish(&game_board, GAME_QUIT);
                         }
                     }
                     else {
                         // Se o filho crashou ou foi morto, o Pai termina por segurança
-                        game_board.game_running = 0;
-                        game_board.exit_status = 3;
+                        board_finish(&game_board, GAME_QUIT);
                     }
                     
-                    unlock_all_rows(&game_board);
+                    thaw_board(&game_board);
                 }
                 else { // FILHO
-                    unlock_all_rows(&game_board);
+                    thaw_board(&game_board);
+                    stream_detach(stream);
                     has_active_save = 1;
-                    nodelay(stdscr, TRUE); keypad(stdscr, TRUE);
                     
-                    pthread_create(&p_thread, NULL, pacman_thread, &game_board);
-                    for(int g=0; g < game_board.n_ghosts; g++) {
-                        thread_arg_t* args = malloc(sizeof(thread_arg_t));
-                        args->board = &game_board;
-                        args->id = g;
-                        pthread_create(&g_threads[g], NULL, ghost_thread, args);
-                    }
+                    // Só a thread que fez fork existe no filho: recriar a thread de jogo
+                    // (e o sono dela, que podia estar a meio no pai)
+                    board_init_wake(&game_board);
+                    pthread_create(&t_thread, NULL, tick_thread, &game_board);
                 }
             }
             // =======================================================
             // LÓGICA DE QUIT (Q) - APENAS MODO MANUAL
             // =======================================================
             else if (!is_auto_mode && input == 'Q') {
-                lock_all_rows(&game_board);
-                game_board.exit_status = 3; 
-                game_board.game_running = 0;
-                unlock_all_rows(&game_board);
+                board_finish(&game_board, GAME_QUIT);
                 
                 if (has_active_save) exit(EXIT_GAME_OVER);
             } 
@@ -316,49 +583,64 @@ int main(int argc, char** argv) {
             // INPUT DE MOVIMENTO - APENAS MODO MANUAL
             // =======================================================
             else if (!is_auto_mode && input != '\0') {
-                game_board.next_pacman_cmd = input;
+                board_send_input(&game_board, input);
             }
-
-            sleep_ms(33); 
         }
 
         // --- FIM DO NÍVEL / JOGO ---
         
-        pthread_join(p_thread, NULL);
-        for(int g=0; g < game_board.n_ghosts; g++) {
-            pthread_join(g_threads[g], NULL);
-        }
+        pthread_join(t_thread, NULL);
         
-        int status = game_board.exit_status;
+        int status = atomic_load(&game_board.state);
+
+        // O nível gravado substitui o atual e recomeça com os pontos do início do nível
+        if (status == GAME_RELOAD && fresh_ready) {
+            unload_level(&game_board);
+            move_level(&game_board, &fresh);
+            fresh_ready = 0;
+            preloaded = 1;
+            clear_screen(); refresh_screen();
+            i--;
+            continue;
+        }
+        // O nível acabou antes de recomeçar
+        if (fresh_ready) {
+            unload_level(&fresh);
+            fresh_ready = 0;
+        }
 
         // SE SOU FILHO E MORRI -> AVISAR PAI
-        if (status == 2 && has_active_save) {
+        if (status == GAME_DEAD && has_active_save) {
             exit(EXIT_RESTORE);
         }
 
-        if (status == 1) { // VITÓRIA
+        if (status == GAME_WON) { // VITÓRIA
             screen_refresh(&game_board, DRAW_WIN);
             sleep_ms(1000);
-            accumulated_points = game_board.pacmans[0].points;
+            accumulated_points = board_points(&game_board);
             unload_level(&game_board);
-            free(namelist[i]);
-            clear(); refresh();
+            if (!stream) free(namelist[i]);
+            clear_screen(); refresh_screen();
         }
         else { 
             // DERROTA ou QUIT
-            if (status == 2) {
+            if (status == GAME_DEAD) {
                 screen_refresh(&game_board, DRAW_GAME_OVER);
                 sleep_ms(2000);
             }
             
             unload_level(&game_board);
-            free(namelist[i]);
+            if (!stream) free(namelist[i]);
             break; // Sai do loop de níveis
         }
     }
     
     // Limpeza final
     free(namelist);
+    stream_close(stream);
+    watch_close(watch);
+    spec_publish_close(spectate_pub);
+    ui_close(&ui);
     terminal_cleanup();
     close_debug_file();
     return 0;
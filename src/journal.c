@@ -0,0 +1,481 @@
+#include "journal.h"
+#include "files.h"
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Parte do estado de um agente que muda ao jogar
+typedef struct {
+    int32_t x, y;
+    int32_t pc, left, waiting;
+    uint32_t rng;
+    int32_t points;
+    uint32_t gen;         // Geração da vaga (fantasmas)
+    uint8_t alive, charged;
+    uint8_t active;       // Fantasma no tabuleiro (as vagas dos ninhos entram e saem)
+    uint8_t pad;
+} agent_state_t;
+
+typedef struct {
+    uint32_t id;          // Pacmans primeiro, depois fantasmas
+    agent_state_t before;
+} agent_rec_t;
+
+typedef struct {
+    uint32_t index;       // get_board_index
+    board_pos_t before;
+} cell_rec_t;
+
+typedef struct {
+    uint32_t size;        // Inclui este cabeçalho; múltiplo de 8
+    uint32_t n_cells, n_agents;
+    uint32_t pad;
+    int64_t tick;         // Jogada depois do registo
+    int64_t tick_before;  // Jogada a que o registo volta
+    uint64_t hash_before;
+} rec_t;  // Seguido de n_cells cell_rec_t e n_agents agent_rec_t
+
+struct journal {
+    int n_pacmans, n_agents, width;
+    agent_state_t* agents;  // [n_agents] Estado no último registo
+    board_pos_t* under;     // [n_agents] Casa debaixo de cada agente no último registo
+    long tick;              // Jogada do último registo (a do tabuleiro)
+    uint64_t hash;
+
+    // Casas com o valor de antes conhecido, refeita a cada registo
+    uint32_t* slot_index;   // UINT32_MAX = vazio
+    board_pos_t* slot_cell;
+    uint8_t* slot_done;     // Casa já vista neste registo
+    uint32_t slot_mask;
+
+    uint8_t* scratch;       // Registo a ser montado
+    size_t scratch_cap;
+
+    // Anel: registos contíguos, do mais antigo (first) ao mais recente
+    uint8_t* ring;
+    size_t capacity;
+    size_t* offs;           // [max_ticks] Posição de cada registo no anel
+    int max_ticks, first, count;
+    size_t end;             // Fim do registo mais recente
+    size_t used;
+};
+
+static void capture(const board_t* board, int id, agent_state_t* s) {
+    memset(s, 0, sizeof(*s));
+    if (id < board->n_pacmans) {
+        const pacman_t* pac = &board->pacmans[id];
+        s->x = pac->pos_x; s->y = pac->pos_y;
+        s->pc = pac->pc; s->left = pac->left; s->waiting = pac->waiting;
+        s->rng = pac->rng;
+        s->points = pac->points;
+        s->alive = (uint8_t)pac->alive;
+    }
+    else {
+        const ghost_t* ghost = &board->ghosts[id - board->n_pacmans];
+        s->x = ghost->pos_x; s->y = ghost->pos_y;
+        s->pc = ghost->pc; s->left = ghost->left; s->waiting = ghost->waiting;
+        s->rng = ghost->rng;
+        s->alive = 1;
+        s->charged = (uint8_t)ghost->charged;
+        s->active = (uint8_t)ghost->active;
+        s->gen = ghost->gen;
+    }
+}
+
+static void restore(board_t* board, int id, const agent_state_t* s) {
+    if (id < board->n_pacmans) {
+        pacman_t* pac = &board->pacmans[id];
+        pac->pos_x = s->x; pac->pos_y = s->y;
+        pac->pc = s->pc; pac->left = s->left; pac->waiting = s->waiting;
+        pac->rng = s->rng;
+        pac->points = s->points;
+        pac->alive = s->alive;
+    }
+    else {
+        ghost_t* ghost = &board->ghosts[id - board->n_pacmans];
+        ghost->pos_x = s->x; ghost->pos_y = s->y;
+        ghost->pc = s->pc; ghost->left = s->left; ghost->waiting = s->waiting;
+        ghost->rng = s->rng;
+        ghost->charged = s->charged;
+        ghost->active = s->active;
+        ghost->gen = s->gen;
+    }
+}
+
+static int same_cell(const board_pos_t* a, const board_pos_t* b) {
+    return a->content == b->content && a->has_dot == b->has_dot && a->has_portal == b->has_portal;
+}
+
+static void refresh_under(journal_t* j, const board_t* board) {
+    for (int i = 0; i < j->n_agents; i++) j->under[i] = *board_at(board, j->agents[i].x, j->agents[i].y);
+}
+
+static int take_state(journal_t* j, const board_t* board, long tick) {
+    for (int i = 0; i < j->n_agents; i++) capture(board, i, &j->agents[i]);
+    refresh_under(j, board);
+    j->tick = tick;
+    j->hash = board->hash;
+    j->first = j->count = 0;
+    j->end = j->used = 0;
+    return 0;
+}
+
+journal_t* journal_create(const board_t* board, long tick, int max_ticks, size_t max_bytes) {
+    journal_t* j = calloc(1, sizeof(journal_t));
+    if (!j) return NULL;
+    j->n_pacmans = board->n_pacmans;
+    j->n_agents = board->n_pacmans + board->n_ghosts;
+    j->width = board->width;
+    j->max_ticks = max_ticks > 0 ? max_ticks : JOURNAL_DEFAULT_TICKS;
+    j->capacity = max_bytes > 0 ? max_bytes : JOURNAL_DEFAULT_BYTES;
+
+    // Duas casas por agente no máximo (partida e chegada), com folga para a sondagem
+    uint32_t size = 1;
+    while (size < 4u * (j->n_agents + 1)) size <<= 1;
+    j->slot_mask = size - 1;
+
+    int n = j->n_agents ? j->n_agents : 1;
+    j->agents = malloc(sizeof(agent_state_t) * n);
+    j->under = malloc(sizeof(board_pos_t) * n);
+    j->slot_index = malloc(sizeof(uint32_t) * size);
+    j->slot_cell = malloc(sizeof(board_pos_t) * size);
+    j->slot_done = malloc(size);
+    j->ring = malloc(j->capacity);
+    j->offs = malloc(sizeof(size_t) * j->max_ticks);
+    if (!j->agents || !j->under || !j->slot_index || !j->slot_cell || !j->slot_done || !j->ring || !j->offs) {
+        journal_free(j);
+        return NULL;
+    }
+    take_state(j, board, tick);
+    return j;
+}
+
+void journal_free(journal_t* j) {
+    if (!j) return;
+    free(j->agents);
+    free(j->under);
+    free(j->slot_index);
+    free(j->slot_cell);
+    free(j->slot_done);
+    free(j->scratch);
+    free(j->ring);
+    free(j->offs);
+    free(j);
+}
+
+int journal_reset(journal_t* j, const board_t* board, long tick) {
+    if (board->n_pacmans + board->n_ghosts != j->n_agents || board->n_pacmans != j->n_pacmans ||
+        board->width != j->width) return -1;
+    return take_state(j, board, tick);
+}
+
+// Posição da casa na tabela (*found = já lá estava)
+static uint32_t slot_of(journal_t* j, uint32_t index, int* found) {
+    uint32_t i = (index * 0x9E3779B1u) & j->slot_mask;
+    while (j->slot_index[i] != UINT32_MAX && j->slot_index[i] != index) i = (i + 1) & j->slot_mask;
+    *found = j->slot_index[i] == index;
+    return i;
+}
+
+// Acrescenta a casa (x, y) ao registo se mudou; eaten = um Pacman comeu-lhe o ponto nesta jogada
+static void emit_cell(journal_t* j, const board_t* board, int x, int y, int eaten, uint8_t** out, uint32_t* n) {
+    uint32_t index = (uint32_t)get_board_index(board, x, y);
+    int found;
+    uint32_t s = slot_of(j, index, &found);
+    if (found && j->slot_done[s]) return;
+    const board_pos_t* now = board_at(board, x, y);
+    if (!found) {
+        // Sem agentes no fim do registo anterior: vazia, com o ponto se foi comido agora
+        j->slot_index[s] = index;
+        j->slot_cell[s] = *now;
+        j->slot_cell[s].content = ' ';
+        if (eaten) j->slot_cell[s].has_dot = 1;
+    }
+    j->slot_done[s] = 1;
+    if (same_cell(&j->slot_cell[s], now)) return;
+    cell_rec_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.index = index;
+    rec.before = j->slot_cell[s];
+    memcpy(*out, &rec, sizeof(rec));
+    *out += sizeof(rec);
+    (*n)++;
+}
+
+static void drop_oldest(journal_t* j) {
+    j->used -= ((const rec_t*)(j->ring + j->offs[j->first]))->size;
+    j->first = (j->first + 1) % j->max_ticks;
+    j->count--;
+}
+
+// Tira os registos mais antigos até haver size bytes contíguos; devolve a posição
+static size_t ring_reserve(journal_t* j, size_t size) {
+    if (j->count == j->max_ticks) drop_oldest(j);
+    if (j->count == 0) j->end = 0;
+    size_t pos = j->end;
+    if (pos + size > j->capacity) {
+        // Recomeça no início: os registos entre end e o fim do anel são os mais antigos
+        while (j->count > 0 && j->offs[j->first] >= j->end) drop_oldest(j);
+        pos = 0;
+    }
+    while (j->count > 0) {
+        size_t o = j->offs[j->first];
+        if (o >= pos + size || o + ((const rec_t*)(j->ring + o))->size <= pos) break;
+        drop_oldest(j);
+    }
+    return pos;
+}
+
+int journal_record(journal_t* j, const board_t* board, long tick) {
+    // Pior caso: todos os agentes mudaram e cada um mexeu em duas casas
+    size_t max = sizeof(rec_t) + (size_t)j->n_agents * (sizeof(agent_rec_t) + 2 * sizeof(cell_rec_t));
+    if (max > j->scratch_cap) {
+        uint8_t* s = realloc(j->scratch, max);
+        if (!s) return -1;
+        j->scratch = s;
+        j->scratch_cap = max;
+    }
+
+    // Agentes que mudaram, com o estado de antes (ficam no fim do registo; as casas vêm primeiro)
+    uint8_t* agents_out = j->scratch + sizeof(rec_t) + (size_t)j->n_agents * 2 * sizeof(cell_rec_t);
+    uint32_t n_agents = 0;
+    for (int i = 0; i < j->n_agents; i++) {
+        agent_state_t now;
+        capture(board, i, &now);
+        if (memcmp(&now, &j->agents[i], sizeof(now)) == 0) continue;
+        agent_rec_t rec = { (uint32_t)i, j->agents[i] };
+        memcpy(agents_out + n_agents * sizeof(rec), &rec, sizeof(rec));
+        n_agents++;
+    }
+
+    // As casas de antes conhecidas: as que estavam debaixo de algum agente
+    memset(j->slot_index, 0xff, sizeof(uint32_t) * (j->slot_mask + 1));
+    memset(j->slot_done, 0, j->slot_mask + 1);
+    for (int i = 0; i < j->n_agents; i++) {
+        int found;
+        uint32_t index = (uint32_t)get_board_index(board, j->agents[i].x, j->agents[i].y);
+        uint32_t s = slot_of(j, index, &found);
+        j->slot_index[s] = index;
+        j->slot_cell[s] = j->under[i];
+    }
+
+    // Casas de partida e de chegada; primeiro as dos pontos comidos
+    uint8_t* out = j->scratch + sizeof(rec_t);
+    uint32_t n_cells = 0;
+    for (uint32_t k = 0; k < n_agents; k++) {
+        const agent_rec_t* a = (const agent_rec_t*)(agents_out + k * sizeof(agent_rec_t));
+        if ((int)a->id >= j->n_pacmans) break;
+        const pacman_t* pac = &board->pacmans[a->id];
+        if (pac->points > a->before.points) emit_cell(j, board, pac->pos_x, pac->pos_y, 1, &out, &n_cells);
+    }
+    for (uint32_t k = 0; k < n_agents; k++) {
+        const agent_rec_t* a = (const agent_rec_t*)(agents_out + k * sizeof(agent_rec_t));
+        agent_state_t now;
+        capture(board, a->id, &now);
+        emit_cell(j, board, a->before.x, a->before.y, 0, &out, &n_cells);
+        emit_cell(j, board, now.x, now.y, 0, &out, &n_cells);
+        j->agents[a->id] = now;
+    }
+    refresh_under(j, board);
+
+    memmove(out, agents_out, n_agents * sizeof(agent_rec_t));
+    out += n_agents * sizeof(agent_rec_t);
+    size_t size = ((size_t)(out - j->scratch) + 7) & ~(size_t)7;
+    rec_t hdr = { (uint32_t)size, n_cells, n_agents, 0, tick, j->tick, j->hash };
+    memcpy(j->scratch, &hdr, sizeof(hdr));
+    j->tick = tick;
+    j->hash = board->hash;
+
+    if (size > j->capacity) {
+        j->first = j->count = 0;
+        j->end = j->used = 0;
+        return -1;
+    }
+    size_t pos = ring_reserve(j, size);
+    memcpy(j->ring + pos, j->scratch, size);
+    j->offs[(j->first + j->count) % j->max_ticks] = pos;
+    j->count++;
+    j->end = pos + size;
+    j->used += size;
+    return 0;
+}
+
+long journal_rewind(journal_t* j, board_t* board, long tick) {
+    if (j->count == 0 || j->tick <= tick) return j->tick;
+    while (j->count > 0 && j->tick > tick) {
+        size_t pos = j->offs[(j->first + j->count - 1) % j->max_ticks];
+        const rec_t* rec = (const rec_t*)(j->ring + pos);
+        const cell_rec_t* cells = (const cell_rec_t*)(rec + 1);
+        const agent_rec_t* agents = (const agent_rec_t*)(cells + rec->n_cells);
+        for (uint32_t k = 0; k < rec->n_cells; k++) {
+            *board_at_mut(board, cells[k].index % j->width, cells[k].index / j->width) = cells[k].before;
+        }
+        for (uint32_t k = 0; k < rec->n_agents; k++) {
+            restore(board, agents[k].id, &agents[k].before);
+            j->agents[agents[k].id] = agents[k].before;
+        }
+        board->hash = rec->hash_before;
+        j->hash = rec->hash_before;
+        j->tick = rec->tick_before;
+        j->used -= rec->size;
+        j->end = pos;
+        j->count--;
+    }
+    board_rebuild_slots(board); // As vagas livres vêm das flags repostas
+    refresh_under(j, board);
+    return j->tick;
+}
+
+long journal_oldest(const journal_t* j) {
+    if (j->count == 0) return j->tick;
+    return ((const rec_t*)(j->ring + j->offs[j->first]))->tick_before;
+}
+
+long journal_tick(const journal_t* j) {
+    return j->tick;
+}
+
+size_t journal_bytes(const journal_t* j) {
+    return j->used;
+}
+
+// ==================================================================
+// MODO --rewind
+// ==================================================================
+static double elapsed(const struct timespec* t0, const struct timespec* t1) {
+    return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+// Casas e estado dos agentes iguais (o que sim_step lê e escreve)
+static int same_board(const board_t* a, const board_t* b) {
+    for (int y = 0; y < a->height; y++) {
+        for (int x = 0; x < a->width; x++) {
+            if (!same_cell(board_at(a, x, y), board_at(b, x, y))) return 0;
+        }
+    }
+    for (int i = 0; i < a->n_pacmans + a->n_ghosts; i++) {
+        agent_state_t sa, sb;
+        capture(a, i, &sa);
+        capture(b, i, &sb);
+        if (memcmp(&sa, &sb, sizeof(sa)) != 0) return 0;
+    }
+    return a->hash == b->hash;
+}
+
+// Joga até 'end' a partir da jogada do jornal; as jogadas refeitas têm de dar os mesmos hashes
+static int replay(journal_t* j, board_t* board, const uint64_t* hashes, long end) {
+    for (long t = journal_tick(j); t < end; t++) {
+        sim_step(board);
+        journal_record(j, board, t + 1);
+        if (board->hash != hashes[t + 1]) return 0;
+    }
+    return 1;
+}
+
+static int verify_level(const board_t* level, const char* name, int max_ticks, int depth) {
+    board_t board, snap;
+    memset(&board, 0, sizeof(board));
+    memset(&snap, 0, sizeof(snap));
+    uint64_t* hashes = malloc(sizeof(uint64_t) * ((size_t)max_ticks + 1));
+    journal_t* j = NULL;
+    if (!hashes || board_clone(&board, level) != 0 || !(j = journal_create(&board, 0, depth, 0))) {
+        printf("%s: sem memória\n", name);
+        free(hashes);
+        board_free_clone(&board);
+        return -1;
+    }
+
+    // Uma cópia completa a meio do histórico para comparar casa a casa
+    long snap_tick = (max_ticks < depth ? max_ticks : depth) / 2;
+    int have_snap = 0;
+    double clone_s = 0, record_s = 0, rewind_s = 0;
+    long rewound = 0;
+    struct timespec t0, t1;
+
+    hashes[0] = board.hash;
+    long end = 0;
+    int outcome = SIM_RUNNING;
+    while (end < max_ticks && outcome == SIM_RUNNING) {
+        outcome = sim_step(&board);
+        end++;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        journal_record(j, &board, end);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        record_s += elapsed(&t0, &t1);
+        hashes[end] = board.hash;
+        if (end == snap_tick) {
+            board_clone(&snap, &board);
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            clone_s = elapsed(&t1, &t0);
+            have_snap = 1;
+        }
+    }
+    size_t bytes = journal_bytes(j);
+    long oldest = journal_oldest(j);
+
+    int ok = 1;
+    if (have_snap && snap_tick >= oldest) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        long at = journal_rewind(j, &board, snap_tick);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        rewind_s += elapsed(&t0, &t1);
+        rewound += end - at;
+        ok = at == snap_tick && same_board(&board, &snap) && board_hash_full(&board) == board.hash;
+        ok = ok && replay(j, &board, hashes, end);
+    }
+    for (int k = 0; k < 16 && ok && end > 0; k++) {
+        long from = journal_oldest(j);
+        long target = from + rand() % (end - from + 1);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        long at = journal_rewind(j, &board, target);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        rewind_s += elapsed(&t0, &t1);
+        rewound += end - at;
+        ok = at == target && board.hash == hashes[at] && board_hash_full(&board) == board.hash;
+        ok = ok && replay(j, &board, hashes, end);
+    }
+
+    printf("%s: %ld jogadas (%s), histórico desde a jogada %ld (%.1f KB), estados %s\n",
+           name, end, sim_outcome_name(outcome == SIM_RUNNING ? SIM_TIMEOUT : outcome), oldest,
+           bytes / 1024.0, ok ? "iguais" : "DIFERENTES");
+    printf("  %.2f us/jogada a registar, %.2f us/jogada a voltar atrás, board_clone %.1f us\n",
+           end ? record_s * 1e6 / end : 0, rewound ? rewind_s * 1e6 / rewound : 0, clone_s * 1e6);
+
+    journal_free(j);
+    free(hashes);
+    board_free_clone(&board);
+    board_free_clone(&snap);
+    return ok ? 0 : -1;
+}
+
+int journal_main(int argc, char** argv) {
+    if (argc < 2) { printf("Usage: %s <dir> [ticks] [depth]\n", argv[0]); return 1; }
+    const char* dir_path = argv[1];
+    int max_ticks = argc > 2 ? atoi(argv[2]) : 2000;
+    int depth = argc > 3 ? atoi(argv[3]) : JOURNAL_DEFAULT_TICKS;
+    if (max_ticks <= 0) max_ticks = 2000;
+    if (depth <= 0) depth = JOURNAL_DEFAULT_TICKS;
+
+    struct dirent** namelist;
+    int n = scandir(dir_path, &namelist, filter_levels, alphasort);
+    if (n < 0) { perror("scandir"); return 1; }
+    srand(time(NULL));
+
+    int failed = 0;
+    for (int i = 0; i < n; i++) {
+        board_t level;
+        memset(&level, 0, sizeof(level));
+        if (load_level(&level, dir_path, namelist[i]->d_name, 0) == 0) {
+            failed |= verify_level(&level, namelist[i]->d_name, max_ticks, depth) != 0;
+            unload_level(&level);
+        }
+        else {
+            printf("%s: nível rejeitado\n", namelist[i]->d_name);
+        }
+        free(namelist[i]);
+    }
+    free(namelist);
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,180 @@
+#include "montecarlo.h"
+#include "files.h"
+#include "pool.h"
+#include "sim.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MC_DEFAULT_RUNS 10000
+#define MC_DEFAULT_MAX_TICKS 5000
+
+typedef struct {
+    const board_t* level;
+    int runs;
+    int max_ticks;
+    uint32_t seed;
+    int n_chunks;
+    sim_result_t* results; // Um resultado por corrida
+    atomic_int failed;     // Corridas sem clone (sem memória): a estimativa não vale
+} mc_job_t;
+
+// Cada bloco de corridas reutiliza o mesmo clone: só a primeira cópia aloca
+static void mc_chunk(void* ctx, int chunk) {
+    mc_job_t* job = (mc_job_t*)ctx;
+    int first = (int)((long)job->runs * chunk / job->n_chunks);
+    int last = (int)((long)job->runs * (chunk + 1) / job->n_chunks);
+
+    board_t clone;
+    memset(&clone, 0, sizeof(clone));
+    for (int r = first; r < last; r++) {
+        if (board_clone(&clone, job->level) != 0) {
+            atomic_fetch_add(&job->failed, 1);
+            continue;
+        }
+        board_seed(&clone, job->seed + (uint32_t)r);
+        sim_run(&clone, job->max_ticks, &job->results[r]);
+    }
+    board_free_clone(&clone);
+}
+
+static int cmp_int(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static int collect_stats(const sim_result_t* results, int runs, mc_stats_t* stats) {
+    int* ticks = malloc(sizeof(int) * runs);
+    int* points = malloc(sizeof(int) * runs);
+    if (!ticks || !points) { free(ticks); free(points); return -1; }
+    int n_wins = 0;
+    long ticks_sum = 0, points_sum = 0;
+
+    for (int r = 0; r < runs; r++) {
+        switch (results[r].outcome) {
+            case SIM_WIN:   stats->wins++; ticks[n_wins++] = results[r].ticks; ticks_sum += results[r].ticks; break;
+            case SIM_DEATH: stats->deaths++; break;
+            case SIM_QUIT:  stats->quits++; break;
+            default:        stats->timeouts++; break;
+        }
+        points[r] = results[r].points;
+        points_sum += results[r].points;
+    }
+
+    qsort(points, runs, sizeof(int), cmp_int);
+    stats->points_min = points[0];
+    stats->points_p50 = points[runs / 2];
+    stats->points_max = points[runs - 1];
+    stats->points_mean = (double)points_sum / runs;
+
+    if (n_wins > 0) {
+        qsort(ticks, n_wins, sizeof(int), cmp_int);
+        stats->ticks_min = ticks[0];
+        stats->ticks_p50 = ticks[n_wins / 2];
+        stats->ticks_p90 = ticks[(n_wins * 9) / 10];
+        stats->ticks_max = ticks[n_wins - 1];
+        stats->ticks_mean = (double)ticks_sum / n_wins;
+
+        int span = stats->ticks_max - stats->ticks_min + 1;
+        for (int i = 0; i < n_wins; i++) {
+            int bin = (int)((long)(ticks[i] - stats->ticks_min) * MC_HIST_BINS / span);
+            stats->hist[bin]++;
+        }
+    }
+    free(ticks);
+    free(points);
+    return 0;
+}
+
+int montecarlo_estimate(const board_t* level, int runs, int max_ticks, uint32_t seed,
+                        int n_threads, mc_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (runs <= 0) return -1;
+    stats->runs = runs;
+    stats->max_ticks = max_ticks;
+
+    pool_t* pool = pool_create(n_threads);
+    if (!pool) return -1;
+    mc_job_t job = { level, runs, max_ticks, seed, pool_size(pool), calloc(runs, sizeof(sim_result_t)), 0 };
+    if (!job.results) { pool_destroy(pool); return -1; }
+    if (job.n_chunks > runs) job.n_chunks = runs;
+
+    pool_parallel_for(pool, job.n_chunks, mc_chunk, &job);
+    pool_destroy(pool);
+
+    // Uma corrida que falhou não pode contar como desfecho nenhum
+    int rc = atomic_load(&job.failed) ? -1 : collect_stats(job.results, runs, stats);
+    free(job.results);
+    return rc;
+}
+
+void print_mc_stats(FILE* out, const char* level_name, const mc_stats_t* stats) {
+    double n = stats->runs;
+    fprintf(out, "=== %s: %d corridas (máx. %d jogadas) ===\n", level_name, stats->runs, stats->max_ticks);
+    fprintf(out, "  vitória %.2f%% | morte %.2f%% | quit %.2f%% | timeout %.2f%%\n",
+            100.0 * stats->wins / n, 100.0 * stats->deaths / n,
+            100.0 * stats->quits / n, 100.0 * stats->timeouts / n);
+    fprintf(out, "  pontos: min %d | mediana %d | média %.1f | máx %d\n",
+            stats->points_min, stats->points_p50, stats->points_mean, stats->points_max);
+    if (stats->wins == 0) return;
+
+    fprintf(out, "  jogadas até ao portal: min %d | mediana %d | p90 %d | média %.1f | máx %d\n",
+            stats->ticks_min, stats->ticks_p50, stats->ticks_p90, stats->ticks_mean, stats->ticks_max);
+    int span = stats->ticks_max - stats->ticks_min + 1;
+    for (int b = 0; b < MC_HIST_BINS; b++) {
+        int lo = stats->ticks_min + (int)((long)span * b / MC_HIST_BINS);
+        int hi = stats->ticks_min + (int)((long)span * (b + 1) / MC_HIST_BINS) - 1;
+        if (hi < lo) continue;
+        int bar = (int)(50.0 * stats->hist[b] / stats->wins);
+        fprintf(out, "  %6d-%-6d %6d ", lo, hi, stats->hist[b]);
+        for (int i = 0; i < bar; i++) fputc('#', out);
+        fputc('\n', out);
+    }
+}
+
+int montecarlo_main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s <dir> [runs] [max_ticks] [threads]\n", argv[0]);
+        return 1;
+    }
+    const char* dir_path = argv[1];
+    int runs = (argc >= 3) ? atoi(argv[2]) : MC_DEFAULT_RUNS;
+    int max_ticks = (argc >= 4) ? atoi(argv[3]) : MC_DEFAULT_MAX_TICKS;
+    int n_threads = (argc >= 5) ? atoi(argv[4]) : pool_default_threads();
+
+    struct dirent** namelist;
+    int n = scandir(dir_path, &namelist, filter_levels, alphasort);
+    if (n < 0) { perror("scandir"); return 1; }
+
+    srand(time(NULL));
+    uint32_t seed = (uint32_t)rand();
+    for (int i = 0; i < n; i++) {
+        board_t level;
+        memset(&level, 0, sizeof(level));
+        if (load_level(&level, dir_path, namelist[i]->d_name, 0) == 0) {
+            mc_stats_t stats;
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            int rc = montecarlo_estimate(&level, runs, max_ticks, seed, n_threads, &stats);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+
+            if (rc == 0) {
+                print_mc_stats(stdout, namelist[i]->d_name, &stats);
+                double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+                printf("  %.3f s (%.0f corridas/s, %d threads)\n", secs, runs / secs, n_threads);
+            }
+            else {
+                printf("=== %s: sem memória para as corridas ===\n", namelist[i]->d_name);
+            }
+            unload_level(&level);
+        }
+        else {
+            printf("=== %s: nível rejeitado ===\n", namelist[i]->d_name);
+        }
+        free(namelist[i]);
+    }
+    free(namelist);
+    return 0;
+}
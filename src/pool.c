@@ -0,0 +1,119 @@
+#include "pool.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+struct pool {
+    pthread_t* threads;
+    int n_workers;              // threads criadas (sem contar quem chama)
+    int shutdown;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;     // acorda os trabalhadores quando há trabalho novo
+    pthread_cond_t done_cv;     // acorda quem chamou quando todos acabaram
+    unsigned long generation;   // incrementado a cada parallel_for
+    int active;                 // trabalhadores ainda no trabalho atual
+
+    // Trabalho atual
+    pool_task_fn fn;
+    void* ctx;
+    int n_tasks;
+    atomic_int next;
+};
+
+// Cada thread vai buscando índices até se esgotarem
+static void run_tasks(pool_t* pool) {
+    for (;;) {
+        int i = atomic_fetch_add(&pool->next, 1);
+        if (i >= pool->n_tasks) break;
+        pool->fn(pool->ctx, i);
+    }
+}
+
+static void* pool_worker(void* arg) {
+    pool_t* pool = (pool_t*)arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->shutdown)
+            pthread_cond_wait(&pool->work_cv, &pool->lock);
+        if (pool->shutdown) break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_tasks(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) pthread_cond_signal(&pool->done_cv);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+pool_t* pool_create(int n_threads) {
+    pool_t* pool = calloc(1, sizeof(pool_t));
+    if (!pool) return NULL;
+    if (n_threads < 1) n_threads = 1;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cv, NULL);
+    pthread_cond_init(&pool->done_cv, NULL);
+    atomic_init(&pool->next, 0);
+
+    pool->threads = malloc(sizeof(pthread_t) * n_threads);
+    for (int i = 0; i < n_threads - 1; i++) {
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, pool) != 0) break;
+        pool->n_workers++;
+    }
+    return pool;
+}
+
+void pool_parallel_for(pool_t* pool, int n, pool_task_fn fn, void* ctx) {
+    if (n <= 0) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->n_tasks = n;
+    atomic_store(&pool->next, 0);
+    pool->active = pool->n_workers;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_tasks(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0)
+        pthread_cond_wait(&pool->done_cv, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int pool_size(const pool_t* pool) {
+    return pool->n_workers + 1;
+}
+
+void pool_destroy(pool_t* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->n_workers; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_cv);
+    pthread_cond_destroy(&pool->done_cv);
+    free(pool->threads);
+    free(pool);
+}
+
+int pool_default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int)n : 1;
+}
@@ -0,0 +1,83 @@
+#include "script.h"
+#include <stdio.h>
+#include <string.h>
+
+script_op_t script_move(char direction) {
+    script_op_t op = { .op = OP_MOVE, .direction = direction, .count = 1 };
+    switch (direction) {
+        case 'W': op.dy = -1; break;
+        case 'S': op.dy = 1;  break;
+        case 'A': op.dx = -1; break;
+        case 'D': op.dx = 1;  break;
+        default:  op.op = OP_WAIT; op.direction = 0; break;
+    }
+    return op;
+}
+
+script_op_t script_random(void) {
+    return (script_op_t){ .op = OP_RANDOM, .count = 1 };
+}
+
+static int is_direction(char c) {
+    return c == 'W' || c == 'A' || c == 'S' || c == 'D';
+}
+
+int script_compile(const command_t* src, int n, int is_ghost, script_op_t* code, char* err, size_t err_len) {
+    int n_code = 0;
+    for (int i = 0; i < n; i++) {
+        char c = src[i].command;
+        const char* valid = is_ghost ? "WASDRCTX" : "WASDRTGQ";
+        if (c == '\0' || !strchr(valid, c)) {
+            if (is_ghost && (c == 'G' || c == 'Q'))
+                snprintf(err, err_len, "comando %d ('%c') só existe para o Pacman", i + 1, c);
+            else if (!is_ghost && (c == 'C' || c == 'X'))
+                snprintf(err, err_len, "comando %d ('%c') só existe para os fantasmas", i + 1, c);
+            else
+                snprintf(err, err_len, "comando %d ('%c') desconhecido", i + 1, c);
+            return -1;
+        }
+
+        script_op_t* op = &code[n_code];
+        if (is_direction(c)) {
+            *op = script_move(c);
+        }
+        else if (c == 'R') {
+            *op = script_random();
+        }
+        else if (c == 'T') {
+            if (src[i].turns <= 0) {
+                snprintf(err, err_len, "comando %d ('T%d') tem de esperar pelo menos uma volta",
+                         i + 1, src[i].turns);
+                return -1;
+            }
+            // 'T' seguidos somam-se numa só espera (enquanto o contador couber em 32 bits)
+            script_op_t* prev = n_code > 0 ? &code[n_code - 1] : NULL;
+            if (prev && prev->op == OP_WAIT && prev->count <= INT32_MAX - src[i].turns) {
+                prev->count += src[i].turns;
+                continue;
+            }
+            *op = (script_op_t){ .op = OP_WAIT, .count = src[i].turns };
+        }
+        else if (c == 'C') {
+            // Carga seguida de movimento: uma instrução de duas jogadas
+            char next = i + 1 < n ? src[i + 1].command : '\0';
+            if (is_direction(next) || next == 'R') {
+                *op = is_direction(next) ? script_move(next) : script_random();
+                op->charge = 1;
+                op->count = 2;
+                i++;
+            }
+            else {
+                *op = (script_op_t){ .op = OP_CHARGE, .count = 1 };
+            }
+        }
+        else if (c == 'X') {
+            *op = (script_op_t){ .op = OP_DESPAWN, .count = 1 };
+        }
+        else {
+            *op = (script_op_t){ .op = c == 'G' ? OP_SAVE : OP_QUIT, .count = 1 };
+        }
+        n_code++;
+    }
+    return n_code;
+}
@@ -0,0 +1,527 @@
+#include "server.h"
+#include "board.h"
+#include "display.h"
+#include "files.h"
+#include "pool.h"
+#include "sim.h"
+#include "tick.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+
+#define SERVER_RESOLUTION_MS 10 // Período do timerfd (granularidade das jogadas)
+#define SERVER_MAX_EVENTS 64
+#define SERVER_BACKLOG 128
+
+typedef struct {
+    int fd;
+    board_t board;
+    tick_engine_t engine;
+    board_t save;        // Quicksave ('G'): cópia do tabuleiro, reposta quando morrem todos
+    int has_save;
+    int level;           // Índice do nível atual
+    long ticks;          // Jogadas desde o início da sessão
+    long next_tick;      // Instante (ms) da próxima jogada
+    int status;          // sim_outcome_t da última jogada
+    int closing;         // Último frame já gerado: fechar quando o buffer esvaziar
+    char* out;           // Frame por enviar
+    size_t out_len, out_sent, out_cap;
+    int want_out;        // EPOLLOUT registado
+} session_t;
+
+typedef struct {
+    board_t* levels;     // Níveis carregados uma vez; as sessões jogam clones
+    int n_levels;
+    session_t** sessions;
+    int n_sessions, cap_sessions;
+    session_t** due;     // Sessões a avançar nesta volta do timer
+    int n_due;
+    pool_t* pool;
+    int epfd, listen_fd, timer_fd, signal_fd;
+    long now;
+    _Atomic uint32_t seed; // Sessões que passam de nível na mesma volta tiram sementes em paralelo
+} server_t;
+
+static long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return (flags < 0) ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static inline int tick_period(const board_t* board) {
+    return (board->tempo > 0) ? board->tempo : 100;
+}
+
+// ==================================================================
+// SESSÕES
+// ==================================================================
+static int session_start_level(server_t* server, session_t* ss, int level, int points) {
+    if (board_clone(&ss->board, &server->levels[level]) != 0) return -1;
+    board_seed(&ss->board, atomic_fetch_add(&server->seed, 1));
+    ss->board.pacmans[0].points = points;
+
+    // O número de agentes muda de nível para nível
+    if (ss->engine.intents) tick_engine_free(&ss->engine);
+    if (tick_engine_init(&ss->engine, &ss->board, 1) != 0) return -1;
+    ss->level = level;
+    ss->has_save = 0;
+    return 0;
+}
+
+// Escreve o frame da jogada atual no buffer de saída
+static int render_frame(session_t* ss) {
+    board_t* b = &ss->board;
+    size_t need = 96 + (size_t)b->height * (b->width + 1);
+    if (need > ss->out_cap) {
+        char* out = realloc(ss->out, need);
+        if (!out) return -1;
+        ss->out = out;
+        ss->out_cap = need;
+    }
+
+    int n = snprintf(ss->out, ss->out_cap, "F %ld %d %d %d %s\n", ss->ticks, b->width, b->height,
+                     board_points(b), sim_outcome_name(ss->status));
+    char* row = ss->out + n;
+    for (int y = 0; y < b->height; y++) {
+        for (int x = 0; x < b->width; x++) {
+            const board_pos_t* cell = board_at(b, x, y);
+            char c = ' ';
+            if (cell->content == 'W') c = '#';
+            else if (cell->content == 'P') c = 'C';
+            else if (cell->content == 'M') c = 'M';
+            else if (cell->has_portal) c = '@';
+            else if (cell->has_dot) c = '.';
+            *row++ = c;
+        }
+        *row++ = '\n';
+    }
+    ss->out_len = row - ss->out;
+    ss->out_sent = 0;
+    return 0;
+}
+
+// Uma jogada de uma sessão (corre num trabalhador do pool)
+static void session_step(void* ctx, int i) {
+    server_t* server = (server_t*)ctx;
+    session_t* ss = server->due[i];
+    board_t* b = &ss->board;
+
+    int outcome = tick_step(&ss->engine);
+    ss->ticks++;
+
+    if (b->save_request) {
+        b->save_request = 0;
+        tick_sync(&ss->engine); // O save leva os agentes a dormir já em dia
+        if (!ss->has_save && board_clone(&ss->save, b) == 0) ss->has_save = 1;
+    }
+    if (outcome == SIM_DEATH && ss->has_save) {
+        // Como o filho do fork no jogo: renasce no último save (sem memória para o
+        // repor, a morte fica)
+        if (board_clone(b, &ss->save) == 0) {
+            tick_reschedule(&ss->engine);
+            outcome = SIM_RUNNING;
+        }
+        ss->has_save = 0;
+    }
+    if (outcome == SIM_WIN && ss->level + 1 < server->n_levels &&
+        session_start_level(server, ss, ss->level + 1, board_points(b)) == 0) {
+        outcome = SIM_RUNNING;
+    }
+    ss->status = outcome;
+
+    // Jogadas em que ninguém age são saltadas (até um segundo, para o cliente ver frames)
+    long idle = (outcome == SIM_RUNNING) ? tick_idle(&ss->engine) : 0;
+    long max_skip = 1000 / tick_period(b);
+    if (idle < 0 || idle > max_skip) idle = max_skip;
+    tick_skip(&ss->engine, idle);
+    ss->ticks += idle;
+
+    // Uma sessão atrasada não tenta recuperar as jogadas perdidas de rajada
+    ss->next_tick += tick_period(b) * (idle + 1);
+    if (ss->next_tick < server->now) ss->next_tick = server->now + tick_period(b);
+
+    // Cliente lento: ainda tem o frame anterior por enviar, perde este
+    if (ss->out_sent == ss->out_len || outcome != SIM_RUNNING) render_frame(ss);
+}
+
+static session_t* session_create(server_t* server, int fd) {
+    session_t* ss = calloc(1, sizeof(session_t));
+    if (!ss) return NULL;
+    ss->fd = fd;
+    pthread_mutex_init(&ss->board.board_lock, NULL);
+    if (session_start_level(server, ss, 0, 0) != 0) {
+        board_free_clone(&ss->board);
+        pthread_mutex_destroy(&ss->board.board_lock);
+        free(ss);
+        return NULL;
+    }
+    ss->status = SIM_RUNNING;
+    ss->next_tick = server->now + tick_period(&ss->board);
+    return ss;
+}
+
+static void session_close(server_t* server, session_t* ss) {
+    epoll_ctl(server->epfd, EPOLL_CTL_DEL, ss->fd, NULL);
+    close(ss->fd);
+    for (int i = 0; i < server->n_sessions; i++) {
+        if (server->sessions[i] == ss) {
+            server->sessions[i] = server->sessions[--server->n_sessions];
+            break;
+        }
+    }
+    tick_engine_free(&ss->engine);
+    board_free_clone(&ss->board);
+    board_free_clone(&ss->save);
+    pthread_mutex_destroy(&ss->board.board_lock);
+    free(ss->out);
+    free(ss);
+}
+
+static void set_want_out(server_t* server, session_t* ss, int want) {
+    if (ss->want_out == want) return;
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP | (want ? EPOLLOUT : 0), .data.ptr = ss };
+    epoll_ctl(server->epfd, EPOLL_CTL_MOD, ss->fd, &ev);
+    ss->want_out = want;
+}
+
+// Envia o que couber; devolve -1 se a ligação deve fechar
+static int session_flush(server_t* server, session_t* ss) {
+    while (ss->out_sent < ss->out_len) {
+        ssize_t n = send(ss->fd, ss->out + ss->out_sent, ss->out_len - ss->out_sent, MSG_NOSIGNAL);
+        if (n > 0) { ss->out_sent += n; continue; }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            set_want_out(server, ss, 1);
+            return 0;
+        }
+        return -1;
+    }
+    set_want_out(server, ss, 0);
+    return ss->closing ? -1 : 0;
+}
+
+static void session_input(server_t* server, session_t* ss) {
+    char buf[256];
+    for (;;) {
+        ssize_t n = read(ss->fd, buf, sizeof(buf));
+        if (n == 0) { session_close(server, ss); return; }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            session_close(server, ss);
+            return;
+        }
+        if (ss->closing) continue;
+
+        for (ssize_t i = 0; i < n; i++) {
+            char c = (char)toupper((unsigned char)buf[i]);
+            if (c == 'Q') {
+                ss->status = SIM_QUIT;
+                ss->closing = 1;
+                render_frame(ss);
+                if (session_flush(server, ss) != 0) session_close(server, ss);
+                return;
+            }
+            if (c == 'G') ss->board.save_request = 1;
+            else board_send_input(&ss->board, c);
+        }
+    }
+}
+
+static void server_accept(server_t* server) {
+    for (;;) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return; // EAGAIN: não há mais ligações pendentes
+        }
+        set_nonblocking(fd);
+
+        if (server->n_sessions == server->cap_sessions) {
+            int cap = server->cap_sessions ? server->cap_sessions * 2 : 64;
+            session_t** s = realloc(server->sessions, cap * sizeof(session_t*));
+            session_t** d = realloc(server->due, cap * sizeof(session_t*));
+            if (s) server->sessions = s;
+            if (d) server->due = d;
+            if (!s || !d) { close(fd); continue; }
+            server->cap_sessions = cap;
+        }
+        session_t* ss = session_create(server, fd);
+        if (!ss) { close(fd); continue; }
+
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = ss };
+        if (epoll_ctl(server->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            tick_engine_free(&ss->engine);
+            board_free_clone(&ss->board);
+            free(ss);
+            continue;
+        }
+        server->sessions[server->n_sessions++] = ss;
+
+        // Primeiro frame logo à entrada
+        render_frame(ss);
+        if (session_flush(server, ss) != 0) session_close(server, ss);
+    }
+}
+
+// O timer acordou: avançar em paralelo todas as sessões cuja jogada venceu
+static void server_tick(server_t* server) {
+    uint64_t expirations;
+    if (read(server->timer_fd, &expirations, sizeof(expirations)) < 0) return;
+
+    server->now = now_ms();
+    server->n_due = 0;
+    for (int i = 0; i < server->n_sessions; i++) {
+        session_t* ss = server->sessions[i];
+        if (!ss->closing && ss->next_tick <= server->now) server->due[server->n_due++] = ss;
+    }
+    if (server->n_due == 0) return;
+
+    pool_parallel_for(server->pool, server->n_due, session_step, server);
+
+    for (int i = 0; i < server->n_due; i++) {
+        session_t* ss = server->due[i];
+        if (ss->status != SIM_RUNNING) ss->closing = 1;
+        if (session_flush(server, ss) != 0) session_close(server, ss);
+    }
+}
+
+// ==================================================================
+// ARRANQUE E EVENT LOOP
+// ==================================================================
+static int load_levels(server_t* server, const char* dir_path) {
+    struct dirent** namelist;
+    int n = scandir(dir_path, &namelist, filter_levels, alphasort);
+    if (n < 0) { perror("scandir"); return -1; }
+
+    server->levels = calloc(n ? n : 1, sizeof(board_t));
+    for (int i = 0; i < n; i++) {
+        if (server->levels && load_level(&server->levels[server->n_levels], dir_path, namelist[i]->d_name, 0) == 0)
+            server->n_levels++;
+        else
+            fprintf(stderr, "%s: nível rejeitado\n", namelist[i]->d_name);
+        free(namelist[i]);
+    }
+    free(namelist);
+    return server->n_levels > 0 ? 0 : -1;
+}
+
+static int listen_unix(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: caminho do socket demasiado longo\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+    unlink(path); // Socket de uma execução anterior
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SERVER_BACKLOG) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    set_nonblocking(fd);
+    return fd;
+}
+
+static int add_fd(int epfd, int fd, void* tag) {
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = tag };
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int server_main(int argc, char** argv) {
+    if (argc < 3) { printf("Usage: %s <socket> <dir> [threads]\n", argv[0]); return 1; }
+    const char* socket_path = argv[1];
+    int n_threads = (argc >= 4) ? atoi(argv[3]) : pool_default_threads();
+
+    server_t server;
+    memset(&server, 0, sizeof(server));
+    srand(time(NULL));
+    server.seed = (uint32_t)rand();
+    if (load_levels(&server, argv[2]) != 0) {
+        fprintf(stderr, "%s: nenhum nível jogável\n", argv[2]);
+        free(server.levels);
+        return 1;
+    }
+
+    // SIGINT/SIGTERM chegam pelo signalfd (bloqueados antes de criar os trabalhadores)
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    server.pool = pool_create(n_threads);
+    server.listen_fd = listen_unix(socket_path);
+    server.timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+    server.signal_fd = signalfd(-1, &mask, 0);
+    server.epfd = epoll_create1(0);
+
+    struct itimerspec period = {
+        .it_interval = { 0, SERVER_RESOLUTION_MS * 1000000L },
+        .it_value = { 0, SERVER_RESOLUTION_MS * 1000000L },
+    };
+    int ok = server.pool && server.listen_fd >= 0 && server.timer_fd >= 0 && server.signal_fd >= 0 &&
+             server.epfd >= 0 && timerfd_settime(server.timer_fd, 0, &period, NULL) == 0 &&
+             add_fd(server.epfd, server.listen_fd, &server.listen_fd) == 0 &&
+             add_fd(server.epfd, server.timer_fd, &server.timer_fd) == 0 &&
+             add_fd(server.epfd, server.signal_fd, &server.signal_fd) == 0;
+    if (ok) {
+        printf("A servir %d nível(is) em %s (%d threads)\n", server.n_levels, socket_path, n_threads);
+        fflush(stdout);
+    }
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    int running = ok;
+    while (running) {
+        int n = epoll_wait(server.epfd, events, SERVER_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        server.now = now_ms();
+
+        for (int i = 0; i < n; i++) {
+            void* tag = events[i].data.ptr;
+            if (tag == &server.listen_fd) server_accept(&server);
+            else if (tag == &server.timer_fd) server_tick(&server);
+            else if (tag == &server.signal_fd) running = 0;
+            else {
+                session_t* ss = (session_t*)tag;
+                // A sessão pode ter fechado num evento anterior desta volta
+                int alive = 0;
+                for (int s = 0; s < server.n_sessions && !alive; s++) alive = (server.sessions[s] == ss);
+                if (!alive) continue;
+
+                if (events[i].events & EPOLLOUT) {
+                    if (session_flush(&server, ss) != 0) { session_close(&server, ss); continue; }
+                }
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) session_input(&server, ss);
+            }
+        }
+    }
+
+    while (server.n_sessions > 0) session_close(&server, server.sessions[0]);
+    for (int i = 0; i < server.n_levels; i++) unload_level(&server.levels[i]);
+    free(server.levels);
+    free(server.sessions);
+    free(server.due);
+    if (server.pool) pool_destroy(server.pool);
+    if (server.epfd >= 0) close(server.epfd);
+    if (server.timer_fd >= 0) close(server.timer_fd);
+    if (server.signal_fd >= 0) close(server.signal_fd);
+    if (server.listen_fd >= 0) {
+        close(server.listen_fd);
+        unlink(socket_path);
+    }
+    return ok ? 0 : 1;
+}
+
+// ==================================================================
+// CLIENTE
+// ==================================================================
+typedef struct {
+    long tick;
+    int width, height, points;
+    char status[16];
+} frame_header_t;
+
+// Desenha o frame no início de buf se estiver completo; devolve os bytes consumidos (0 = incompleto)
+static size_t client_draw_frame(const char* buf, size_t len, frame_header_t* h) {
+    const char* nl = memchr(buf, '\n', len);
+    if (!nl) return 0;
+    if (sscanf(buf, "F %ld %d %d %d %15s", &h->tick, &h->width, &h->height, &h->points, h->status) != 5)
+        return (nl - buf) + 1; // Linha estranha: ignorar
+
+    size_t header = (nl - buf) + 1;
+    size_t total = header + (size_t)h->height * (h->width + 1);
+    if (len < total) return 0;
+
+    clear_screen();
+    draw_text(0, 5, "=== PACMAN GAME (servidor) ===");
+    draw_text(1, 5, "Jogada %ld | Points: %d | %s | Q to quit | G to quicksave", h->tick, h->points, h->status);
+    const char* row = buf + header;
+    for (int y = 0; y < h->height; y++, row += h->width + 1) {
+        draw_text(3 + y, 0, "%.*s", h->width, row);
+    }
+    refresh_screen();
+    return total;
+}
+
+int client_main(int argc, char** argv) {
+    if (argc < 2) { printf("Usage: %s <socket>\n", argv[0]); return 1; }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", argv[1]);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        perror(argv[1]);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+
+    terminal_init();
+    size_t cap = 1 << 16, len = 0;
+    char* buf = malloc(cap);
+    frame_header_t last;
+    memset(&last, 0, sizeof(last));
+    snprintf(last.status, sizeof(last.status), "?");
+
+    int connected = (buf != NULL);
+    while (connected) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, 33) > 0) {
+            if (len == cap) {
+                char* b = realloc(buf, cap * 2);
+                if (!b) break;
+                buf = b;
+                cap *= 2;
+            }
+            ssize_t n = read(fd, buf + len, cap - len);
+            if (n <= 0) connected = 0;
+            else len += n;
+
+            // Só interessa o frame mais recente, mas todos têm de ser consumidos
+            size_t used;
+            while (len > 0 && (used = client_draw_frame(buf, len, &last)) > 0) {
+                memmove(buf, buf + used, len - used);
+                len -= used;
+            }
+        }
+
+        char key = get_input();
+        if (key != '\0' && connected) send(fd, &key, 1, MSG_NOSIGNAL);
+    }
+
+    terminal_cleanup();
+    printf("Fim do jogo: %s, %d pontos\n", last.status, last.points);
+    free(buf);
+    close(fd);
+    return 0;
+}
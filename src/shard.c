@@ -0,0 +1,510 @@
+#include "shard.h"
+#include "display.h"
+#include "files.h"
+#include "pool.h"
+#include "sim.h"
+#include "tick.h"
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define SHARD_ALIGN 64            // Cada zona do segmento começa numa linha de cache
+#define SHARD_REBALANCE_TICKS 16  // Intervalo mínimo entre reequilíbrios das faixas
+
+// Fantasma que atravessa faixas: cada faixa desconta pending quando lhe chega na
+// fila; a de cima (owner) resolve-o quando pending chega a 0 e as outras esperam por done
+typedef struct {
+    int ghost;
+    int owner;
+    atomic_int pending;
+    atomic_int done;
+} shard_token_t;
+
+// Início do segmento. Os ponteiros valem em todos os processos: os trabalhadores
+// herdam o mapeamento no mesmo endereço
+typedef struct {
+    pthread_barrier_t barrier;       // Coordenador + trabalhadores
+    atomic_int stop;                 // Os trabalhadores saem depois da barreira seguinte
+    int n_workers;
+    int top[SHARD_MAX_WORKERS + 1];  // Primeira linha de cada faixa; top[n] = height
+    int len[SHARD_MAX_WORKERS];      // Entradas na fila de cada faixa nesta jogada
+    board_t board;                   // chunks, pacmans e ghosts apontam para o segmento
+    intent_t* intents;               // [n_ghosts]
+    int* queue;                      // [n_workers][n_ghosts]: fantasma, ou -(passagem + 1)
+    shard_token_t* tokens;           // [n_ghosts]
+} shard_shm_t;
+
+struct shard {
+    shard_shm_t* shm;
+    size_t size;
+    pid_t workers[SHARD_MAX_WORKERS];
+    int n_workers;
+    int load[SHARD_MAX_WORKERS];     // Fantasmas resolvidos dentro de cada faixa nesta jogada
+    int* rows;                       // [n_ghosts] Linhas dos fantasmas (para reequilibrar)
+    long since_rebalance;
+    long ticks;
+    long handoffs;                   // Fantasmas resolvidos como passagem (estatística)
+    long rebalances;
+};
+
+static size_t align_up(size_t n) {
+    return (n + SHARD_ALIGN - 1) & ~(size_t)(SHARD_ALIGN - 1);
+}
+
+// Reserva a próxima zona do segmento (já a zeros: vem de ftruncate)
+static void* carve(uint8_t** cursor, size_t size) {
+    void* zone = *cursor;
+    *cursor += align_up(size);
+    return zone;
+}
+
+// Faixa da linha y (top é crescente)
+static int band_of(const shard_shm_t* shm, int y) {
+    int lo = 0, hi = shm->n_workers - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (shm->top[mid] <= y) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+// ==================================================================
+// TRABALHADORES
+// ==================================================================
+// A fila da faixa por ordem de índice; uma passagem espera pelas outras faixas
+static void resolve_band(shard_shm_t* shm, int w) {
+    board_t* board = &shm->board;
+    const int* queue = &shm->queue[(size_t)w * board->n_ghosts];
+    for (int i = 0; i < shm->len[w]; i++) {
+        int item = queue[i];
+        if (item >= 0) {
+            resolve_ghost(board, item, &shm->intents[item]);
+            continue;
+        }
+        shard_token_t* token = &shm->tokens[-item - 1];
+        atomic_fetch_sub(&token->pending, 1);
+        if (token->owner == w) {
+            while (atomic_load(&token->pending) > 0) sched_yield();
+            resolve_ghost(board, token->ghost, &shm->intents[token->ghost]);
+            atomic_store(&token->done, 1);
+        }
+        else {
+            while (!atomic_load(&token->done)) sched_yield();
+        }
+    }
+}
+
+static void worker_loop(shard_shm_t* shm, int w) {
+    board_t* board = &shm->board;
+    for (;;) {
+        pthread_barrier_wait(&shm->barrier); // 1: Pacmans jogados (ou fim)
+        if (atomic_load(&shm->stop)) return;
+
+        // Decisão dos fantasmas que começam a jogada nesta faixa
+        int top = shm->top[w], bottom = shm->top[w + 1];
+        for (int g = 0; g < board->n_ghosts; g++) {
+            int y = board->ghosts[g].pos_y;
+            if (y >= top && y < bottom) sim_plan_ghost(board, g, &shm->intents[g]);
+        }
+        pthread_barrier_wait(&shm->barrier); // 2: decisões feitas
+
+        pthread_barrier_wait(&shm->barrier); // 3: filas prontas
+        resolve_band(shm, w);
+        pthread_barrier_wait(&shm->barrier); // 4: jogada resolvida
+    }
+}
+
+// ==================================================================
+// COORDENADOR
+// ==================================================================
+static void stop_workers(shard_t* shard) {
+    atomic_store(&shard->shm->stop, 1);
+    pthread_barrier_wait(&shard->shm->barrier);
+    for (int w = 0; w < shard->n_workers; w++) waitpid(shard->workers[w], NULL, 0);
+}
+
+static void unmap(shard_t* shard) {
+    pthread_barrier_destroy(&shard->shm->barrier);
+    munmap(shard->shm, shard->size);
+    free(shard->rows);
+    free(shard);
+}
+
+shard_t* shard_open(const board_t* level, int n_workers) {
+    if (board_has_spawning(level)) return NULL;
+    if (n_workers <= 0) n_workers = pool_default_threads();
+    if (n_workers > SHARD_MAX_WORKERS) n_workers = SHARD_MAX_WORKERS;
+    if (n_workers > level->height) n_workers = level->height;
+    if (n_workers < 1) n_workers = 1;
+
+    int ghosts = level->n_ghosts ? level->n_ghosts : 1;
+    size_t n_chunks = (size_t)level->chunks_x * level->chunks_y;
+    size_t size = align_up(sizeof(shard_shm_t))
+                + align_up(n_chunks * sizeof(board_pos_t*))
+                + board_chunks_used(level) * align_up(sizeof(board_wall_chunk))
+                + align_up((level->n_pacmans ? level->n_pacmans : 1) * sizeof(pacman_t))
+                + align_up(ghosts * sizeof(ghost_t))
+                + align_up(ghosts * sizeof(intent_t))
+                + align_up((size_t)n_workers * ghosts * sizeof(int))
+                + align_up(ghosts * sizeof(shard_token_t));
+
+    shard_t* shard = calloc(1, sizeof(*shard));
+    if (!shard) return NULL;
+    shard->rows = malloc(sizeof(int) * ghosts);
+    shard->size = size;
+    if (!shard->rows) { free(shard); return NULL; }
+
+    // O nome só existe até ao mmap: o segmento vive enquanto houver processos a mapeá-lo
+    char name[64];
+    snprintf(name, sizeof(name), "/pacmanist-shard-%d", (int)getpid());
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, size) != 0) {
+        perror("shm_open");
+        if (fd >= 0) { close(fd); shm_unlink(name); }
+        free(shard->rows); free(shard);
+        return NULL;
+    }
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    shm_unlink(name);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        free(shard->rows); free(shard);
+        return NULL;
+    }
+
+    uint8_t* cursor = map;
+    shard_shm_t* shm = carve(&cursor, sizeof(shard_shm_t));
+    shard->shm = shm;
+
+    // Cópia do nível, com as mesmas regras de board_clone (sem row locks)
+    board_t* board = &shm->board;
+    board->width = level->width;
+    board->height = level->height;
+    board->chunks_x = level->chunks_x;
+    board->chunks_y = level->chunks_y;
+    board->layout = level->layout;
+    board->chunk_shift_x = level->chunk_shift_x;
+    board->chunk_shift_y = level->chunk_shift_y;
+    board->n_pacmans = level->n_pacmans;
+    board->n_ghosts = level->n_ghosts;
+    board->tempo = level->tempo;
+    board->seed = level->seed;
+    board->hash = level->hash;
+    atomic_store(&board->state, GAME_RUNNING);
+    memcpy(board->level_name, level->level_name, sizeof(board->level_name));
+
+    board->chunks = carve(&cursor, n_chunks * sizeof(board_pos_t*));
+    for (size_t i = 0; i < n_chunks; i++) {
+        if (level->chunks[i] == board_wall_chunk) {
+            board->chunks[i] = board_wall_chunk;
+            continue;
+        }
+        board->chunks[i] = carve(&cursor, sizeof(board_wall_chunk));
+        memcpy(board->chunks[i], level->chunks[i], sizeof(board_wall_chunk));
+    }
+    board->pacmans = carve(&cursor, (level->n_pacmans ? level->n_pacmans : 1) * sizeof(pacman_t));
+    board->ghosts = carve(&cursor, ghosts * sizeof(ghost_t));
+    memcpy(board->pacmans, level->pacmans, level->n_pacmans * sizeof(pacman_t));
+    memcpy(board->ghosts, level->ghosts, level->n_ghosts * sizeof(ghost_t));
+    shm->intents = carve(&cursor, ghosts * sizeof(intent_t));
+    shm->queue = carve(&cursor, (size_t)n_workers * ghosts * sizeof(int));
+    shm->tokens = carve(&cursor, ghosts * sizeof(shard_token_t));
+
+    shm->n_workers = n_workers;
+    for (int b = 0; b <= n_workers; b++) shm->top[b] = (int)((long)level->height * b / n_workers);
+
+    pthread_barrierattr_t attr;
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    int err = pthread_barrier_init(&shm->barrier, &attr, n_workers + 1);
+    pthread_barrierattr_destroy(&attr);
+    if (err != 0) {
+        munmap(map, size);
+        free(shard->rows); free(shard);
+        return NULL;
+    }
+
+    pid_t parent = getpid();
+    for (int w = 0; w < n_workers; w++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            // Se o coordenador morrer, os trabalhadores não ficam presos na barreira
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != parent) _exit(1);
+            worker_loop(shm, w);
+            _exit(0);
+        }
+        if (pid < 0) {
+            // Sem todos os trabalhadores a barreira nunca abria
+            perror("fork");
+            for (int k = 0; k < w; k++) kill(shard->workers[k], SIGKILL);
+            for (int k = 0; k < w; k++) waitpid(shard->workers[k], NULL, 0);
+            unmap(shard);
+            return NULL;
+        }
+        shard->workers[w] = pid;
+    }
+    shard->n_workers = n_workers;
+    debug("[SHARD] %d trabalhadores, segmento de %zu KiB\n", n_workers, size / 1024);
+    return shard;
+}
+
+board_t* shard_board(shard_t* shard) {
+    return &shard->shm->board;
+}
+
+// Filas de cada faixa, por índice. Um fantasma que atravessa faixas entra em todas
+static int build_queues(shard_t* shard) {
+    shard_shm_t* shm = shard->shm;
+    board_t* board = &shm->board;
+    int G = board->n_ghosts, moving = 0, n_tokens = 0;
+    memset(shm->len, 0, sizeof(shm->len));
+    memset(shard->load, 0, sizeof(shard->load));
+
+    for (int g = 0; g < G; g++) {
+        const intent_t* intent = &shm->intents[g];
+        if (!intent->move) continue;
+        moving++;
+        int top, bottom;
+        ghost_footprint_rows(board, g, intent, &top, &bottom);
+        int b0 = band_of(shm, top), b1 = band_of(shm, bottom);
+        if (b0 == b1) {
+            shm->queue[(size_t)b0 * G + shm->len[b0]++] = g;
+            shard->load[b0]++;
+            continue;
+        }
+        shard_token_t* token = &shm->tokens[n_tokens];
+        token->ghost = g;
+        token->owner = b0;
+        atomic_store(&token->pending, b1 - b0 + 1);
+        atomic_store(&token->done, 0);
+        for (int b = b0; b <= b1; b++) shm->queue[(size_t)b * G + shm->len[b]++] = -(n_tokens + 1);
+        n_tokens++;
+    }
+    shard->handoffs += n_tokens;
+    return moving;
+}
+
+static int by_value(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+// Fronteiras nos quantis das linhas dos fantasmas (cada faixa com pelo menos uma linha)
+static void rebalance(shard_t* shard) {
+    shard_shm_t* shm = shard->shm;
+    const board_t* board = &shm->board;
+    int n = shm->n_workers, g = board->n_ghosts;
+    for (int i = 0; i < g; i++) shard->rows[i] = board->ghosts[i].pos_y;
+    qsort(shard->rows, g, sizeof(int), by_value);
+    shm->top[0] = 0;
+    for (int b = 1; b < n; b++) {
+        int t = shard->rows[(long)g * b / n];
+        if (t < shm->top[b - 1] + 1) t = shm->top[b - 1] + 1;
+        if (t > board->height - (n - b)) t = board->height - (n - b);
+        shm->top[b] = t;
+    }
+    shm->top[n] = board->height;
+    shard->since_rebalance = 0;
+    shard->rebalances++;
+}
+
+static int any_pacman_alive(const board_t* board) {
+    for (int p = 0; p < board->n_pacmans; p++) {
+        if (board->pacmans[p].alive) return 1;
+    }
+    return 0;
+}
+
+int shard_step(shard_t* shard) {
+    shard_shm_t* shm = shard->shm;
+    board_t* board = &shm->board;
+    shard->ticks++;
+
+    // Os Pacmans jogam antes de os fantasmas decidirem: se o jogo acaba aqui, os
+    // fantasmas não chegam a mexer no estado (tal como em sim_step)
+    int outcome = sim_step_pacmans(board);
+    if (outcome != SIM_RUNNING) return outcome;
+
+    pthread_barrier_wait(&shm->barrier); // 1
+    pthread_barrier_wait(&shm->barrier); // 2: decisões feitas
+    int moving = build_queues(shard);
+    pthread_barrier_wait(&shm->barrier); // 3
+    pthread_barrier_wait(&shm->barrier); // 4: jogada resolvida
+
+    // Reequilibrar quando uma faixa tem bastante mais fantasmas do que a média
+    int n = shm->n_workers, max_load = 0;
+    for (int b = 0; b < n; b++) max_load = shard->load[b] > max_load ? shard->load[b] : max_load;
+    if (++shard->since_rebalance >= SHARD_REBALANCE_TICKS && n > 1 && 2 * max_load * n > 3 * moving)
+        rebalance(shard);
+
+    // Morte passiva: um fantasma entrou na casa do último Pacman
+    return any_pacman_alive(board) ? SIM_RUNNING : SIM_DEATH;
+}
+
+void shard_close(shard_t* shard) {
+    if (!shard) return;
+    debug("[SHARD] %ld jogadas, %ld passagens entre faixas, %ld reequilíbrios\n",
+          shard->ticks, shard->handoffs, shard->rebalances);
+    stop_workers(shard);
+    unmap(shard);
+}
+
+// ==================================================================
+// MODO --shards
+// ==================================================================
+static double elapsed(const struct timespec* t0, const struct timespec* t1) {
+    return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+// Joga o nível repartido e, ao lado, um clone com sim_step; o hash tem de bater em todas as jogadas
+static int verify_level(const board_t* level, const char* name, int n_workers, int max_ticks) {
+    if (board_has_spawning(level)) {
+        printf("%s: nível com ninhos ou 'X' (não repartido)\n", name);
+        return 0;
+    }
+    board_t ref;
+    memset(&ref, 0, sizeof(ref));
+    shard_t* shard = shard_open(level, n_workers);
+    if (!shard || board_clone(&ref, level) != 0) {
+        printf("%s: sem memória partilhada\n", name);
+        shard_close(shard);
+        board_free_clone(&ref);
+        return -1;
+    }
+    board_t* board = shard_board(shard);
+
+    struct timespec t0, t1;
+    double shard_s = 0, sim_s = 0;
+    int tick = 0, outcome = SIM_RUNNING, expected = SIM_RUNNING, diverged = -1;
+    while (tick < max_ticks && outcome == SIM_RUNNING && expected == SIM_RUNNING) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        outcome = shard_step(shard);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        shard_s += elapsed(&t0, &t1);
+        expected = sim_step(&ref);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        sim_s += elapsed(&t1, &t0);
+        tick++;
+        if (outcome != expected || board->hash != ref.hash) { diverged = tick; break; }
+    }
+    if (diverged < 0 && board_hash_full(board) != board_hash_full(&ref)) diverged = tick;
+
+    printf("%s: %d jogadas (%s), %d trabalhadores, estados %s",
+           name, tick, sim_outcome_name(outcome == SIM_RUNNING ? SIM_TIMEOUT : outcome),
+           shard->n_workers, diverged < 0 ? "iguais" : "DIFERENTES");
+    if (diverged >= 0) printf(" (jogada %d)", diverged);
+    printf("\n  %.2f us/jogada repartido, %.2f us/jogada sim_step, %ld passagens, %ld reequilíbrios\n",
+           tick ? shard_s * 1e6 / tick : 0, tick ? sim_s * 1e6 / tick : 0, shard->handoffs, shard->rebalances);
+
+    shard_close(shard);
+    board_free_clone(&ref);
+    return diverged < 0 ? 0 : -1;
+}
+
+// Um nível jogado no ecrã: devolve 1 (vitória), 2 (morte) ou 3 (quit)
+static int play_level(const board_t* level, int n_workers, int* points) {
+    shard_t* shard = shard_open(level, n_workers);
+    if (!shard) return 3;
+    board_t* board = shard_board(shard);
+
+    tick_clock_t clock;
+    tick_clock_start(&clock, board->tempo > 0 ? board->tempo : 100);
+    draw_board(board, DRAW_MENU);
+    refresh_screen();
+
+    int status = 0;
+    while (!status) {
+        // Só o coordenador mexe no tabuleiro entre jogadas: as teclas entram diretamente
+        char input = get_input();
+        if (input == 'N') toggle_minimap();
+        else if (input == 'Q' && board_players(board) > 0) status = 3;
+        else if (input != '\0' && input != 'G') board_send_input(board, input);
+        if (status) break;
+
+        int outcome = shard_step(shard);
+        if (outcome == SIM_WIN) status = 1;
+        else if (outcome == SIM_DEATH) status = 2;
+        else if (outcome == SIM_QUIT) status = 3;
+
+        draw_board(board, DRAW_MENU);
+        refresh_screen();
+        if (!status) tick_clock_wait(&clock);
+    }
+
+    if (status == 1) { draw_board(board, DRAW_WIN); refresh_screen(); sleep_ms(1000); }
+    if (status == 2) { draw_board(board, DRAW_GAME_OVER); refresh_screen(); sleep_ms(2000); }
+    *points = board_points(board);
+    shard_close(shard);
+    return status;
+}
+
+int shard_main(int argc, char** argv) {
+    if (argc < 2) { printf("Usage: %s <dir> [workers] [--verify ticks]\n", argv[0]); return 1; }
+    const char* dir_path = argv[1];
+    int n_workers = 0, verify_ticks = 0;
+    for (int a = 2; a < argc; a++) {
+        if (strcmp(argv[a], "--verify") == 0) verify_ticks = (a + 1 < argc) ? atoi(argv[++a]) : 2000;
+        else n_workers = atoi(argv[a]);
+    }
+
+    struct dirent** namelist;
+    int n = scandir(dir_path, &namelist, filter_levels, alphasort);
+    if (n < 0) { perror("scandir"); return 1; }
+    srand(time(NULL));
+
+    int failed = 0;
+    if (verify_ticks > 0) {
+        for (int i = 0; i < n; i++) {
+            board_t level;
+            memset(&level, 0, sizeof(level));
+            if (load_level(&level, dir_path, namelist[i]->d_name, 0) == 0) {
+                failed |= verify_level(&level, namelist[i]->d_name, n_workers, verify_ticks) != 0;
+                unload_level(&level);
+            }
+            else {
+                printf("%s: nível rejeitado\n", namelist[i]->d_name);
+            }
+            free(namelist[i]);
+        }
+        free(namelist);
+        return failed ? 2 : 0;
+    }
+
+    open_debug_file("debug.log");
+    terminal_init();
+    int accumulated_points = 0;
+    for (int i = 0; i < n; i++) {
+        board_t level;
+        memset(&level, 0, sizeof(level));
+        int status = 1;
+        if (load_level(&level, dir_path, namelist[i]->d_name, accumulated_points) == 0) {
+            if (board_has_spawning(&level)) debug("[SHARD] %s: nível com ninhos ou 'X', saltado\n", namelist[i]->d_name);
+            else status = play_level(&level, n_workers, &accumulated_points);
+            unload_level(&level);
+            clear_screen();
+            refresh_screen();
+        }
+        free(namelist[i]);
+        if (status != 1) {
+            for (i++; i < n; i++) free(namelist[i]);
+            break;
+        }
+    }
+    free(namelist);
+    terminal_cleanup();
+    close_debug_file();
+    return 0;
+}
@@ -0,0 +1,549 @@
+#include "sim.h"
+#include "files.h"
+#include "traj.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TT_UNKNOWN (-2) // Estado de uma corrida que acabou sem desfecho (timeout)
+
+// Uma jogada de um Pacman guiado por script. Sem script só se mexe com uma tecla
+// pendente (next_cmd), que os modos headless nunca escrevem
+static int step_pacman(board_t* board, int p) {
+    pacman_t* pac = &board->pacmans[p];
+    if (!pac->alive) return SIM_RUNNING;
+    if (pac->n_code == 0) {
+        char cmd = atomic_exchange(&pac->next_cmd, '\0');
+        if (!cmd) return SIM_RUNNING;
+        script_op_t key = script_move(cmd);
+        return move_pacman(board, p, &key) == REACHED_PORTAL ? SIM_WIN : SIM_RUNNING;
+    }
+
+    // 'G' não tem efeito sem ecrã: salta para a instrução seguinte na mesma jogada
+    const script_op_t* op = pacman_op(board, p);
+    for (int skipped = 0; op->op == OP_SAVE && skipped < pac->n_code; skipped++) {
+        skip_pacman_command(board, p);
+        op = pacman_op(board, p);
+    }
+    if (op->op == OP_QUIT) return SIM_QUIT;
+    if (op->op == OP_SAVE) return SIM_RUNNING;
+
+    // Um Pacman morto sai do jogo; o nível só se perde quando morrem todos
+    int result = move_pacman(board, p, op);
+    if (result == REACHED_PORTAL) return SIM_WIN;
+    return SIM_RUNNING;
+}
+
+void sim_plan_ghost(board_t* board, int g, intent_t* intent) {
+    ghost_t* ghost = &board->ghosts[g];
+    if (ghost->n_code > 0) {
+        plan_ghost(board, g, ghost_op(board, g), intent);
+    }
+    else {
+        // A direção é sorteada em todas as jogadas, mesmo à espera do passo
+        char opts[] = {'W', 'A', 'S', 'D'};
+        script_op_t op = script_move(opts[agent_rand(&ghost->rng) % 4]);
+        plan_ghost(board, g, &op, intent);
+    }
+}
+
+static void step_ghost(board_t* board, int g) {
+    intent_t intent;
+    sim_plan_ghost(board, g, &intent);
+    resolve_ghost(board, g, &intent);
+}
+
+static int any_pacman_alive(const board_t* board) {
+    for (int p = 0; p < board->n_pacmans; p++) {
+        if (board->pacmans[p].alive) return 1;
+    }
+    return 0;
+}
+
+int sim_step_pacmans(board_t* board) {
+    for (int p = 0; p < board->n_pacmans; p++) {
+        int outcome = step_pacman(board, p);
+        if (outcome != SIM_RUNNING) return outcome;
+    }
+    return any_pacman_alive(board) ? SIM_RUNNING : SIM_DEATH;
+}
+
+// Uma jogada sem os fantasmas marcados em skip; *ghost_turns conta as jogadas em que
+// os fantasmas chegaram a jogar (numa jogada que acaba nos Pacmans não jogam)
+static int step_agents(board_t* board, const uint8_t* skip, int* ghost_turns) {
+    int outcome = sim_step_pacmans(board);
+    if (outcome != SIM_RUNNING) return outcome;
+
+    for (int g = 0; g < board->n_ghosts; g++) {
+        if (board->ghosts[g].active && (!skip || !skip[g])) step_ghost(board, g);
+    }
+    board_end_tick(board, NULL); // Saídas ('X') e ninhos
+    if (ghost_turns) (*ghost_turns)++;
+
+    // Morte passiva: um fantasma entrou na casa do último Pacman
+    return any_pacman_alive(board) ? SIM_RUNNING : SIM_DEATH;
+}
+
+int sim_step(board_t* board) {
+    return step_agents(board, NULL, NULL);
+}
+
+// ==================================================================
+// JANELAS COM TRAJETÓRIAS (traj.h)
+// ==================================================================
+typedef struct {
+    traj_box_t box;
+    int ghost;            // Fantasma candidato a saltar a janela, ou -1 (joga jogada a jogada)
+} window_item_t;
+
+typedef struct {
+    int* at;              // [n_ghosts] Índice na trajetória no início da janela
+    uint8_t* skip;        // [n_ghosts] 1 = salta a janela
+    uint8_t* hit;         // [n_ghosts] Candidato que pode tocar noutro agente
+    window_item_t* items; // [n_pacmans + n_ghosts]
+    int n_items;
+    int* cands;           // [n_ghosts] Itens dos candidatos, por ordem de x0
+    int* queue;           // [n_ghosts] Candidatos marcados cuja caixa de alcance falta ver
+} window_t;
+
+static int window_init(window_t* win, const board_t* board) {
+    int ghosts = board->n_ghosts ? board->n_ghosts : 1;
+    win->at = malloc(sizeof(int) * ghosts);
+    win->skip = malloc(ghosts);
+    win->hit = malloc(ghosts);
+    win->items = malloc(sizeof(window_item_t) * (board->n_pacmans + ghosts));
+    win->cands = malloc(sizeof(int) * ghosts);
+    win->queue = malloc(sizeof(int) * ghosts);
+    return win->at && win->skip && win->hit && win->items && win->cands && win->queue ? 0 : -1;
+}
+
+static void window_free(window_t* win) {
+    free(win->at);
+    free(win->skip);
+    free(win->hit);
+    free(win->items);
+    free(win->cands);
+    free(win->queue);
+}
+
+static int ghost_can_slide(const ghost_t* ghost) {
+    for (int i = 0; i < ghost->n_code; i++)
+        if (ghost->code[i].op == OP_CHARGE || ghost->code[i].charge) return 1;
+    return 0;
+}
+
+// Casas que um fantasma a jogar jogada a jogada pode ler ou escrever em n jogadas;
+// devolve 1 se for o tabuleiro todo (pode deslizar carregado)
+static int reach_box(const board_t* board, const window_t* win, int g, int n, traj_box_t* box) {
+    const ghost_t* ghost = &board->ghosts[g];
+    const traj_t* traj = &board->trajs->ghosts[g];
+    int at = win->at[g] >= 0 ? win->at[g] : traj_find_script(traj, ghost);
+    if (at >= 0) {
+        // Os movimentos que o script pede não dependem da posição: cada um anda no máximo uma casa
+        traj_moves_t moves;
+        traj_window_moves(traj, at, n, &moves);
+        if (moves.charged > 0) return 1;
+        *box = (traj_box_t){ ghost->pos_x - moves.left, ghost->pos_y - moves.up,
+                             ghost->pos_x + moves.right, ghost->pos_y + moves.down };
+        return 0;
+    }
+    if (ghost_can_slide(ghost)) return 1;
+    *box = (traj_box_t){ ghost->pos_x - n, ghost->pos_y - n, ghost->pos_x + n, ghost->pos_y + n };
+    return 0;
+}
+
+static int by_x0(const void* a, const void* b) {
+    const window_item_t* ia = a;
+    const window_item_t* ib = b;
+    return (ia->box.x0 > ib->box.x0) - (ia->box.x0 < ib->box.x0);
+}
+
+static int boxes_touch(const traj_box_t* a, const traj_box_t* b) {
+    return a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1 && b->y0 <= a->y1;
+}
+
+static void mark(window_t* win, int item, int* n_queue) {
+    int g = win->items[item].ghost;
+    if (g < 0 || win->hit[g]) return;
+    win->hit[g] = 1;
+    win->queue[(*n_queue)++] = item;
+}
+
+// Escolhe os fantasmas que saltam as próximas n jogadas; devolve quantos são
+static int plan_window(board_t* board, window_t* win, int n) {
+    const traj_set_t* set = board->trajs;
+    win->n_items = 0;
+    for (int p = 0; p < board->n_pacmans; p++) {
+        const pacman_t* pac = &board->pacmans[p];
+        if (!pac->alive) continue;
+        window_item_t* item = &win->items[win->n_items++];
+        item->box = (traj_box_t){ pac->pos_x - n, pac->pos_y - n, pac->pos_x + n, pac->pos_y + n };
+        item->ghost = -1;
+    }
+    for (int g = 0; g < board->n_ghosts; g++) {
+        const ghost_t* ghost = &board->ghosts[g];
+        win->skip[g] = 0;
+        win->hit[g] = 0;
+        if (!ghost->active) continue;
+        window_item_t* item = &win->items[win->n_items++];
+        win->at[g] = traj_find(&set->ghosts[g], ghost);
+        item->ghost = win->at[g] >= 0 ? g : -1;
+        if (item->ghost >= 0) traj_window_box(&set->ghosts[g], win->at[g], n, &item->box);
+        else if (reach_box(board, win, g, n, &item->box)) return 0;
+    }
+
+    // Varrimento pela ordem de x0: marca os candidatos cuja caixa toca noutra
+    qsort(win->items, win->n_items, sizeof(window_item_t), by_x0);
+    int n_cands = 0, max_width = 0, n_queue = 0;
+    for (int i = 0; i < win->n_items; i++) {
+        const window_item_t* a = &win->items[i];
+        if (a->ghost >= 0) {
+            win->cands[n_cands++] = i;
+            if (a->box.x1 - a->box.x0 > max_width) max_width = a->box.x1 - a->box.x0;
+        }
+        for (int j = i + 1; j < win->n_items && win->items[j].box.x0 <= a->box.x1; j++) {
+            if (!boxes_touch(&a->box, &win->items[j].box)) continue;
+            mark(win, i, &n_queue);
+            mark(win, j, &n_queue);
+        }
+    }
+
+    // Um candidato marcado joga jogada a jogada e pode sair da trajetória: passa a
+    // ocupar a caixa de alcance, que pode tocar em mais candidatos
+    while (n_queue > 0) {
+        const window_item_t* item = &win->items[win->queue[--n_queue]];
+        traj_box_t reach;
+        if (reach_box(board, win, item->ghost, n, &reach)) return 0;
+        int lo = 0, hi = n_cands;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (win->items[win->cands[mid]].box.x0 < reach.x0 - max_width) lo = mid + 1;
+            else hi = mid;
+        }
+        for (int k = lo; k < n_cands && win->items[win->cands[k]].box.x0 <= reach.x1; k++) {
+            if (boxes_touch(&reach, &win->items[win->cands[k]].box)) mark(win, win->cands[k], &n_queue);
+        }
+    }
+
+    int free_ghosts = 0;
+    for (int k = 0; k < n_cands; k++) {
+        int g = win->items[win->cands[k]].ghost;
+        if (win->hit[g]) continue;
+        win->skip[g] = 1;
+        free_ghosts++;
+    }
+    return free_ghosts;
+}
+
+// Os fantasmas que saltaram a janela passam para o estado depois de turns jogadas
+static void jump_window(board_t* board, const window_t* win, int turns) {
+    const traj_set_t* set = board->trajs;
+    for (int g = 0; g < board->n_ghosts; g++) {
+        if (!win->skip[g] || turns == 0) continue;
+        const traj_state_t* s = traj_state(&set->ghosts[g], win->at[g], turns);
+        place_ghost(board, g, s->x, s->y, s->pc, s->left, s->waiting, s->charged);
+    }
+}
+
+void sim_run(board_t* board, int max_ticks, sim_result_t* result) {
+    window_t win;
+    memset(&win, 0, sizeof(win));
+    // Um fantasma que nasce a meio de uma janela podia tocar nos que a saltam
+    int use_trajs = board->trajs && board->n_nests == 0 && window_init(&win, board) == 0;
+
+    // Depois de uma janela sem fantasmas livres as seguintes nem são planeadas, cada vez
+    // mais (até 16): num tabuleiro cheio o planeamento não chega a pagar-se
+    int backoff = 0, idle = 0;
+    int outcome = SIM_RUNNING;
+    int tick = 0;
+    while (outcome == SIM_RUNNING && tick < max_ticks) {
+        int n = max_ticks - tick < TRAJ_WINDOW ? max_ticks - tick : TRAJ_WINDOW;
+        int free_ghosts = 0;
+        if (use_trajs && idle > 0) idle--;
+        else if (use_trajs) {
+            free_ghosts = plan_window(board, &win, n);
+            if (free_ghosts * 8 < board->n_ghosts) free_ghosts = 0;
+            backoff = free_ghosts ? 0 : backoff ? (backoff < 16 ? backoff * 2 : 16) : 1;
+            idle = backoff;
+        }
+        if (free_ghosts == 0) {
+            for (int i = 0; i < n && outcome == SIM_RUNNING; i++, tick++) outcome = sim_step(board);
+            continue;
+        }
+        int turns = 0;
+        for (int i = 0; i < n && outcome == SIM_RUNNING; i++, tick++) outcome = step_agents(board, win.skip, &turns);
+        jump_window(board, &win, turns);
+    }
+    window_free(&win);
+
+    memset(result, 0, sizeof(*result));
+    result->outcome = (outcome == SIM_RUNNING) ? SIM_TIMEOUT : outcome;
+    result->ticks = tick;
+    result->points = board_points(board);
+}
+
+int board_is_deterministic(const board_t* board) {
+    for (int p = 0; p < board->n_pacmans; p++) {
+        const pacman_t* pac = &board->pacmans[p];
+        for (int i = 0; i < pac->n_code; i++)
+            if (pac->code[i].op == OP_RANDOM) return 0;
+    }
+    for (int g = 0; g < board->n_ghosts; g++) {
+        const ghost_t* ghost = &board->ghosts[g];
+        if (ghost->n_code == 0) return 0;
+        for (int i = 0; i < ghost->n_code; i++)
+            if (ghost->code[i].op == OP_RANDOM) return 0;
+    }
+    return 1;
+}
+
+typedef struct {
+    uint64_t hash;
+    int points;
+} path_step_t;
+
+// Depois do desfecho, cada estado da corrida fica a saber o que lhe acontece
+static void resolve_path(ttable_t* tt, const path_step_t* path, int n, const sim_result_t* result) {
+    int known = result->outcome != SIM_TIMEOUT;
+    for (int i = 0; i < n; i++) {
+        tt_entry_t* e = tt_lookup(tt, path[i].hash);
+        if (!e) continue;
+        e->value = known ? result->outcome : TT_UNKNOWN;
+        e->tick = result->ticks - i;
+        e->points = result->points - path[i].points;
+    }
+}
+
+// O caminho cresce com a corrida (max_ticks vem da linha de comandos e pode ser
+// enorme para uma corrida curta), no máximo até max_ticks + 1 estados
+static int grow_path(path_step_t** path, int* cap, int max_ticks) {
+    int grown = *cap > max_ticks / 2 ? max_ticks + 1 : 2 * *cap;
+    path_step_t* more = realloc(*path, sizeof(path_step_t) * grown);
+    if (!more) return -1;
+    *path = more;
+    *cap = grown;
+    return 0;
+}
+
+void sim_run_tt(board_t* board, int max_ticks, ttable_t* tt, sim_result_t* result) {
+    if (!tt || !board_is_deterministic(board)) {
+        sim_run(board, max_ticks, result);
+        return;
+    }
+
+    int cap = max_ticks < 1024 ? (max_ticks > 0 ? max_ticks + 1 : 1) : 1024;
+    path_step_t* path = malloc(sizeof(path_step_t) * cap);
+    if (!path) {
+        sim_run(board, max_ticks, result);
+        return;
+    }
+
+    memset(result, 0, sizeof(*result));
+    int n = 0;
+    int tick = 0;
+    int outcome = SIM_RUNNING;
+
+    for (;;) {
+        if (n == cap && grow_path(&path, &cap, max_ticks) != 0) {
+            // Sem memória para o caminho: o resto joga-se sem a tabela e os estados já
+            // registados ficam com o desfecho que vier
+            sim_result_t rest;
+            sim_run(board, max_ticks - tick, &rest);
+            outcome = rest.outcome == SIM_TIMEOUT ? SIM_RUNNING : rest.outcome;
+            tick += rest.ticks;
+            result->points = rest.points;
+            break;
+        }
+        int points = board_points(board);
+        int created;
+        tt_entry_t* e = tt_insert(tt, board->hash, &created);
+
+        if (e && !created && e->value == TT_PENDING) {
+            // Mesmo estado duas vezes nesta corrida: ciclo
+            outcome = SIM_CYCLE;
+            result->cycle_start = e->tick;
+            result->cycle_length = tick - e->tick;
+            result->points = points;
+            break;
+        }
+        if (e && !created && e->value != TT_UNKNOWN) {
+            // Estado já resolvido por outra corrida
+            outcome = e->value;
+            result->reused = 1;
+            result->points = points + e->points;
+            tick += e->tick;
+            break;
+        }
+        if (e) {
+            e->value = TT_PENDING;
+            e->tick = tick;
+        }
+        path[n].hash = board->hash;
+        path[n].points = points;
+        n++;
+
+        if (tick >= max_ticks) {
+            result->points = points;
+            break;
+        }
+        outcome = sim_step(board);
+        tick++;
+        if (outcome != SIM_RUNNING) {
+            result->points = board_points(board);
+            break;
+        }
+    }
+
+    result->outcome = (outcome == SIM_RUNNING) ? SIM_TIMEOUT : outcome;
+    result->ticks = tick;
+    resolve_path(tt, path, n, result);
+    free(path);
+}
+
+const char* sim_outcome_name(int outcome) {
+    switch (outcome) {
+        case SIM_RUNNING: return "running";
+        case SIM_WIN:     return "win";
+        case SIM_DEATH:   return "death";
+        case SIM_QUIT:    return "quit";
+        case SIM_TIMEOUT: return "timeout";
+        case SIM_CYCLE:   return "cycle";
+        default:          return "?";
+    }
+}
+
+int sim_main(int argc, char** argv) {
+    if (argc < 2) { printf("Usage: %s <dir> [max_ticks]\n", argv[0]); return 1; }
+    const char* dir_path = argv[1];
+    int max_ticks = (argc >= 3) ? atoi(argv[2]) : SIM_DEFAULT_MAX_TICKS;
+
+    struct dirent** namelist;
+    int n = scandir(dir_path, &namelist, filter_levels, alphasort);
+    if (n < 0) { perror("scandir"); return 1; }
+
+    srand(time(NULL));
+    ttable_t tt;
+    if (tt_init(&tt, 16) != 0) return 1;
+
+    for (int i = 0; i < n; i++) {
+        board_t board;
+        memset(&board, 0, sizeof(board));
+        if (load_level(&board, dir_path, namelist[i]->d_name, 0) != 0) {
+            printf("%s: rejected\n", namelist[i]->d_name);
+            free(namelist[i]);
+            continue;
+        }
+
+        sim_result_t result;
+        tt_clear(&tt);
+        sim_run_tt(&board, max_ticks, &tt, &result);
+
+        printf("%s: %s after %d ticks, %d points", namelist[i]->d_name,
+               sim_outcome_name(result.outcome), result.ticks, result.points);
+        if (result.outcome == SIM_CYCLE)
+            printf(" (period %d from tick %d)", result.cycle_length, result.cycle_start);
+        printf("\n");
+
+        unload_level(&board);
+        free(namelist[i]);
+    }
+    free(namelist);
+    tt_free(&tt);
+    return 0;
+}
+
+// ==================================================================
+// COMPARAÇÃO DOS LAYOUTS DO TABULEIRO
+// ==================================================================
+static double elapsed(const struct timespec* t0, const struct timespec* t1) {
+    return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+typedef struct {
+    double tick_us;   // Tempo por jogada de sim_step
+    double scan_ns;   // Tempo por casa a percorrer as colunas de cima para baixo
+    int ticks;
+    uint64_t hash;    // Estado final (tem de ser igual em todos os layouts)
+    size_t chunks;    // Blocos alocados
+} layout_result_t;
+
+// Percorre cada coluna de cima para baixo, como um fantasma carregado na vertical
+static double scan_columns(const board_t* board) {
+    struct timespec t0, t1;
+    long walls = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int x = 0; x < board->width; x++) {
+        for (int y = 0; y < board->height; y++) walls += board_at(board, x, y)->content == 'W';
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (walls < 0) printf("\n"); // Não deixar o compilador apagar o ciclo
+    return elapsed(&t0, &t1) * 1e9 / ((double)board->width * board->height);
+}
+
+static int bench_layout(const char* dir, const char* level, int layout, int max_ticks,
+                        uint32_t seed, layout_result_t* out) {
+    board_t board;
+    memset(&board, 0, sizeof(board));
+    board_set_layout(layout);
+    if (load_level(&board, dir, level, 0) != 0) return -1;
+    board_seed(&board, seed);
+
+    struct timespec t0, t1;
+    int ticks = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while (ticks < max_ticks && sim_step(&board) == SIM_RUNNING) ticks++;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    out->ticks = ticks;
+    out->tick_us = ticks ? elapsed(&t0, &t1) * 1e6 / ticks : 0;
+    out->hash = board.hash;
+    out->chunks = board_chunks_used(&board);
+    out->scan_ns = scan_columns(&board);
+    unload_level(&board);
+    return 0;
+}
+
+int layout_bench_main(int argc, char** argv) {
+    if (argc < 2) { printf("Usage: %s <dir> [ticks]\n", argv[0]); return 1; }
+    const char* dir_path = argv[1];
+    int max_ticks = (argc >= 3) ? atoi(argv[2]) : 2000;
+
+    struct dirent** namelist;
+    int n = scandir(dir_path, &namelist, filter_levels, alphasort);
+    if (n < 0) { perror("scandir"); return 1; }
+
+    srand(time(NULL));
+    uint32_t seed = (uint32_t)rand();
+    int rows_layout = BOARD_LAYOUT_ROWS;
+
+    for (int i = 0; i < n; i++) {
+        const char* name = namelist[i]->d_name;
+        layout_result_t res[BOARD_N_LAYOUTS];
+        int ok = 1;
+        for (int l = 0; l < BOARD_N_LAYOUTS && ok; l++) {
+            ok = bench_layout(dir_path, name, l, max_ticks, seed, &res[l]) == 0;
+        }
+        if (!ok) {
+            printf("%s: nível rejeitado\n", name);
+            free(namelist[i]);
+            continue;
+        }
+
+        int same = 1;
+        for (int l = 1; l < BOARD_N_LAYOUTS; l++) {
+            same &= res[l].hash == res[0].hash && res[l].ticks == res[0].ticks;
+        }
+        printf("%s: %d jogadas, estados %s\n", name, res[0].ticks, same ? "iguais" : "DIFERENTES");
+        printf("  %-8s %12s %8s %14s %8s %10s\n", "layout", "us/jogada", "vs rows", "colunas ns/casa", "vs rows", "blocos");
+        for (int l = 0; l < BOARD_N_LAYOUTS; l++) {
+            printf("  %-8s %12.2f %7.2fx %14.2f %7.2fx %10zu\n", board_layout_name(l),
+                   res[l].tick_us, res[l].tick_us > 0 ? res[rows_layout].tick_us / res[l].tick_us : 0,
+                   res[l].scan_ns, res[l].scan_ns > 0 ? res[rows_layout].scan_ns / res[l].scan_ns : 0,
+                   res[l].chunks);
+        }
+        free(namelist[i]);
+    }
+    free(namelist);
+    return 0;
+}
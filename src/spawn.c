@@ -0,0 +1,146 @@
+#include "spawn.h"
+#include "tick.h"
+#include "sim.h"
+#include "files.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ==================================================================
+// MODO --spawn-bench
+// ==================================================================
+#define SPAWN_STAGES 9
+
+// Limite de cada ninho em cada fase, em oitavos das vagas: sobe, mantém e desce
+static const int stage_eighths[SPAWN_STAGES] = { 1, 2, 4, 8, 8, 4, 2, 1, 0 };
+
+static double elapsed_s(const struct timespec* t0, const struct timespec* t1) {
+    return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+static int live_ghosts(const board_t* board) {
+    int n = 0;
+    for (int g = 0; g < board->n_ghosts; g++) n += board->ghosts[g].active;
+    return n;
+}
+
+/* Baixa o limite dos ninhos e manda sair os fantasmas a mais, das vagas mais altas
+   para as mais baixas (pelos handles guardados a meio da fase anterior). Os handles
+   de fantasmas que entretanto saíram sozinhos ('X') estão obsoletos e são recusados,
+   mesmo que a vaga já tenha outro fantasma.
+   O mesmo pedido vai para os dois tabuleiros, que têm as mesmas vagas */
+static void lower_nests(board_t* live, board_t* ref, const ghost_handle_t* handles, int n_handles,
+                        long* despawned, long* stale) {
+    int alive[MAX_NESTS];
+    for (int i = 0; i < live->n_nests; i++) {
+        ref->nests[i].max = live->nests[i].max;
+        alive[i] = live->nests[i].slots - live->nests[i].n_free;
+    }
+    for (int h = n_handles - 1; h >= 0; h--) {
+        int g = ghost_slot(live, handles[h]);
+        if (g < 0) { (*stale)++; continue; }
+        int nest = live->ghosts[g].nest;
+        if (alive[nest] <= live->nests[nest].max) continue;
+        despawn_ghost(live, handles[h]);
+        despawn_ghost(ref, handles[h]);
+        alive[nest]--;
+        (*despawned)++;
+    }
+}
+
+// Joga o nível com o motor e, ao lado, um clone com sim_step; devolve -1 se divergirem
+static int spawn_bench_level(board_t* live, const char* name, int ticks) {
+    board_t ref;
+    memset(&ref, 0, sizeof(ref));
+    tick_engine_t engine;
+    ghost_handle_t* handles = malloc(sizeof(ghost_handle_t) * (live->n_ghosts ? live->n_ghosts : 1));
+    if (!handles || board_clone(&ref, live) != 0 || tick_engine_init(&engine, live, 0) != 0) {
+        printf("%s: sem memória\n", name);
+        free(handles);
+        board_free_clone(&ref);
+        return -1;
+    }
+    // Só os fantasmas com script jogam da mesma maneira no motor e em sim_step
+    int comparable = 1;
+    for (int g = 0; g < live->n_ghosts; g++) comparable &= live->ghosts[g].n_code > 0;
+
+    printf("%s: %d ninho(s), %d vagas, %d fantasmas do MON\n", name, live->n_nests,
+           live->n_ghosts - live->spawn_base, live->spawn_base);
+    printf("  %-5s %6s %9s %12s %8s %8s %10s\n", "fase", "limite", "vivos", "us/jogada", "nascem", "saem", "obsoletos");
+
+    int outcome = SIM_RUNNING, diverged = -1;
+    long tick = 0;
+    int per_stage = ticks / SPAWN_STAGES > 0 ? ticks / SPAWN_STAGES : 1;
+    int n_handles = 0;
+    for (int stage = 0; stage < SPAWN_STAGES && outcome == SIM_RUNNING && diverged < 0; stage++) {
+        for (int i = 0; i < live->n_nests; i++)
+            live->nests[i].max = (live->nests[i].slots * stage_eighths[stage] + 7) / 8;
+        long despawned = 0, stale = 0, spawned = 0, live_sum = 0;
+        lower_nests(live, &ref, handles, n_handles, &despawned, &stale);
+
+        struct timespec t0, t1;
+        double engine_s = 0;
+        int t = 0;
+        for (; t < per_stage && outcome == SIM_RUNNING; t++, tick++) {
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            outcome = tick_step(&engine);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            engine_s += elapsed_s(&t0, &t1);
+            spawned += engine.n_spawned;
+            live_sum += live_ghosts(live);
+            if (t == per_stage / 2) {
+                // Handles dos vivos a meio da fase, usados no início da seguinte
+                n_handles = 0;
+                for (int g = live->spawn_base; g < live->n_ghosts; g++) {
+                    ghost_handle_t h = ghost_handle(live, g);
+                    if (h != GHOST_NONE) handles[n_handles++] = h;
+                }
+            }
+
+            int expected = sim_step(&ref);
+            if (!comparable) continue;
+            tick_sync(&engine);
+            if (outcome != expected || live->hash != ref.hash) { diverged = (int)tick + 1; break; }
+        }
+        printf("  %-5d %5d/8 %9.1f %12.2f %8ld %8ld %10ld\n", stage + 1, stage_eighths[stage],
+               t ? (double)live_sum / t : 0, t ? engine_s * 1e6 / t : 0, spawned, despawned, stale);
+    }
+    if (comparable && diverged < 0 && board_hash_full(live) != board_hash_full(&ref)) diverged = (int)tick;
+
+    printf("  %ld jogadas (%s), estados %s", tick,
+           sim_outcome_name(outcome == SIM_RUNNING ? SIM_TIMEOUT : outcome),
+           !comparable ? "não comparados (fantasmas sem script)" : diverged < 0 ? "iguais a sim_step" : "DIFERENTES");
+    if (diverged >= 0) printf(" (jogada %d)", diverged);
+    printf("\n");
+
+    tick_engine_free(&engine);
+    board_free_clone(&ref);
+    free(handles);
+    return diverged < 0 ? 0 : -1;
+}
+
+int spawn_bench_main(int argc, char** argv) {
+    if (argc < 2) { printf("Usage: %s <dir> [ticks]\n", argv[0]); return 1; }
+    const char* dir_path = argv[1];
+    int ticks = argc > 2 ? atoi(argv[2]) : 4500;
+    if (ticks <= 0) ticks = 4500;
+
+    struct dirent** namelist;
+    int n = scandir(dir_path, &namelist, filter_levels, alphasort);
+    if (n < 0) { perror("scandir"); return 1; }
+    srand(time(NULL));
+
+    int failed = 0;
+    for (int i = 0; i < n; i++) {
+        board_t level;
+        memset(&level, 0, sizeof(level));
+        if (load_level(&level, dir_path, namelist[i]->d_name, 0) != 0) printf("%s: nível rejeitado\n", namelist[i]->d_name);
+        else if (level.n_nests == 0) printf("%s: sem ninhos\n", namelist[i]->d_name);
+        else failed |= spawn_bench_level(&level, namelist[i]->d_name, ticks) != 0;
+        if (level.chunks) unload_level(&level);
+        free(namelist[i]);
+    }
+    free(namelist);
+    return failed ? 2 : 0;
+}
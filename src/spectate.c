@@ -0,0 +1,493 @@
+#include "spectate.h"
+#include "display.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SPEC_MAGIC 0x50414353u        // "SCAP"
+#define SPEC_RING_BYTES (1u << 22)    // Dados do anel (potência de 2)
+#define SPEC_MAX_RECORD (SPEC_RING_BYTES / 4)
+#define SPEC_KEYFRAME_INTERVAL 64     // Jogadas entre keyframes
+
+enum { REC_KEYFRAME = 1, REC_DELTA = 2 };
+
+// Código de uma casa: conteúdo (0 ' ', 1 'W', 2 'P', 3 'M') + ponto + portal
+#define CELL_DOT 4
+#define CELL_PORTAL 8
+
+typedef struct {
+    uint32_t magic;
+    uint32_t capacity;
+    _Atomic uint64_t head;        // Bytes publicados (monotónico)
+    _Atomic uint64_t reserve;     // Bytes que o produtor pode estar a escrever (>= head)
+    _Atomic uint64_t last_key;    // Posição do último keyframe completo
+    _Atomic uint64_t published;   // Jogadas publicadas
+    _Atomic int closed;
+    uint8_t data[];
+} spec_ring_t;
+
+typedef struct {
+    uint32_t size;  // Inclui este cabeçalho; múltiplo de 8
+    uint32_t type;
+    uint64_t tick;
+} spec_rec_t;
+
+typedef struct {
+    uint16_t width, height;
+    uint16_t n_pacmans, n_ghosts;
+    char level_name[56];
+} spec_key_t;   // Seguido de width*height códigos e dos agentes
+
+typedef struct {
+    uint32_t index;
+    uint8_t code;
+    uint8_t pad[3];
+} spec_cell_t;
+
+typedef struct {
+    int16_t x, y;
+    uint16_t id;    // Pacmans primeiro, depois fantasmas
+    uint8_t flags;  // 1 = vivo (fantasma: no tabuleiro), 2 = carregado
+    uint8_t pad;
+    int32_t points;
+} spec_agent_t;
+
+typedef struct {
+    uint32_t n_cells, n_agents;
+} spec_delta_t;  // Seguido de n_cells spec_cell_t e n_agents spec_agent_t
+
+struct spec_pub {
+    char name[256];
+    spec_ring_t* ring;
+    size_t map_size;
+    int force_key;
+    uint64_t last_key_tick;
+    // Último estado publicado (para os deltas)
+    int width, height, n_pacmans, n_ghosts;
+    uint8_t* cells;
+    spec_agent_t* agents;
+    // Área de trabalho para montar um registo
+    uint8_t* scratch;
+    size_t scratch_cap;
+};
+
+static uint8_t cell_code(const board_pos_t* cell) {
+    uint8_t code = 0;
+    switch (cell->content) {
+        case 'W': code = 1; break;
+        case 'P': code = 2; break;
+        case 'M': code = 3; break;
+    }
+    if (cell->has_dot) code |= CELL_DOT;
+    if (cell->has_portal) code |= CELL_PORTAL;
+    return code;
+}
+
+static spec_agent_t agent_state(const board_t* board, int id) {
+    spec_agent_t a;
+    memset(&a, 0, sizeof(a));
+    a.id = (uint16_t)id;
+    if (id < board->n_pacmans) {
+        const pacman_t* pac = &board->pacmans[id];
+        a.x = (int16_t)pac->pos_x;
+        a.y = (int16_t)pac->pos_y;
+        a.flags = pac->alive ? 1 : 0;
+        a.points = pac->points;
+    }
+    else {
+        const ghost_t* ghost = &board->ghosts[id - board->n_pacmans];
+        a.x = (int16_t)ghost->pos_x;
+        a.y = (int16_t)ghost->pos_y;
+        a.flags = (ghost->active ? 1 : 0) | (ghost->charged ? 2 : 0);
+    }
+    return a;
+}
+
+// Cópia para/de o anel com a volta no fim dos dados
+static void ring_write(spec_ring_t* ring, uint64_t pos, const void* src, size_t n) {
+    size_t off = pos & (ring->capacity - 1);
+    size_t first = ring->capacity - off < n ? ring->capacity - off : n;
+    memcpy(ring->data + off, src, first);
+    memcpy(ring->data, (const uint8_t*)src + first, n - first);
+}
+
+static void ring_read(const spec_ring_t* ring, uint64_t pos, void* dst, size_t n) {
+    size_t off = pos & (ring->capacity - 1);
+    size_t first = ring->capacity - off < n ? ring->capacity - off : n;
+    memcpy(dst, ring->data + off, first);
+    memcpy((uint8_t*)dst + first, ring->data, n - first);
+}
+
+// ==================================================================
+// PRODUTOR
+// ==================================================================
+spec_pub_t* spec_publish_open(const char* name) {
+    spec_pub_t* pub = calloc(1, sizeof(spec_pub_t));
+    if (!pub) return NULL;
+    snprintf(pub->name, sizeof(pub->name), "/%s", name);
+    pub->map_size = sizeof(spec_ring_t) + SPEC_RING_BYTES;
+
+    shm_unlink(pub->name);
+    int fd = shm_open(pub->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, pub->map_size) != 0) {
+        debug("[SPECTATE] %s: %s\n", pub->name, strerror(errno));
+        if (fd >= 0) close(fd);
+        free(pub);
+        return NULL;
+    }
+    pub->ring = mmap(NULL, pub->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pub->ring == MAP_FAILED) {
+        shm_unlink(pub->name);
+        free(pub);
+        return NULL;
+    }
+
+    pub->ring->capacity = SPEC_RING_BYTES;
+    atomic_store(&pub->ring->head, 0);
+    atomic_store(&pub->ring->reserve, 0);
+    atomic_store(&pub->ring->last_key, 0);
+    atomic_store(&pub->ring->published, 0);
+    atomic_store(&pub->ring->closed, 0);
+    // O magic só aparece com o cabeçalho pronto
+    atomic_thread_fence(memory_order_release);
+    pub->ring->magic = SPEC_MAGIC;
+    pub->force_key = 1;
+    return pub;
+}
+
+void spec_publish_reset(spec_pub_t* pub) {
+    if (pub) pub->force_key = 1;
+}
+
+static uint8_t* scratch_reserve(spec_pub_t* pub, size_t size) {
+    if (size > pub->scratch_cap) {
+        uint8_t* s = realloc(pub->scratch, size);
+        if (!s) return NULL;
+        pub->scratch = s;
+        pub->scratch_cap = size;
+    }
+    return pub->scratch;
+}
+
+// Escreve o registo montado em scratch; os leitores só o veem depois de head avançar
+static void publish_record(spec_pub_t* pub, size_t size, int is_key) {
+    spec_ring_t* ring = pub->ring;
+    uint64_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    // Anunciar primeiro a zona que vai ser reescrita: um leitor que a esteja a copiar descarta-a
+    atomic_store_explicit(&ring->reserve, pos + size, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    ring_write(ring, pos, pub->scratch, size);
+    atomic_store_explicit(&ring->head, pos + size, memory_order_release);
+    if (is_key) atomic_store_explicit(&ring->last_key, pos, memory_order_release);
+}
+
+/* Acrescenta ao delta a casa (x, y) se mudou desde o último estado publicado.
+   Devolve 1 se o delta já não cabe em max */
+static int delta_cell(spec_pub_t* pub, const board_t* board, int x, int y, uint8_t* buf, size_t* off,
+                      size_t max, spec_delta_t* delta) {
+    if (x < 0 || y < 0 || x >= board->width || y >= board->height) return 0;
+    size_t i = get_board_index(board, x, y);
+    uint8_t code = cell_code(board_at(board, x, y));
+    if (code == pub->cells[i]) return 0;
+    if (*off + sizeof(spec_cell_t) > max) return 1;
+    spec_cell_t c = { (uint32_t)i, code, {0, 0, 0} };
+    memcpy(buf + *off, &c, sizeof(c));
+    *off += sizeof(c);
+    delta->n_cells++;
+    pub->cells[i] = code;
+    return 0;
+}
+
+void spec_publish(spec_pub_t* pub, const board_t* board) {
+    if (!pub) return;
+    size_t cells = get_board_index(board, 0, board->height);
+    int agents = board->n_pacmans + board->n_ghosts;
+    uint64_t tick = atomic_fetch_add(&pub->ring->published, 1) + 1;
+
+    size_t key_size = (sizeof(spec_rec_t) + sizeof(spec_key_t) + cells + agents * sizeof(spec_agent_t) + 7) & ~(size_t)7;
+    if (key_size > SPEC_MAX_RECORD) return; // Tabuleiro grande demais para o anel
+
+    if (pub->width != board->width || pub->height != board->height ||
+        pub->n_pacmans != board->n_pacmans || pub->n_ghosts != board->n_ghosts) {
+        uint8_t* c = realloc(pub->cells, cells ? cells : 1);
+        spec_agent_t* a = realloc(pub->agents, (agents ? agents : 1) * sizeof(spec_agent_t));
+        if (c) pub->cells = c;
+        if (a) pub->agents = a;
+        if (!c || !a) return;
+        pub->width = board->width;
+        pub->height = board->height;
+        pub->n_pacmans = board->n_pacmans;
+        pub->n_ghosts = board->n_ghosts;
+        pub->force_key = 1;
+    }
+
+    int key = pub->force_key || tick - pub->last_key_tick >= SPEC_KEYFRAME_INTERVAL;
+    if (!key) {
+        // Delta contra o último estado publicado; se sair maior que um keyframe, manda o keyframe
+        uint8_t* buf = scratch_reserve(pub, key_size + sizeof(spec_delta_t));
+        if (!buf) return;
+        spec_delta_t delta = { 0, 0 };
+        size_t off = sizeof(spec_rec_t) + sizeof(spec_delta_t);
+        size_t max = key_size;
+
+        // Só mudam casas debaixo de agentes: a de partida e a de chegada de cada agente
+        // que mudou, como no jornal. A de cada Pacman vivo e as vizinhas também, porque
+        // ao entrar no portal as casas mudam e a posição não
+        int full = 0;
+        for (int i = 0; i < agents && !full; i++) {
+            spec_agent_t a = agent_state(board, i);
+            if (memcmp(&a, &pub->agents[i], sizeof(a)) == 0) continue;
+            full |= delta_cell(pub, board, pub->agents[i].x, pub->agents[i].y, buf, &off, max, &delta);
+            full |= delta_cell(pub, board, a.x, a.y, buf, &off, max, &delta);
+        }
+        for (int p = 0; p < board->n_pacmans && !full; p++) {
+            const pacman_t* pac = &board->pacmans[p];
+            if (!pac->alive) continue;
+            full |= delta_cell(pub, board, pac->pos_x, pac->pos_y, buf, &off, max, &delta);
+            full |= delta_cell(pub, board, pac->pos_x - 1, pac->pos_y, buf, &off, max, &delta);
+            full |= delta_cell(pub, board, pac->pos_x + 1, pac->pos_y, buf, &off, max, &delta);
+            full |= delta_cell(pub, board, pac->pos_x, pac->pos_y - 1, buf, &off, max, &delta);
+            full |= delta_cell(pub, board, pac->pos_x, pac->pos_y + 1, buf, &off, max, &delta);
+        }
+        for (int i = 0; i < agents && !full && off + sizeof(spec_agent_t) <= max; i++) {
+            spec_agent_t a = agent_state(board, i);
+            if (memcmp(&a, &pub->agents[i], sizeof(a)) == 0) continue;
+            memcpy(buf + off, &a, sizeof(a));
+            off += sizeof(a);
+            delta.n_agents++;
+            pub->agents[i] = a;
+        }
+
+        if (!full && off + sizeof(spec_agent_t) <= max) {
+            size_t size = (off + 7) & ~(size_t)7;
+            spec_rec_t rec = { (uint32_t)size, REC_DELTA, tick };
+            memcpy(buf, &rec, sizeof(rec));
+            memcpy(buf + sizeof(rec), &delta, sizeof(delta));
+            publish_record(pub, size, 0);
+            return;
+        }
+        // O delta encheu: a sombra ficou a meio, o keyframe repõe tudo
+    }
+
+    uint8_t* buf = scratch_reserve(pub, key_size);
+    if (!buf) return;
+    memset(buf, 0, key_size);
+    spec_rec_t rec = { (uint32_t)key_size, REC_KEYFRAME, tick };
+    spec_key_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.width = (uint16_t)board->width;
+    hdr.height = (uint16_t)board->height;
+    hdr.n_pacmans = (uint16_t)board->n_pacmans;
+    hdr.n_ghosts = (uint16_t)board->n_ghosts;
+    size_t name_len = strnlen(board->level_name, sizeof(hdr.level_name) - 1);
+    memcpy(hdr.level_name, board->level_name, name_len); // O resto já está a zero
+
+    size_t off = 0;
+    memcpy(buf + off, &rec, sizeof(rec)); off += sizeof(rec);
+    memcpy(buf + off, &hdr, sizeof(hdr)); off += sizeof(hdr);
+    for (int y = 0; y < board->height; y++) {
+        for (int x = 0; x < board->width; x++, off++) {
+            size_t i = get_board_index(board, x, y);
+            pub->cells[i] = buf[off] = cell_code(board_at(board, x, y));
+        }
+    }
+    for (int i = 0; i < agents; i++) {
+        pub->agents[i] = agent_state(board, i);
+        memcpy(buf + off, &pub->agents[i], sizeof(spec_agent_t));
+        off += sizeof(spec_agent_t);
+    }
+    publish_record(pub, key_size, 1);
+    pub->force_key = 0;
+    pub->last_key_tick = tick;
+}
+
+void spec_publish_close(spec_pub_t* pub) {
+    if (!pub) return;
+    atomic_store(&pub->ring->closed, 1);
+    munmap(pub->ring, pub->map_size);
+    shm_unlink(pub->name);
+    free(pub->cells);
+    free(pub->agents);
+    free(pub->scratch);
+    free(pub);
+}
+
+// ==================================================================
+// ESPECTADOR
+// ==================================================================
+typedef struct {
+    board_t view;     // Só o necessário para o draw_board
+    uint64_t tick;
+    int have_key;
+    long skipped;     // Keyframes a que saltou por ter ficado para trás
+} spectator_t;
+
+static int view_resize(board_t* view, const spec_key_t* hdr) {
+    if (!view->chunks || view->width != hdr->width || view->height != hdr->height) {
+        board_free_cells(view);
+        if (board_alloc_cells(view, hdr->width, hdr->height) != 0) return -1;
+    }
+    pacman_t* p = realloc(view->pacmans, (hdr->n_pacmans ? hdr->n_pacmans : 1) * sizeof(pacman_t));
+    ghost_t* g = realloc(view->ghosts, (hdr->n_ghosts ? hdr->n_ghosts : 1) * sizeof(ghost_t));
+    if (p) view->pacmans = p;
+    if (g) view->ghosts = g;
+    if (!p || !g) return -1;
+    view->width = hdr->width;
+    view->height = hdr->height;
+    view->n_pacmans = hdr->n_pacmans;
+    view->n_ghosts = hdr->n_ghosts;
+    memset(view->pacmans, 0, view->n_pacmans * sizeof(pacman_t));
+    memset(view->ghosts, 0, view->n_ghosts * sizeof(ghost_t));
+    snprintf(view->level_name, sizeof(view->level_name), "%s", hdr->level_name);
+    return 0;
+}
+
+static void view_set_cell(board_t* view, uint32_t index, uint8_t code) {
+    if (index >= get_board_index(view, 0, view->height)) return;
+    static const char contents[] = { ' ', 'W', 'P', 'M' };
+    int x = index % view->width, y = index / view->width;
+    // Uma parede onde já há parede não precisa de bloco próprio
+    if (code == 1 && board_at(view, x, y)->content == 'W') return;
+    board_pos_t* cell = board_at_mut(view, x, y);
+    if (!cell) return;
+    cell->content = contents[code & 3];
+    cell->has_dot = (code & CELL_DOT) != 0;
+    cell->has_portal = (code & CELL_PORTAL) != 0;
+}
+
+static void view_set_agent(board_t* view, const spec_agent_t* a) {
+    if (a->id < view->n_pacmans) {
+        pacman_t* pac = &view->pacmans[a->id];
+        pac->pos_x = a->x;
+        pac->pos_y = a->y;
+        pac->alive = a->flags & 1;
+        pac->points = a->points;
+    }
+    else if (a->id - view->n_pacmans < view->n_ghosts) {
+        ghost_t* ghost = &view->ghosts[a->id - view->n_pacmans];
+        ghost->pos_x = a->x;
+        ghost->pos_y = a->y;
+        ghost->active = a->flags & 1;
+        ghost->charged = (a->flags & 2) != 0;
+    }
+}
+
+static void apply_record(spectator_t* sp, const uint8_t* rec_buf) {
+    spec_rec_t rec;
+    memcpy(&rec, rec_buf, sizeof(rec));
+    const uint8_t* p = rec_buf + sizeof(rec);
+
+    if (rec.type == REC_KEYFRAME) {
+        spec_key_t hdr;
+        memcpy(&hdr, p, sizeof(hdr));
+        p += sizeof(hdr);
+        if (view_resize(&sp->view, &hdr) != 0) return;
+        int cells = hdr.width * hdr.height;
+        for (int i = 0; i < cells; i++) view_set_cell(&sp->view, i, p[i]);
+        p += cells;
+        for (int i = 0; i < hdr.n_pacmans + hdr.n_ghosts; i++, p += sizeof(spec_agent_t)) {
+            spec_agent_t a;
+            memcpy(&a, p, sizeof(a));
+            view_set_agent(&sp->view, &a);
+        }
+        sp->have_key = 1;
+    }
+    else if (rec.type == REC_DELTA && sp->have_key) {
+        spec_delta_t delta;
+        memcpy(&delta, p, sizeof(delta));
+        p += sizeof(delta);
+        for (uint32_t i = 0; i < delta.n_cells; i++, p += sizeof(spec_cell_t)) {
+            spec_cell_t c;
+            memcpy(&c, p, sizeof(c));
+            view_set_cell(&sp->view, c.index, c.code);
+        }
+        for (uint32_t i = 0; i < delta.n_agents; i++, p += sizeof(spec_agent_t)) {
+            spec_agent_t a;
+            memcpy(&a, p, sizeof(a));
+            view_set_agent(&sp->view, &a);
+        }
+    }
+    sp->tick = rec.tick;
+}
+
+// Lê tudo o que foi publicado desde pos; devolve a nova posição
+static uint64_t spectator_catch_up(spectator_t* sp, const spec_ring_t* ring, uint64_t pos, uint8_t* buf) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    while (pos < head) {
+        spec_rec_t rec;
+        ring_read(ring, pos, &rec, sizeof(rec));
+        int sane = rec.size >= sizeof(rec) && rec.size <= SPEC_MAX_RECORD && pos + rec.size <= head;
+        if (sane) ring_read(ring, pos, buf, rec.size);
+
+        // Se o produtor já pode ter reescrito o que copiámos, saltar para o último keyframe
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t reserve = atomic_load_explicit(&ring->reserve, memory_order_relaxed);
+        if (!sane || reserve - pos > ring->capacity) {
+            pos = atomic_load_explicit(&ring->last_key, memory_order_acquire);
+            head = atomic_load_explicit(&ring->head, memory_order_acquire);
+            sp->have_key = 0;
+            sp->skipped++;
+            continue;
+        }
+        apply_record(sp, buf);
+        pos += rec.size;
+    }
+    return pos;
+}
+
+int spectate_main(int argc, char** argv) {
+    if (argc < 2) { printf("Usage: %s <name>\n", argv[0]); return 1; }
+    char name[256];
+    snprintf(name, sizeof(name), "/%s", argv[1]);
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(spec_ring_t)) {
+        fprintf(stderr, "%s: nenhum jogo publicado com este nome\n", argv[1]);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    const spec_ring_t* ring = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED || ring->magic != SPEC_MAGIC) {
+        fprintf(stderr, "%s: anel inválido\n", argv[1]);
+        return 1;
+    }
+
+    spectator_t sp;
+    memset(&sp, 0, sizeof(sp));
+    uint8_t* buf = malloc(SPEC_MAX_RECORD);
+    uint64_t pos = atomic_load_explicit(&ring->last_key, memory_order_acquire);
+
+    terminal_init();
+    while (buf && !atomic_load(&ring->closed)) {
+        pos = spectator_catch_up(&sp, ring, pos, buf);
+        if (sp.have_key) {
+            draw_board(&sp.view, DRAW_MENU);
+            draw_text(1, 5, "Spectating %s | Level: %s | tick %lu | Q to quit", argv[1],
+                      sp.view.level_name, (unsigned long)sp.tick);
+            refresh_screen();
+        }
+        char key = get_input();
+        if (key == 'Q') break;
+        if (key == 'N') toggle_minimap();
+        sleep_ms(33);
+    }
+    terminal_cleanup();
+    printf("%s: %lu jogadas vistas, %ld saltos para keyframe\n", argv[1], (unsigned long)sp.tick, sp.skipped);
+
+    free(buf);
+    board_free_cells(&sp.view);
+    free(sp.view.pacmans);
+    free(sp.view.ghosts);
+    munmap((void*)ring, st.st_size);
+    return 0;
+}
@@ -0,0 +1,353 @@
+#include "stream.h"
+#include "files.h"
+#include "sim.h"
+#include "ttable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+// Um nível da fila: carregado (board) ou rejeitado (board == NULL)
+typedef struct {
+    board_t* board;
+    char name[256];
+} streamed_level_t;
+
+struct level_stream {
+    int fd;
+    int stop_fd;                 // eventfd: acorda a leitura para fechar
+    char* buf;                   // Bytes lidos ainda por partir em linhas
+    size_t start, len, cap;
+    int eof;
+
+    pthread_t reader;
+    int has_reader;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;      // A fila mudou ou a leitura acabou
+    streamed_level_t* queue;     // Anel de 'ahead' níveis
+    int ahead, head, count;
+    int done;                    // Não vêm mais níveis
+    int closing;
+
+    long n_levels, n_rejected;
+    double load_ms;              // Na thread de leitura, a carregar níveis
+    double wait_ms;              // Em stream_next, à espera de um nível
+};
+
+static double elapsed_ms(const struct timespec* t0, const struct timespec* t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1e3 + (t1->tv_nsec - t0->tv_nsec) / 1e6;
+}
+
+// ==================================================================
+// LEITURA DOS QUADROS
+// ==================================================================
+/* Próxima linha (sem o '\n', terminada em '\0'), válida até à leitura seguinte.
+   NULL no fim da stream ou quando a stream fecha */
+static char* read_line(level_stream_t* stream, size_t* line_len) {
+    for (;;) {
+        char* line = stream->buf + stream->start;
+        char* eol = memchr(line, '\n', stream->len - stream->start);
+        if (eol || (stream->eof && stream->start < stream->len)) {
+            size_t n = eol ? (size_t)(eol - line) : stream->len - stream->start;
+            line[n] = '\0'; // Sem '\n' no fim: há sempre espaço (cap > len)
+            stream->start += eol ? n + 1 : n;
+            if (n > 0 && line[n - 1] == '\r') line[--n] = '\0';
+            *line_len = n;
+            return line;
+        }
+        if (stream->eof) return NULL;
+
+        // Linha incompleta: vai para o início do buffer e lê-se mais
+        memmove(stream->buf, stream->buf + stream->start, stream->len - stream->start);
+        stream->len -= stream->start;
+        stream->start = 0;
+        if (stream->cap - stream->len < 4096) {
+            size_t cap = 2 * stream->cap;
+            char* buf = realloc(stream->buf, cap);
+            if (!buf) return NULL;
+            stream->buf = buf;
+            stream->cap = cap;
+        }
+
+        struct pollfd fds[2] = { { stream->fd, POLLIN, 0 }, { stream->stop_fd, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return NULL;
+        }
+        if (fds[1].revents & POLLIN) return NULL;
+        ssize_t got = read(stream->fd, stream->buf + stream->len, stream->cap - stream->len - 1);
+        if (got < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (got <= 0) stream->eof = 1;
+        else stream->len += got;
+    }
+}
+
+// Nome depois da diretiva ("@@LEVEL nome"), sem espaços à volta; NULL se não tem
+static const char* directive_name(char* line, const char* directive) {
+    size_t n = strlen(directive);
+    if (strncmp(line, directive, n) != 0 || (line[n] != ' ' && line[n] != '\t')) return NULL;
+    char* name = line + n;
+    while (*name == ' ' || *name == '\t') name++;
+    char* end = name + strlen(name);
+    while (end > name && (end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+    return *name ? name : NULL;
+}
+
+typedef struct {
+    char* data;
+    size_t len, cap;
+} text_t;
+
+static int text_append(text_t* text, const char* line, size_t n) {
+    if (text->len + n + 1 > text->cap) {
+        size_t cap = text->cap ? text->cap : 1024;
+        while (cap < text->len + n + 1) cap *= 2;
+        char* data = realloc(text->data, cap);
+        if (!data) return -1;
+        text->data = data;
+        text->cap = cap;
+    }
+    memcpy(text->data + text->len, line, n);
+    text->len += n;
+    text->data[text->len++] = '\n';
+    return 0;
+}
+
+// O ficheiro que estava a ser lido entra no pacote (o pacote fica com o texto)
+static int close_file(level_bundle_t* bundle, const char* name, text_t* text) {
+    int rc = bundle_add_file(bundle, name, text->data, text->len);
+    if (rc != 0) free(text->data);
+    memset(text, 0, sizeof(*text));
+    return rc;
+}
+
+/* Lê o próximo nível inteiro (de @@LEVEL a @@END) para bundle. 1 se leu um nível,
+   0 no fim da stream */
+static int read_level(level_stream_t* stream, level_bundle_t* bundle, char* level_name, size_t name_len) {
+    char file[256] = "";  // Ficheiro a ser lido ("" fora de um nível)
+    text_t text = { NULL, 0, 0 };
+    char* line;
+    size_t n;
+    while ((line = read_line(stream, &n))) {
+        if (line[0] == '@' && line[1] == '@') {
+            const char* name;
+            if ((name = directive_name(line, "@@LEVEL"))) {
+                if (*file) debug("[STREAM] %s: nível sem @@END\n", level_name);
+                free(text.data);
+                memset(&text, 0, sizeof(text));
+                bundle_free(bundle);
+                snprintf(level_name, name_len, "%s", name);
+                snprintf(file, sizeof(file), "%s", name);
+            }
+            else if (!*file) continue;
+            else if ((name = directive_name(line, "@@FILE"))) {
+                close_file(bundle, file, &text);
+                snprintf(file, sizeof(file), "%s", name);
+            }
+            else if (strcmp(line, "@@END") == 0) {
+                close_file(bundle, file, &text);
+                return 1;
+            }
+            else debug("[STREAM] %s: diretiva desconhecida '%s'\n", level_name, line);
+            continue;
+        }
+        // Sem memória o ficheiro fica cortado e o nível é rejeitado ao carregar
+        if (*file) text_append(&text, line, n);
+    }
+    if (*file) debug("[STREAM] %s: a stream acabou a meio do nível\n", level_name);
+    free(text.data);
+    bundle_free(bundle);
+    return 0;
+}
+
+// ==================================================================
+// THREAD DE LEITURA
+// ==================================================================
+static void* reader_thread(void* arg) {
+    level_stream_t* stream = arg;
+    level_bundle_t bundle = { NULL, 0, 0 };
+    streamed_level_t level;
+    while (read_level(stream, &bundle, level.name, sizeof(level.name))) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        level.board = calloc(1, sizeof(board_t));
+        if (level.board && load_level_bundle(level.board, &bundle, level.name, 0) != 0) {
+            board_free_cells(level.board);
+            free(level.board);
+            level.board = NULL;
+        }
+        bundle_free(&bundle);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        pthread_mutex_lock(&stream->lock);
+        while (stream->count == stream->ahead && !stream->closing)
+            pthread_cond_wait(&stream->changed, &stream->lock);
+        if (stream->closing) {
+            pthread_mutex_unlock(&stream->lock);
+            if (level.board) { unload_level(level.board); free(level.board); }
+            break;
+        }
+        stream->queue[(stream->head + stream->count++) % stream->ahead] = level;
+        stream->n_levels++;
+        stream->load_ms += elapsed_ms(&t0, &t1);
+        pthread_cond_broadcast(&stream->changed);
+        pthread_mutex_unlock(&stream->lock);
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    stream->done = 1;
+    pthread_cond_broadcast(&stream->changed);
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+level_stream_t* stream_open(const char* path, int ahead) {
+    level_stream_t* stream = calloc(1, sizeof(level_stream_t));
+    if (!stream) return NULL;
+    stream->ahead = ahead > 0 ? ahead : STREAM_AHEAD;
+    stream->queue = calloc(stream->ahead, sizeof(streamed_level_t));
+    stream->cap = 65536;
+    stream->buf = malloc(stream->cap);
+    stream->fd = strcmp(path, "-") == 0 ? dup(STDIN_FILENO) : open(path, O_RDONLY | O_CLOEXEC);
+    stream->stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (!stream->queue || !stream->buf || stream->fd < 0 || stream->stop_fd < 0) {
+        if (stream->fd >= 0) close(stream->fd);
+        if (stream->stop_fd >= 0) close(stream->stop_fd);
+        free(stream->queue);
+        free(stream->buf);
+        free(stream);
+        return NULL;
+    }
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->changed, NULL);
+    stream->has_reader = pthread_create(&stream->reader, NULL, reader_thread, stream) == 0;
+    if (!stream->has_reader) stream->done = 1;
+    return stream;
+}
+
+int stream_next(level_stream_t* stream, board_t* board, char* name, size_t name_len) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_mutex_lock(&stream->lock);
+    while (stream->count == 0 && !stream->done)
+        pthread_cond_wait(&stream->changed, &stream->lock);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    stream->wait_ms += elapsed_ms(&t0, &t1);
+    if (stream->count == 0) {
+        pthread_mutex_unlock(&stream->lock);
+        return -1;
+    }
+    streamed_level_t level = stream->queue[stream->head];
+    stream->head = (stream->head + 1) % stream->ahead;
+    stream->count--;
+    if (!level.board) stream->n_rejected++;
+    pthread_cond_broadcast(&stream->changed);
+    pthread_mutex_unlock(&stream->lock);
+
+    if (name) snprintf(name, name_len, "%s", level.name);
+    if (!level.board) return 1;
+    move_level(board, level.board);
+    free(level.board);
+    return 0;
+}
+
+void stream_close(level_stream_t* stream) {
+    if (!stream) return;
+    if (stream->has_reader) {
+        pthread_mutex_lock(&stream->lock);
+        stream->closing = 1;
+        pthread_cond_broadcast(&stream->changed);
+        pthread_mutex_unlock(&stream->lock);
+        uint64_t one = 1;
+        if (write(stream->stop_fd, &one, sizeof(one)) < 0) perror("eventfd");
+        pthread_join(stream->reader, NULL);
+    }
+    for (; stream->count > 0; stream->count--) {
+        streamed_level_t* level = &stream->queue[stream->head];
+        stream->head = (stream->head + 1) % stream->ahead;
+        if (level->board) { unload_level(level->board); free(level->board); }
+    }
+    pthread_mutex_destroy(&stream->lock);
+    pthread_cond_destroy(&stream->changed);
+    if (stream->fd >= 0) close(stream->fd);
+    if (stream->stop_fd >= 0) close(stream->stop_fd);
+    free(stream->queue);
+    free(stream->buf);
+    free(stream);
+}
+
+void stream_freeze(level_stream_t* stream) {
+    if (stream) pthread_mutex_lock(&stream->lock);
+}
+
+void stream_thaw(level_stream_t* stream) {
+    if (stream) pthread_mutex_unlock(&stream->lock);
+}
+
+void stream_detach(level_stream_t* stream) {
+    if (!stream) return;
+    // A thread de leitura ficou no pai; o cadeado vinha fechado pelo stream_freeze
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->changed, NULL);
+    stream->has_reader = 0;
+    stream->done = 1;
+    close(stream->fd);
+    close(stream->stop_fd);
+    stream->fd = stream->stop_fd = -1;
+}
+
+// ==================================================================
+// MODO --headless --stream
+// ==================================================================
+int stream_sim_main(int argc, char** argv) {
+    if (argc < 2) { printf("Usage: --headless %s <fifo|-> [max_ticks]\n", argv[0]); return 1; }
+    int max_ticks = (argc >= 3) ? atoi(argv[2]) : SIM_DEFAULT_MAX_TICKS;
+
+    level_stream_t* stream = stream_open(argv[1], STREAM_AHEAD);
+    if (!stream) { perror(argv[1]); return 1; }
+
+    srand(time(NULL));
+    ttable_t tt;
+    if (tt_init(&tt, 16) != 0) { stream_close(stream); return 1; }
+
+    struct timespec t0, t1;
+    double sim_ms = 0;
+    char name[256];
+    board_t board;
+    memset(&board, 0, sizeof(board));
+    int got;
+    while ((got = stream_next(stream, &board, name, sizeof(name))) >= 0) {
+        if (got == 1) {
+            printf("%s: rejected\n", name);
+            continue;
+        }
+        sim_result_t result;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        tt_clear(&tt);
+        sim_run_tt(&board, max_ticks, &tt, &result);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        sim_ms += elapsed_ms(&t0, &t1);
+
+        printf("%s: %s after %d ticks, %d points", name,
+               sim_outcome_name(result.outcome), result.ticks, result.points);
+        if (result.outcome == SIM_CYCLE)
+            printf(" (period %d from tick %d)", result.cycle_length, result.cycle_start);
+        printf("\n");
+        fflush(stdout); // Quem gera os níveis pode estar a ler os veredictos
+
+        unload_level(&board);
+    }
+
+    printf("stream: %ld levels (%ld rejected); load %.1f ms ahead, simulation %.1f ms, waited %.1f ms for input\n",
+           stream->n_levels, stream->n_rejected, stream->load_ms, sim_ms, stream->wait_ms);
+    stream_close(stream);
+    tt_free(&tt);
+    return 0;
+}
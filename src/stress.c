@@ -0,0 +1,169 @@
+#include "stress.h"
+#include "pool.h"
+#include "script.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define STRESS_WIDTH 160
+#define STRESS_HEIGHT 160
+#define STRESS_PACMANS 400
+#define STRESS_GHOSTS 200
+#define STRESS_MAX_THREADS 64
+
+typedef struct {
+    board_t* board;
+    int thread, n_threads;
+    int moves;
+    uint32_t rng;
+} stress_worker_t;
+
+static uint32_t next_rand(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// Os agentes de índice (Pacmans primeiro, depois fantasmas) a % n_threads == thread
+static void* stress_thread(void* arg) {
+    stress_worker_t* w = arg;
+    board_t* board = w->board;
+    int agents = board->n_pacmans + board->n_ghosts;
+    int own = (agents - w->thread + w->n_threads - 1) / w->n_threads;
+    const char dirs[4] = { 'W', 'A', 'S', 'D' };
+    for (int m = 0; m < w->moves && own > 0; m++) {
+        uint32_t r = next_rand(&w->rng);
+        int a = w->thread + (int)(r % own) * w->n_threads;
+        script_op_t op = script_move(dirs[(r >> 12) & 3]);
+        if (a < board->n_pacmans) {
+            move_pacman_shared(board, a, &op);
+            continue;
+        }
+        // De vez em quando uma carga: desliza na jogada seguinte até colidir
+        if (((r >> 16) & 15) == 0) {
+            script_op_t charge = { .op = OP_CHARGE, .count = 1 };
+            move_ghost_shared(board, a - board->n_pacmans, &charge);
+        }
+        move_ghost_shared(board, a - board->n_pacmans, &op);
+    }
+    return NULL;
+}
+
+// Campo aberto cheio de pontos, sem paredes nem portal; os agentes em casas espaçadas
+static int build_board(board_t* board) {
+    memset(board, 0, sizeof(*board));
+    if (board_alloc_cells(board, STRESS_WIDTH, STRESS_HEIGHT) != 0) return -1;
+    board->width = STRESS_WIDTH;
+    board->height = STRESS_HEIGHT;
+    for (int y = 0; y < board->height; y++) {
+        for (int x = 0; x < board->width; x++) {
+            board_pos_t* cell = board_at_mut(board, x, y);
+            cell->content = ' ';
+            cell->has_dot = 1;
+            cell->has_portal = 0;
+        }
+    }
+    board->n_pacmans = STRESS_PACMANS;
+    board->n_ghosts = STRESS_GHOSTS;
+    board->pacmans = calloc(board->n_pacmans, sizeof(pacman_t));
+    board->ghosts = calloc(board->n_ghosts, sizeof(ghost_t));
+    if (!board->pacmans || !board->ghosts) return -1;
+
+    int k = 0;
+    for (int p = 0; p < board->n_pacmans; p++, k += 7) {
+        pacman_t* pac = &board->pacmans[p];
+        pac->pos_x = k % board->width;
+        pac->pos_y = k / board->width;
+        pac->alive = 1;
+        pac->player = -1;
+        board_pos_t* cell = board_at_mut(board, pac->pos_x, pac->pos_y);
+        cell->content = 'P';
+        cell->has_dot = 0;
+    }
+    for (int g = 0; g < board->n_ghosts; g++, k += 7) {
+        ghost_t* ghost = &board->ghosts[g];
+        ghost->pos_x = k % board->width;
+        ghost->pos_y = (k / board->width) % board->height;
+        ghost->active = 1;
+        ghost->nest = -1;
+        board_at_mut(board, ghost->pos_x, ghost->pos_y)->content = 'M';
+    }
+    board_seed(board, 1);
+    board_rehash(board);
+    return 0;
+}
+
+static int count_dots(const board_t* board) {
+    int dots = 0;
+    for (int y = 0; y < board->height; y++)
+        for (int x = 0; x < board->width; x++) dots += board_at(board, x, y)->has_dot;
+    return dots;
+}
+
+// Confirma os invariantes e mostra-os; 0 se estão todos certos
+static int check_board(const board_t* board, int dots_before) {
+    int ghosts = 0, pacmans = 0, alive = 0, misplaced = 0, points = 0;
+    for (int y = 0; y < board->height; y++) {
+        for (int x = 0; x < board->width; x++) {
+            char content = board_at(board, x, y)->content;
+            ghosts += content == 'M';
+            pacmans += content == 'P';
+        }
+    }
+    for (int g = 0; g < board->n_ghosts; g++)
+        misplaced += board_at(board, board->ghosts[g].pos_x, board->ghosts[g].pos_y)->content != 'M';
+    for (int p = 0; p < board->n_pacmans; p++) {
+        const pacman_t* pac = &board->pacmans[p];
+        points += pac->points;
+        if (!pac->alive) continue;
+        alive++;
+        misplaced += board_at(board, pac->pos_x, pac->pos_y)->content != 'P';
+    }
+    int eaten = dots_before - count_dots(board);
+    int hash_ok = board->hash == board_hash_full(board);
+    printf("  'M' %d/%d fantasmas, 'P' %d/%d vivos, fora do sítio %d, comidos %d / pontos %d, hash %s\n",
+           ghosts, board->n_ghosts, pacmans, alive, misplaced, eaten, points, hash_ok ? "igual" : "DIFERENTE");
+    return !(ghosts == board->n_ghosts && pacmans == alive && misplaced == 0 && eaten == points && hash_ok);
+}
+
+static void free_board(board_t* board) {
+    board_free_cells(board);
+    free(board->pacmans);
+    free(board->ghosts);
+}
+
+int cas_stress_main(int argc, char** argv) {
+    int n_threads = argc > 1 ? atoi(argv[1]) : 0;
+    int moves = argc > 2 ? atoi(argv[2]) : 5000;
+    int runs = argc > 3 ? atoi(argv[3]) : 10;
+    if (n_threads <= 0) n_threads = pool_default_threads() > 2 ? pool_default_threads() : 2;
+    if (n_threads > STRESS_MAX_THREADS) n_threads = STRESS_MAX_THREADS;
+    if (moves <= 0 || runs <= 0) { printf("Usage: %s [threads] [moves] [runs]\n", argv[0]); return 1; }
+
+    int failed = 0;
+    for (int run = 0; run < runs; run++) {
+        board_t board;
+        if (build_board(&board) != 0) { perror("calloc"); free_board(&board); return 1; }
+        int dots_before = count_dots(&board);
+
+        pthread_t threads[STRESS_MAX_THREADS];
+        stress_worker_t workers[STRESS_MAX_THREADS];
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int t = 0; t < n_threads; t++) {
+            workers[t] = (stress_worker_t){ &board, t, n_threads, moves, 12345u + 977u * run + t };
+            pthread_create(&threads[t], NULL, stress_thread, &workers[t]);
+        }
+        for (int t = 0; t < n_threads; t++) pthread_join(threads[t], NULL);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+        printf("corrida %d: %d threads, %.2f M jogadas/s\n", run, n_threads,
+               (double)n_threads * moves / secs / 1e6);
+        failed += check_board(&board, dots_before);
+        free_board(&board);
+    }
+    printf("%d de %d corridas com invariantes falhados\n", failed, runs);
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,601 @@
+#include "tick.h"
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+// ==================================================================
+// AGENDA
+// ==================================================================
+static inline int wakes_before(const tick_engine_t* engine, int a, int b) {
+    return engine->wake[a] < engine->wake[b] || (engine->wake[a] == engine->wake[b] && a < b);
+}
+
+static void heap_push(tick_engine_t* engine, int agent) {
+    int i = engine->heap_len++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!wakes_before(engine, agent, engine->heap[parent])) break;
+        engine->heap[i] = engine->heap[parent];
+        i = parent;
+    }
+    engine->heap[i] = agent;
+}
+
+static int heap_pop(tick_engine_t* engine) {
+    int top = engine->heap[0];
+    int agent = engine->heap[--engine->heap_len];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= engine->heap_len) break;
+        if (child + 1 < engine->heap_len && wakes_before(engine, engine->heap[child + 1], engine->heap[child])) child++;
+        if (!wakes_before(engine, engine->heap[child], agent)) break;
+        engine->heap[i] = engine->heap[child];
+        i = child;
+    }
+    if (engine->heap_len > 0) engine->heap[i] = agent;
+    return top;
+}
+
+// Agentes que a agenda controla: fantasmas no tabuleiro e Pacmans vivos com script
+static int is_scheduled(const board_t* board, int agent) {
+    if (agent >= board->n_pacmans) return board->ghosts[agent - board->n_pacmans].active;
+    const pacman_t* pac = &board->pacmans[agent];
+    return pac->alive && pac->player < 0 && pac->n_code > 0;
+}
+
+static long agent_idle_ticks(const board_t* board, int agent) {
+    return agent < board->n_pacmans ? pacman_idle_ticks(board, agent)
+                                    : ghost_idle_ticks(board, agent - board->n_pacmans);
+}
+
+// Agenda o agente depois de a jogada 'tick' já estar aplicada ao seu estado
+static void schedule(tick_engine_t* engine, int agent, long tick) {
+    if (!is_scheduled(engine->board, agent)) {
+        engine->wake[agent] = -1;
+        return;
+    }
+    engine->last[agent] = tick;
+    engine->wake[agent] = tick + 1 + agent_idle_ticks(engine->board, agent);
+    heap_push(engine, agent);
+}
+
+// Aplica as jogadas de espera que o agente dormiu até 'tick' (exclusive)
+static void catch_up(tick_engine_t* engine, int agent, long tick) {
+    board_t* board = engine->board;
+    long n = tick - engine->last[agent] - 1;
+    if (n <= 0) return;
+    if (agent < board->n_pacmans) skip_pacman_ticks(board, agent, n);
+    else skip_ghost_ticks(board, agent - board->n_pacmans, n);
+    engine->last[agent] = tick - 1;
+}
+
+// Refaz o heap só com os agentes que continuam na agenda (wake >= 0)
+static void compact_agenda(tick_engine_t* engine) {
+    int n = engine->heap_len;
+    engine->heap_len = 0;
+    for (int k = 0; k < n; k++) {
+        int agent = engine->heap[k];
+        if (engine->wake[agent] >= 0) heap_push(engine, agent);
+    }
+}
+
+// Pacmans da agenda mortos por um fantasma nesta jogada: o estado fica como estava na
+// morte (um Pacman morto já não espera) e saem da agenda
+static void drop_dead_sleepers(tick_engine_t* engine, long tick) {
+    board_t* board = engine->board;
+    int dropped = 0;
+    for (int p = 0; p < board->n_pacmans; p++) {
+        if (board->pacmans[p].alive || engine->wake[p] < 0) continue;
+        catch_up(engine, p, tick + 1);
+        engine->wake[p] = -1;
+        dropped = 1;
+    }
+    if (dropped) compact_agenda(engine);
+}
+
+// Fantasmas a dormir que saem no fim desta jogada (despawn_ghost): a vaga volta ao
+// estado do início do script, por isso não há jogadas de espera a pôr em dia
+static void drop_leaving_sleepers(tick_engine_t* engine) {
+    board_t* board = engine->board;
+    int dropped = 0;
+    for (int k = 0; k < board->n_leaving; k++) {
+        int agent = board->n_pacmans + board->leaving[k];
+        if (engine->wake[agent] < 0) continue;
+        engine->wake[agent] = -1;
+        dropped = 1;
+    }
+    if (dropped) compact_agenda(engine);
+}
+
+void tick_reschedule(tick_engine_t* engine) {
+    int n_agents = engine->board->n_pacmans + engine->board->n_ghosts;
+    engine->heap_len = 0;
+    for (int i = 0; i < n_agents; i++) schedule(engine, i, engine->tick - 1);
+}
+
+void tick_sync(tick_engine_t* engine) {
+    for (int k = 0; k < engine->heap_len; k++) catch_up(engine, engine->heap[k], engine->tick);
+}
+
+long tick_idle(const tick_engine_t* engine) {
+    const board_t* board = engine->board;
+    for (int p = 0; p < board->n_pacmans; p++) {
+        if (board->pacmans[p].alive && board->pacmans[p].player >= 0) return 0;
+    }
+    if (engine->heap_len == 0) return -1;
+    long idle = engine->wake[engine->heap[0]] - engine->tick;
+    return idle > 0 ? idle : 0;
+}
+
+void tick_skip(tick_engine_t* engine, long n) {
+    if (n <= 0) return;
+    pthread_mutex_lock(&engine->board->board_lock);
+    engine->tick += n;
+    pthread_mutex_unlock(&engine->board->board_lock);
+}
+
+// ==================================================================
+// REGIÕES DA FASE DE RESOLUÇÃO
+// ==================================================================
+#define REGION_MIN_GHOSTS 64      // Abaixo disto a resolução fica numa só thread
+#define REGION_REBALANCE_TICKS 16 // Intervalo mínimo entre reequilíbrios
+
+static int regions_init(tick_regions_t* rg, const board_t* board, int n) {
+    memset(rg, 0, sizeof(*rg));
+    if (n > board->height) n = board->height;
+    if (n < 1) n = 1;
+    rg->n = n;
+    int ghosts = board->n_ghosts ? board->n_ghosts : 1;
+    rg->top = malloc(sizeof(int) * (n + 1));
+    rg->level = calloc(n, sizeof(int));
+    rg->load = calloc(n, sizeof(int));
+    rg->key = malloc(sizeof(int) * ghosts);
+    rg->agent = malloc(sizeof(int) * ghosts);
+    rg->items = malloc(sizeof(int) * ghosts);
+    rg->rows = malloc(sizeof(int) * ghosts);
+    if (!rg->top || !rg->level || !rg->load || !rg->key || !rg->agent || !rg->items || !rg->rows) return -1;
+    for (int r = 0; r <= n; r++) rg->top[r] = (int)((long)board->height * r / n);
+    return 0;
+}
+
+static void regions_free(tick_regions_t* rg) {
+    free(rg->top);
+    free(rg->level);
+    free(rg->load);
+    free(rg->key);
+    free(rg->agent);
+    free(rg->items);
+    free(rg->bucket);
+    free(rg->rows);
+    memset(rg, 0, sizeof(*rg));
+}
+
+// Faixa da linha y (top é crescente)
+static int region_of(const tick_regions_t* rg, int y) {
+    int lo = 0, hi = rg->n - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (rg->top[mid] <= y) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+static int by_value(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+// Fronteiras nos quantis das linhas dos fantasmas (cada faixa com pelo menos uma linha)
+static void regions_rebalance(tick_regions_t* rg, const board_t* board) {
+    int n = rg->n, g = 0;
+    for (int i = 0; i < board->n_ghosts; i++)
+        if (board->ghosts[i].active) rg->rows[g++] = board->ghosts[i].pos_y;
+    if (g == 0) return;
+    qsort(rg->rows, g, sizeof(int), by_value);
+    rg->top[0] = 0;
+    for (int r = 1; r < n; r++) {
+        int t = rg->rows[(long)g * r / n];
+        if (t < rg->top[r - 1] + 1) t = rg->top[r - 1] + 1;
+        if (t > board->height - (n - r)) t = board->height - (n - r);
+        rg->top[r] = t;
+    }
+    rg->top[n] = board->height;
+    rg->since_rebalance = 0;
+    rg->rebalances++;
+}
+
+// Tarefa da pool: uma faixa (as suas entradas do nível atual, por índice) ou uma passagem
+static void resolve_region_task(void* ctx, int task) {
+    tick_engine_t* engine = ctx;
+    tick_regions_t* rg = &engine->regions;
+    board_t* board = engine->board;
+    int queue = task < rg->n ? task : rg->n;
+    int b = rg->current * (rg->n + 1) + queue;
+    int begin = rg->bucket[b], end = rg->bucket[b + 1];
+    if (task >= rg->n) {
+        begin += task - rg->n;
+        end = begin + 1;
+    }
+    for (int j = begin; j < end; j++) {
+        int i = rg->items[j];
+        resolve_ghost(board, i - board->n_pacmans, &engine->intents[i]);
+    }
+}
+
+/* Resolve os fantasmas due[first..n_due) por regiões. Cada fantasma recebe um
+   nível: o da sua faixa, ou (passagem) um acima de todas as faixas que atravessa,
+   que a seguir ficam um nível acima dele. Os níveis correm um a um; dentro de um
+   nível as faixas e as passagens não partilham linhas. Devolve -1 se não vale a
+   pena (poucos fantasmas) ou falta memória: o chamador resolve em série */
+static int resolve_ghosts_by_region(tick_engine_t* engine, int first) {
+    tick_regions_t* rg = &engine->regions;
+    board_t* board = engine->board;
+    int n = rg->n;
+    if (n < 2 || engine->n_due - first < REGION_MIN_GHOSTS) return -1;
+
+    for (int r = 0; r < n; r++) rg->level[r] = rg->load[r] = 0;
+    int m = 0, n_levels = 1;
+    for (int k = first; k < engine->n_due; k++) {
+        int i = engine->due[k];
+        const intent_t* intent = &engine->intents[i];
+        if (!intent->move) continue;
+
+        int top, bottom;
+        ghost_footprint_rows(board, i - board->n_pacmans, intent, &top, &bottom);
+        int r0 = region_of(rg, top), r1 = region_of(rg, bottom);
+        int level, queue;
+        if (r0 == r1) {
+            level = rg->level[r0];
+            queue = r0;
+            rg->load[r0]++;
+        }
+        else {
+            level = 0;
+            for (int r = r0; r <= r1; r++) level = rg->level[r] > level ? rg->level[r] : level;
+            level++;
+            for (int r = r0; r <= r1; r++) rg->level[r] = level + 1;
+            queue = n;
+            rg->handoffs++;
+        }
+        if (level + 1 > n_levels) n_levels = level + 1;
+        rg->key[m] = level * (n + 1) + queue;
+        rg->agent[m] = i;
+        m++;
+    }
+
+    // Contagem por (nível, fila); as entradas de cada uma ficam por índice
+    int n_buckets = n_levels * (n + 1);
+    if (n_buckets + 1 > rg->bucket_cap) {
+        int* bucket = realloc(rg->bucket, sizeof(int) * (n_buckets + 1));
+        if (!bucket) return -1;
+        rg->bucket = bucket;
+        rg->bucket_cap = n_buckets + 1;
+    }
+    memset(rg->bucket, 0, sizeof(int) * (n_buckets + 1));
+    for (int j = 0; j < m; j++) rg->bucket[rg->key[j] + 1]++;
+    for (int b = 0; b < n_buckets; b++) rg->bucket[b + 1] += rg->bucket[b];
+    for (int j = 0; j < m; j++) rg->items[rg->bucket[rg->key[j]]++] = rg->agent[j];
+    for (int b = n_buckets; b > 0; b--) rg->bucket[b] = rg->bucket[b - 1];
+    rg->bucket[0] = 0;
+
+    for (int level = 0; level < n_levels; level++) {
+        int b = level * (n + 1);
+        int handoffs = rg->bucket[b + n + 1] - rg->bucket[b + n];
+        if (rg->bucket[b + n + 1] == rg->bucket[b]) continue;
+        rg->current = level;
+        pool_parallel_for(engine->pool, n + handoffs, resolve_region_task, engine);
+    }
+
+    // Reequilibrar quando uma faixa tem bastante mais fantasmas do que a média
+    int max_load = 0;
+    for (int r = 0; r < n; r++) max_load = rg->load[r] > max_load ? rg->load[r] : max_load;
+    if (++rg->since_rebalance >= REGION_REBALANCE_TICKS && 2 * max_load * n > 3 * m)
+        regions_rebalance(rg, board);
+    return 0;
+}
+
+// ==================================================================
+// MOTOR
+// ==================================================================
+int tick_engine_init(tick_engine_t* engine, board_t* board, int n_threads) {
+    int n_agents = board->n_pacmans + board->n_ghosts;
+    if (n_threads <= 0) n_threads = pool_default_threads();
+    if (n_threads > n_agents) n_threads = n_agents > 0 ? n_agents : 1;
+
+    engine->board = board;
+    engine->tick = 0;
+    engine->woken = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++) engine->keyboard[i] = script_move('\0');
+    engine->wander = script_random();
+    engine->ops = calloc(n_agents + 1, sizeof(script_op_t*));
+    engine->intents = calloc(n_agents + 1, sizeof(intent_t));
+    engine->wake = calloc(n_agents + 1, sizeof(long));
+    engine->last = calloc(n_agents + 1, sizeof(long));
+    engine->heap = calloc(n_agents + 1, sizeof(int));
+    engine->due = calloc(n_agents + 1, sizeof(int));
+    engine->spawned = calloc(board->n_nests + 1, sizeof(int));
+    engine->n_spawned = 0;
+    engine->pool = pool_create(n_threads);
+    if (!engine->ops || !engine->intents || !engine->wake || !engine->last ||
+        !engine->heap || !engine->due || !engine->spawned || !engine->pool) {
+        tick_engine_free(engine);
+        return -1;
+    }
+    engine->n_tasks = pool_size(engine->pool);
+    if (regions_init(&engine->regions, board, engine->n_tasks) != 0) {
+        tick_engine_free(engine);
+        return -1;
+    }
+    tick_reschedule(engine);
+    return 0;
+}
+
+void tick_engine_free(tick_engine_t* engine) {
+    if (engine->pool) pool_destroy(engine->pool);
+    regions_free(&engine->regions);
+    free(engine->ops);
+    free(engine->intents);
+    free(engine->wake);
+    free(engine->last);
+    free(engine->heap);
+    free(engine->due);
+    free(engine->spawned);
+    engine->pool = NULL;
+    engine->spawned = NULL;
+    engine->ops = NULL;
+    engine->intents = NULL;
+    engine->wake = engine->last = NULL;
+    engine->heap = engine->due = NULL;
+}
+
+// Instrução do Pacman nesta jogada: a tecla do jogador ou a do script ('G' e 'Q' tratados aqui)
+static int pick_pacman_command(tick_engine_t* engine, int p) {
+    board_t* board = engine->board;
+    pacman_t* pac = &board->pacmans[p];
+    engine->ops[p] = NULL;
+    if (!pac->alive) return SIM_RUNNING;
+
+    if (pac->player >= 0) {
+        // A tecla é tirada de uma vez: uma tecla nova entretanto fica para a jogada seguinte
+        char key = atomic_exchange(&pac->next_cmd, '\0');
+        if (key != '\0') {
+            engine->keyboard[pac->player] = script_move(key);
+            engine->ops[p] = &engine->keyboard[pac->player];
+        }
+        return SIM_RUNNING;
+    }
+    const script_op_t* op = pacman_op(board, p);
+    if (!op) return SIM_RUNNING;
+
+    if (op->op == OP_SAVE) {
+        // O Pacman gasta a jogada a pedir o save; a UI decide se o faz
+        board->save_request = 1;
+        skip_pacman_command(board, p);
+        return SIM_RUNNING;
+    }
+    if (op->op == OP_QUIT) return SIM_QUIT;
+    engine->ops[p] = op;
+    return SIM_RUNNING;
+}
+
+// Fase de decisão de um bloco contíguo dos agentes desta jogada
+static void plan_task(void* ctx, int task) {
+    tick_engine_t* engine = ctx;
+    board_t* board = engine->board;
+    int n_tasks = engine->n_tasks < engine->n_due ? engine->n_tasks : engine->n_due;
+    int begin = (int)((long)engine->n_due * task / n_tasks);
+    int end = (int)((long)engine->n_due * (task + 1) / n_tasks);
+
+    for (int k = begin; k < end; k++) {
+        int i = engine->due[k];
+        engine->intents[i].move = 0;
+        if (!engine->ops[i]) continue;
+        if (i < board->n_pacmans)
+            plan_pacman(board, i, engine->ops[i], &engine->intents[i]);
+        else
+            plan_ghost(board, i - board->n_pacmans, engine->ops[i], &engine->intents[i]);
+    }
+}
+
+// Fase de resolução: ordem fixa, com o tabuleiro exclusivo (a UI desenha entre jogadas)
+static int resolve_all(tick_engine_t* engine) {
+    board_t* board = engine->board;
+    int k = 0;
+    for (; k < engine->n_due && engine->due[k] < board->n_pacmans; k++) {
+        int p = engine->due[k];
+        if (resolve_pacman(board, p, &engine->intents[p]) == REACHED_PORTAL) return SIM_WIN;
+    }
+    int alive = 0;
+    for (int p = 0; p < board->n_pacmans; p++) alive |= board->pacmans[p].alive;
+    if (!alive) return SIM_DEATH;
+
+    if (resolve_ghosts_by_region(engine, k) != 0) {
+        for (; k < engine->n_due; k++) {
+            int i = engine->due[k];
+            resolve_ghost(board, i - board->n_pacmans, &engine->intents[i]);
+        }
+    }
+
+    // Saídas e ninhos; os que nascem entram na agenda no fim da jogada
+    drop_leaving_sleepers(engine);
+    engine->n_spawned = board_end_tick(board, engine->spawned);
+
+    // Morte passiva: um fantasma entrou na casa do último Pacman
+    for (int p = 0; p < board->n_pacmans; p++) {
+        if (board->pacmans[p].alive) return SIM_RUNNING;
+    }
+    return SIM_DEATH;
+}
+
+static int by_index(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+int tick_step(tick_engine_t* engine) {
+    board_t* board = engine->board;
+    long tick = engine->tick;
+    int outcome = SIM_RUNNING;
+    long applied = tick - 1; // Última jogada aplicada aos agentes desta volta
+    pthread_mutex_lock(&board->board_lock);
+    engine->n_spawned = 0;
+
+    // Quem joga: os jogadores e os agentes da agenda cuja vez chegou
+    engine->n_due = 0;
+    for (int p = 0; p < board->n_pacmans; p++) {
+        if (board->pacmans[p].alive && board->pacmans[p].player >= 0) engine->due[engine->n_due++] = p;
+    }
+    int first_scheduled = engine->n_due;
+    while (engine->heap_len > 0 && engine->wake[engine->heap[0]] <= tick) {
+        int agent = heap_pop(engine);
+        engine->wake[agent] = -1;
+        catch_up(engine, agent, tick);
+        engine->due[engine->n_due++] = agent;
+    }
+    engine->woken += engine->n_due - first_scheduled;
+    if (first_scheduled > 0) qsort(engine->due, engine->n_due, sizeof(int), by_index);
+
+    int k = 0;
+    for (; k < engine->n_due && engine->due[k] < board->n_pacmans && outcome == SIM_RUNNING; k++) {
+        outcome = pick_pacman_command(engine, engine->due[k]);
+    }
+    if (outcome != SIM_RUNNING) goto done;
+    for (; k < engine->n_due; k++) {
+        const script_op_t* op = ghost_op(board, engine->due[k] - board->n_pacmans);
+        engine->ops[engine->due[k]] = op ? op : &engine->wander;
+    }
+
+    if (engine->n_due > 0) {
+        int n_tasks = engine->n_tasks < engine->n_due ? engine->n_tasks : engine->n_due;
+        pool_parallel_for(engine->pool, n_tasks, plan_task, engine);
+    }
+
+    lock_all_rows(board);
+    outcome = resolve_all(engine);
+    unlock_all_rows(board);
+    drop_dead_sleepers(engine, tick);
+    applied = tick;
+    engine->tick++;
+
+done:
+    // Voltam à agenda para a próxima jogada em que agem (os Pacmans mortos saem)
+    for (int d = 0; d < engine->n_due; d++) {
+        int agent = engine->due[d];
+        if (agent >= board->n_pacmans || board->pacmans[agent].player < 0) schedule(engine, agent, applied);
+    }
+    // Uma vaga que saiu e voltou a nascer nesta jogada já foi agendada acima
+    for (int s = 0; s < engine->n_spawned; s++) {
+        int agent = board->n_pacmans + engine->spawned[s];
+        if (engine->wake[agent] < 0) schedule(engine, agent, applied);
+    }
+    pthread_mutex_unlock(&board->board_lock);
+    return outcome;
+}
+
+// ==================================================================
+// RELÓGIO DAS JOGADAS
+// ==================================================================
+#define NS_PER_SEC 1000000000L
+#define TICK_STALL_NS NS_PER_SEC // Atrasos maiores que isto são paragens, não carga
+#define TICK_MAX_SLEEP_NS (3600 * NS_PER_SEC) // Um sono mais longo acorda a meio (sem overflow nos prazos)
+
+static void timespec_add_ns(struct timespec* t, long ns) {
+    t->tv_sec += ns / NS_PER_SEC;
+    t->tv_nsec += ns % NS_PER_SEC;
+    if (t->tv_nsec >= NS_PER_SEC) {
+        t->tv_sec++;
+        t->tv_nsec -= NS_PER_SEC;
+    }
+}
+
+static long long timespec_diff_ns(const struct timespec* a, const struct timespec* b) {
+    return (long long)(a->tv_sec - b->tv_sec) * NS_PER_SEC + (a->tv_nsec - b->tv_nsec);
+}
+
+void tick_clock_start(tick_clock_t* clock, int period_ms) {
+    clock->period_ns = (long)(period_ms > 0 ? period_ms : 1) * 1000000L;
+    clock->ticks = clock->overruns = clock->missed = clock->stalls = 0;
+    clock->max_late_ns = 0;
+    clock_gettime(CLOCK_MONOTONIC, &clock->start);
+    clock->next = clock->start;
+    timespec_add_ns(&clock->next, clock->period_ns);
+}
+
+void tick_clock_wait(tick_clock_t* clock) {
+    tick_clock_wait_ticks(clock, 1);
+}
+
+void tick_clock_wait_ticks(tick_clock_t* clock, long n) {
+    if (n < 1) n = 1;
+    timespec_add_ns(&clock->next, (n - 1) * clock->period_ns);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long late = timespec_diff_ns(&now, &clock->next);
+    clock->ticks += n;
+
+    if (late <= 0) {
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &clock->next, NULL) == EINTR) {
+        }
+        timespec_add_ns(&clock->next, clock->period_ns);
+        return;
+    }
+
+    // Atrasado: voltar à grelha no primeiro prazo ainda no futuro
+    long long behind = late / clock->period_ns;
+    if (late > TICK_STALL_NS) {
+        clock->stalls++;
+    }
+    else {
+        clock->overruns++;
+        clock->missed += behind;
+        if (late > clock->max_late_ns) clock->max_late_ns = late;
+    }
+    timespec_add_ns(&clock->next, (behind + 1) * clock->period_ns);
+}
+
+long tick_clock_sleep(tick_clock_t* clock, long n, board_t* board) {
+    if (n < 1) n = 1;
+    struct timespec now;
+    if (n != TICK_FOREVER) {
+        if (n > TICK_MAX_SLEEP_NS / clock->period_ns) n = TICK_MAX_SLEEP_NS / clock->period_ns;
+        struct timespec deadline = clock->next;
+        timespec_add_ns(&deadline, (n - 1) * clock->period_ns);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (timespec_diff_ns(&now, &deadline) > 0) {
+            tick_clock_wait_ticks(clock, n); // Atrasado: só as contas, sem dormir
+            return n;
+        }
+        if (!board_sleep_until(board, &deadline)) {
+            clock->ticks += n;
+            clock->next = deadline;
+            timespec_add_ns(&clock->next, clock->period_ns);
+            return n;
+        }
+    }
+    else {
+        board_sleep_until(board, NULL);
+    }
+
+    // Acordado antes do prazo: os prazos que passaram entretanto ficam cumpridos
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long since = timespec_diff_ns(&now, &clock->next);
+    long passed = since < 0 ? 0 : (long)(since / clock->period_ns) + 1;
+    if (passed > n) passed = n;
+    clock->ticks += passed;
+    timespec_add_ns(&clock->next, passed * clock->period_ns);
+    return passed;
+}
+
+double tick_clock_rate(const tick_clock_t* clock) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long elapsed = timespec_diff_ns(&now, &clock->start);
+    return elapsed > 0 ? clock->ticks * (double)NS_PER_SEC / elapsed : 0;
+}
+
+double tick_clock_target(const tick_clock_t* clock) {
+    return (double)NS_PER_SEC / clock->period_ns;
+}
@@ -0,0 +1,231 @@
+#include "traj.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TRAJ_TRACE_BITS 13 // Tabela do traçado: pelo menos 2 * (TRAJ_MAX_TICKS + 1) entradas
+_Static_assert((1 << TRAJ_TRACE_BITS) >= 2 * (TRAJ_MAX_TICKS + 1), "tabela do traçado pequena demais");
+
+// Com by_script a posição não conta: só o estado do script (instrução, contadores, carga)
+static uint32_t state_hash(const traj_state_t* s, int by_script) {
+    uint64_t h = (uint64_t)s->pc << 32 | (uint64_t)s->charged << 40;
+    if (!by_script) h |= (uint64_t)s->x | (uint64_t)s->y << 16;
+    h ^= (uint64_t)(uint32_t)s->left * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t)(uint32_t)s->waiting * 0xC2B2AE3D27D4EB4Full;
+    h *= 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(h >> 32);
+}
+
+static int same_state(const traj_state_t* a, const traj_state_t* b, int by_script) {
+    return (by_script || (a->x == b->x && a->y == b->y)) && a->pc == b->pc && a->charged == b->charged
+        && a->left == b->left && a->waiting == b->waiting;
+}
+
+static void capture(traj_state_t* s, const ghost_t* ghost) {
+    s->x = (uint16_t)ghost->pos_x;
+    s->y = (uint16_t)ghost->pos_y;
+    s->pc = (uint8_t)ghost->pc;
+    s->charged = (uint8_t)ghost->charged;
+    s->left = ghost->left;
+    s->waiting = ghost->waiting;
+}
+
+// Índice de s em table, ou -1 (e a posição livre onde entraria em *slot)
+static int lookup(const traj_state_t* states, const int32_t* table, uint32_t mask,
+                  const traj_state_t* s, int by_script, uint32_t* slot) {
+    for (uint32_t i = state_hash(s, by_script) & mask; ; i = (i + 1) & mask) {
+        if (table[i] < 0) { if (slot) *slot = i; return -1; }
+        if (same_state(&states[table[i]], s, by_script)) return table[i];
+    }
+}
+
+static int is_open(const board_t* board, int x, int y) {
+    return x >= 0 && x < board->width && y >= 0 && y < board->height
+        && board_at(board, x, y)->content != 'W';
+}
+
+// Um movimento só contra as paredes (mesmas regras de resolve_ghost_impl e resolve_ghost_charged)
+static void move_alone(const board_t* board, ghost_t* ghost, const intent_t* intent) {
+    if (!intent->move) return;
+    int x = ghost->pos_x, y = ghost->pos_y;
+    if (intent->charged) {
+        while (is_open(board, x + intent->dx, y + intent->dy)) {
+            x += intent->dx;
+            y += intent->dy;
+        }
+    }
+    else if (is_open(board, x + intent->dx, y + intent->dy)) {
+        x += intent->dx;
+        y += intent->dy;
+    }
+    ghost->pos_x = x;
+    ghost->pos_y = y;
+}
+
+static int has_trajectory(const ghost_t* ghost) {
+    if (ghost->n_code == 0) return 0; // Sorteia uma direção por jogada
+    if (!ghost->active) return 0;     // Vaga de um ninho: nasce a meio do jogo
+    for (int i = 0; i < ghost->n_code; i++)
+        if (ghost->code[i].op == OP_RANDOM || ghost->code[i].op == OP_DESPAWN) return 0;
+    return 1;
+}
+
+/* Joga o fantasma g sozinho até o estado se repetir. Devolve o comprimento do
+   prefixo + ciclo em buf, ou -1 se passar de TRAJ_MAX_TICKS */
+static int trace_ghost(const board_t* board, int g, traj_state_t* buf, int32_t* table, int* n_prefix) {
+    uint32_t mask = (1u << TRAJ_TRACE_BITS) - 1;
+    memset(table, 0xff, sizeof(int32_t) << TRAJ_TRACE_BITS);
+
+    // plan_ghost só mexe no próprio fantasma: um tabuleiro com só uma cópia dele chega
+    ghost_t copy = board->ghosts[g];
+    board_t alone;
+    memset(&alone, 0, sizeof(alone));
+    alone.width = board->width;
+    alone.height = board->height;
+    alone.ghosts = &copy;
+    alone.n_ghosts = 1;
+
+    for (int t = 0; t <= TRAJ_MAX_TICKS; t++) {
+        uint32_t slot;
+        capture(&buf[t], &copy);
+        int seen = lookup(buf, table, mask, &buf[t], 0, &slot);
+        if (seen >= 0) {
+            *n_prefix = seen;
+            return t;
+        }
+        table[slot] = t;
+
+        intent_t intent;
+        plan_ghost(&alone, 0, ghost_op(&alone, 0), &intent);
+        buf[t].issued = !intent.move ? 0 : intent.charged ? intent.direction - 'A' + 'a' : intent.direction;
+        move_alone(board, &copy, &intent);
+    }
+    return -1;
+}
+
+// Copia o traçado para a trajetória: estados, caixas por bloco e tabela de consulta
+static int store(traj_t* traj, const traj_state_t* buf, int len, int n_prefix) {
+    int unrolled = len + TRAJ_WINDOW + 1; // Uma janela a começar no último estado ainda cabe
+    int n_boxes = (unrolled + TRAJ_WINDOW - 1) / TRAJ_WINDOW;
+    uint32_t size = 1;
+    while (size < 2u * len) size <<= 1;
+
+    size_t states_size = sizeof(traj_state_t) * len;
+    size_t boxes_size = sizeof(traj_box_t) * n_boxes;
+    traj->mem = malloc(states_size + boxes_size + 2 * sizeof(int32_t) * size);
+    if (!traj->mem) return -1;
+    traj->states = traj->mem;
+    traj->boxes = (traj_box_t*)((char*)traj->mem + states_size);
+    traj->index = (int32_t*)((char*)traj->mem + states_size + boxes_size);
+    traj->script_index = traj->index + size;
+    traj->index_mask = size - 1;
+    traj->n_prefix = n_prefix;
+    traj->n_cycle = len - n_prefix;
+    memcpy(traj->states, buf, states_size);
+
+    memset(traj->index, 0xff, 2 * sizeof(int32_t) * size);
+    for (int i = 0; i < len; i++) {
+        uint32_t slot;
+        lookup(traj->states, traj->index, traj->index_mask, &traj->states[i], 0, &slot);
+        traj->index[slot] = i;
+        if (lookup(traj->states, traj->script_index, traj->index_mask, &traj->states[i], 1, &slot) < 0)
+            traj->script_index[slot] = i;
+    }
+
+    for (int b = 0; b < n_boxes; b++) {
+        traj_box_t* box = &traj->boxes[b];
+        box->x0 = box->y0 = INT32_MAX;
+        box->x1 = box->y1 = -1;
+        for (int u = b * TRAJ_WINDOW; u < (b + 1) * TRAJ_WINDOW && u < unrolled; u++) {
+            const traj_state_t* s = traj_state(traj, 0, u);
+            if (s->x < box->x0) box->x0 = s->x;
+            if (s->x > box->x1) box->x1 = s->x;
+            if (s->y < box->y0) box->y0 = s->y;
+            if (s->y > box->y1) box->y1 = s->y;
+        }
+    }
+    return 0;
+}
+
+traj_set_t* traj_build(const board_t* board) {
+    traj_set_t* set = calloc(1, sizeof(traj_set_t));
+    traj_state_t* buf = malloc(sizeof(traj_state_t) * (TRAJ_MAX_TICKS + 1));
+    int32_t* table = malloc(sizeof(int32_t) << TRAJ_TRACE_BITS);
+    if (set) set->ghosts = calloc(board->n_ghosts ? board->n_ghosts : 1, sizeof(traj_t));
+    if (!set || !set->ghosts || !buf || !table) {
+        traj_free(set);
+        free(buf);
+        free(table);
+        return NULL;
+    }
+    set->n_ghosts = board->n_ghosts;
+
+    for (int g = 0; g < board->n_ghosts; g++) {
+        if (!has_trajectory(&board->ghosts[g])) continue;
+        int n_prefix;
+        int len = trace_ghost(board, g, buf, table, &n_prefix);
+        if (len < 0 || store(&set->ghosts[g], buf, len, n_prefix) != 0) continue;
+        set->n_traj++;
+    }
+    free(buf);
+    free(table);
+
+    debug("[TRAJ] %d de %d fantasmas com trajetória pré-calculada\n", set->n_traj, set->n_ghosts);
+    if (set->n_traj == 0) {
+        traj_free(set);
+        return NULL;
+    }
+    return set;
+}
+
+void traj_free(traj_set_t* set) {
+    if (!set) return;
+    if (set->ghosts) {
+        for (int g = 0; g < set->n_ghosts; g++) free(set->ghosts[g].mem);
+    }
+    free(set->ghosts);
+    free(set);
+}
+
+int traj_find(const traj_t* traj, const ghost_t* ghost) {
+    if (traj->n_cycle == 0) return -1;
+    traj_state_t s;
+    capture(&s, ghost);
+    return lookup(traj->states, traj->index, traj->index_mask, &s, 0, NULL);
+}
+
+int traj_find_script(const traj_t* traj, const ghost_t* ghost) {
+    if (traj->n_cycle == 0) return -1;
+    traj_state_t s;
+    capture(&s, ghost);
+    return lookup(traj->states, traj->script_index, traj->index_mask, &s, 1, NULL);
+}
+
+const traj_state_t* traj_state(const traj_t* traj, int at, long i) {
+    long u = at + i;
+    long len = traj->n_prefix + traj->n_cycle;
+    if (u >= len) u = traj->n_prefix + (u - traj->n_prefix) % traj->n_cycle;
+    return &traj->states[u];
+}
+
+void traj_window_box(const traj_t* traj, int at, int n, traj_box_t* box) {
+    const traj_box_t* a = &traj->boxes[at / TRAJ_WINDOW];
+    const traj_box_t* b = &traj->boxes[(at + n) / TRAJ_WINDOW];
+    box->x0 = a->x0 < b->x0 ? a->x0 : b->x0;
+    box->y0 = a->y0 < b->y0 ? a->y0 : b->y0;
+    box->x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+    box->y1 = a->y1 > b->y1 ? a->y1 : b->y1;
+}
+
+void traj_window_moves(const traj_t* traj, int at, int n, traj_moves_t* moves) {
+    memset(moves, 0, sizeof(*moves));
+    for (int i = 0; i < n; i++) {
+        switch (traj_state(traj, at, i)->issued) {
+            case 'A': moves->left++;  break;
+            case 'D': moves->right++; break;
+            case 'W': moves->up++;    break;
+            case 'S': moves->down++;  break;
+            case 0:                   break;
+            default:  moves->charged++; break;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#include "ttable.h"
+#include <stdlib.h>
+#include <string.h>
+
+// A chave 0 marca entradas livres: um hash 0 é guardado como 1
+static inline uint64_t tt_norm(uint64_t key) {
+    return key ? key : 1;
+}
+
+int tt_init(ttable_t* tt, int log2_size) {
+    size_t cap = (size_t)1 << log2_size;
+    tt->entries = calloc(cap, sizeof(tt_entry_t));
+    tt->mask = cap - 1;
+    tt->used = 0;
+    return tt->entries ? 0 : -1;
+}
+
+void tt_clear(ttable_t* tt) {
+    memset(tt->entries, 0, (tt->mask + 1) * sizeof(tt_entry_t));
+    tt->used = 0;
+}
+
+void tt_free(ttable_t* tt) {
+    free(tt->entries);
+    tt->entries = NULL;
+    tt->mask = 0;
+    tt->used = 0;
+}
+
+static tt_entry_t* tt_slot(tt_entry_t* entries, size_t mask, uint64_t key) {
+    size_t i = (size_t)(key ^ (key >> 32)) & mask;
+    while (entries[i].key != 0 && entries[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    return &entries[i];
+}
+
+static int tt_grow(ttable_t* tt) {
+    size_t cap = (tt->mask + 1) * 2;
+    tt_entry_t* entries = calloc(cap, sizeof(tt_entry_t));
+    if (!entries) return -1;
+
+    for (size_t i = 0; i <= tt->mask; i++) {
+        if (tt->entries[i].key != 0)
+            *tt_slot(entries, cap - 1, tt->entries[i].key) = tt->entries[i];
+    }
+    free(tt->entries);
+    tt->entries = entries;
+    tt->mask = cap - 1;
+    return 0;
+}
+
+tt_entry_t* tt_lookup(const ttable_t* tt, uint64_t key) {
+    key = tt_norm(key);
+    tt_entry_t* e = tt_slot(tt->entries, tt->mask, key);
+    return e->key ? e : NULL;
+}
+
+tt_entry_t* tt_insert(ttable_t* tt, uint64_t key, int* created) {
+    key = tt_norm(key);
+    if ((tt->used + 1) * 4 > (tt->mask + 1) * 3 && tt_grow(tt) != 0) return NULL;
+
+    tt_entry_t* e = tt_slot(tt->entries, tt->mask, key);
+    *created = (e->key == 0);
+    if (*created) {
+        e->key = key;
+        e->tick = 0;
+        e->value = TT_PENDING;
+        e->points = 0;
+        tt->used++;
+    }
+    return e;
+}
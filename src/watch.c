@@ -0,0 +1,312 @@
+#include "watch.h"
+#include "files.h"
+#include "analyzer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM)
+
+struct level_watch {
+    int fd;
+    watch_change_t* pending; // Ficheiros alterados ainda não entregues, um por nome
+    int n_pending, cap;
+};
+
+static int file_kind(const char* name) {
+    const char* dot = strrchr(name, '.');
+    if (!dot) return -1;
+    if (strcmp(dot, ".lvl") == 0) return WATCH_LEVEL;
+    if (strcmp(dot, ".m") == 0 || strcmp(dot, ".p") == 0) return WATCH_AGENT;
+    return -1;
+}
+
+level_watch_t* watch_open(const char* dir_path) {
+    level_watch_t* watch = calloc(1, sizeof(level_watch_t));
+    if (!watch) return NULL;
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd < 0 || inotify_add_watch(watch->fd, dir_path, WATCH_EVENTS) < 0) {
+        watch_close(watch);
+        return NULL;
+    }
+    return watch;
+}
+
+void watch_close(level_watch_t* watch) {
+    if (!watch) return;
+    if (watch->fd >= 0) close(watch->fd);
+    free(watch->pending);
+    free(watch);
+}
+
+int watch_fd(const level_watch_t* watch) {
+    return watch->fd;
+}
+
+// Junta um evento aos pendentes: o mesmo ficheiro fica uma só vez, com o último estado
+static void add_pending(level_watch_t* watch, const char* name, int kind, int removed) {
+    for (int i = 0; i < watch->n_pending; i++) {
+        watch_change_t* c = &watch->pending[i];
+        if (c->kind == kind && strcmp(c->name, name) == 0) {
+            c->removed = removed;
+            return;
+        }
+    }
+    if (watch->n_pending == watch->cap) {
+        int cap = watch->cap ? 2 * watch->cap : 16;
+        watch_change_t* pending = realloc(watch->pending, sizeof(watch_change_t) * cap);
+        if (!pending) return; // Sem memória o evento perde-se
+        watch->pending = pending;
+        watch->cap = cap;
+    }
+    watch_change_t* c = &watch->pending[watch->n_pending++];
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    c->kind = kind;
+    c->removed = removed;
+}
+
+int watch_read(level_watch_t* watch, watch_change_t* changes, int max) {
+    // Os eventos vêm inteiros e alinhados para struct inotify_event
+    char buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t len = read(watch->fd, buf, sizeof(buf));
+        if (len <= 0) break; // EAGAIN: não há mais eventos
+        for (char* p = buf; p < buf + len; ) {
+            const struct inotify_event* ev = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                add_pending(watch, "", WATCH_OVERFLOW, 0);
+                continue;
+            }
+            int kind = ev->len ? file_kind(ev->name) : -1;
+            if (kind < 0) continue;
+            add_pending(watch, ev->name, kind, (ev->mask & (IN_DELETE | IN_MOVED_FROM)) != 0);
+        }
+    }
+
+    int n = watch->n_pending < max ? watch->n_pending : max;
+    if (n == 0) return 0;
+    memcpy(changes, watch->pending, sizeof(watch_change_t) * n);
+    memmove(watch->pending, watch->pending + n, sizeof(watch_change_t) * (watch->n_pending - n));
+    watch->n_pending -= n;
+    return n;
+}
+
+// ==================================================================
+// MODO --watch
+// ==================================================================
+typedef struct {
+    char name[256];
+    board_t board;
+    int loaded;              // board tem o nível lido (senão o nível nem se lê)
+    level_report_t report;
+} watched_level_t;
+
+static double elapsed_ms(const struct timespec* t0, const struct timespec* t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1e3 + (t1->tv_nsec - t0->tv_nsec) / 1e6;
+}
+
+// Volta a ler o nível todo (nível novo ou alterado, ou script que não entra sozinho)
+static void reload_level(watched_level_t* level, const char* dir_path) {
+    if (level->loaded) unload_level(&level->board);
+    memset(&level->board, 0, sizeof(level->board));
+    level->loaded = parse_level(&level->board, dir_path, level->name, 0) == 0;
+    if (!level->loaded) {
+        board_free_cells(&level->board);
+        memset(&level->report, 0, sizeof(level->report));
+        snprintf(level->report.level_name, sizeof(level->report.level_name), "%s", level->name);
+        level->report.n_errors = 1;
+        level->report.n_issues = 1;
+        level->report.issues[0].severity = ISSUE_ERROR;
+        snprintf(level->report.issues[0].msg, sizeof(level->report.issues[0].msg),
+                 "não foi possível ler o nível (falta DIM?)");
+        return;
+    }
+    analyze_level(&level->board, &level->report);
+}
+
+static void print_level(const watched_level_t* level, const char* what, double ms) {
+    printf("%s %s em %.2f ms\n", level->name, what, ms);
+    print_level_report(stdout, &level->report);
+}
+
+static watched_level_t* find_level(watched_level_t* levels, int n, const char* name) {
+    for (int i = 0; i < n; i++)
+        if (strcmp(levels[i].name, name) == 0) return &levels[i];
+    return NULL;
+}
+
+// Um .lvl gravado, novo ou apagado. Devolve o novo número de níveis
+static int level_changed(watched_level_t** levels, int n, int* cap, const watch_change_t* change,
+                         const char* dir_path) {
+    watched_level_t* level = find_level(*levels, n, change->name);
+    if (change->removed) {
+        if (!level) return n;
+        if (level->loaded) unload_level(&level->board);
+        printf("%s removido\n", change->name);
+        *level = (*levels)[--n];
+        return n;
+    }
+    if (!level) {
+        if (n == *cap) {
+            int grown = *cap ? 2 * *cap : 16;
+            watched_level_t* more = realloc(*levels, sizeof(watched_level_t) * grown);
+            if (!more) return n;
+            *levels = more;
+            *cap = grown;
+        }
+        level = &(*levels)[n++];
+        memset(level, 0, sizeof(*level));
+        snprintf(level->name, sizeof(level->name), "%s", change->name);
+    }
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    reload_level(level, dir_path);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    print_level(level, "lido", elapsed_ms(&t0, &t1));
+    return n;
+}
+
+/* Um .m / .p gravado: é lido e compilado uma vez e trocado nos níveis que o usam,
+   que só são analisados de novo. Um script que não compila, uma POS diferente ou um
+   ficheiro apagado fazem ler o nível outra vez (a análise mostra o erro) */
+static void agent_changed(watched_level_t* levels, int n, const watch_change_t* change, const char* dir_path) {
+    struct timespec t0, t1;
+    agent_script_t* script = malloc(sizeof(agent_script_t));
+    if (!script) return;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int readable = !change->removed && load_agent_script(script, dir_path, change->name) == 0;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("%s %s em %.2f ms\n", change->name, readable ? "compilado" : "ilegível", elapsed_ms(&t0, &t1));
+
+    for (int i = 0; i < n; i++) {
+        watched_level_t* level = &levels[i];
+        if (!level->loaded || !level_uses_file(&level->board, change->name)) continue;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        char err[128];
+        int moved = 0;
+        if (readable && swap_agent_script(&level->board, script, &moved, err, sizeof(err)) >= 0 && !moved) {
+            analyze_level(&level->board, &level->report);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            print_level(level, "reanalisado", elapsed_ms(&t0, &t1));
+        }
+        else {
+            reload_level(level, dir_path);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            print_level(level, "lido", elapsed_ms(&t0, &t1));
+        }
+    }
+    free(script);
+}
+
+static void free_namelist(struct dirent** namelist, int n) {
+    for (int i = 0; i < n; i++) free(namelist[i]);
+    free(namelist);
+}
+
+/* Eventos perdidos: a diretoria é lida de novo e a lista acertada com ela. Os níveis
+   que já não existem saem, os novos entram e os restantes são lidos outra vez.
+   Devolve o novo número de níveis */
+static int rescan_levels(watched_level_t** levels, int n, int* cap, const char* dir_path) {
+    struct dirent** namelist;
+    int m = scandir(dir_path, &namelist, filter_levels, alphasort);
+    if (m < 0) { perror("scandir"); return n; }
+
+    watch_change_t change = { .kind = WATCH_LEVEL };
+    // De trás para a frente: level_changed põe o último no lugar do removido
+    for (int i = n - 1; i >= 0; i--) {
+        int listed = 0;
+        for (int j = 0; j < m && !listed; j++)
+            listed = strcmp((*levels)[i].name, namelist[j]->d_name) == 0;
+        if (listed) continue;
+        snprintf(change.name, sizeof(change.name), "%s", (*levels)[i].name);
+        change.removed = 1;
+        n = level_changed(levels, n, cap, &change, dir_path);
+    }
+    change.removed = 0;
+    for (int j = 0; j < m; j++) {
+        snprintf(change.name, sizeof(change.name), "%s", namelist[j]->d_name);
+        n = level_changed(levels, n, cap, &change, dir_path);
+    }
+    free_namelist(namelist, m);
+    return n;
+}
+
+int watch_main(int argc, char** argv) {
+    if (argc < 2) { printf("Usage: %s <dir> [seconds]\n", argv[0]); return 1; }
+    const char* dir_path = argv[1];
+    int seconds = argc > 2 ? atoi(argv[2]) : 0;
+
+    // A vigia começa antes da leitura: o que for gravado entretanto não se perde
+    level_watch_t* watch = watch_open(dir_path);
+    if (!watch) { perror("inotify"); return 1; }
+
+    struct dirent** namelist;
+    int n = scandir(dir_path, &namelist, filter_levels, alphasort);
+    if (n < 0) { perror("scandir"); watch_close(watch); return 1; }
+
+    int cap = n > 0 ? n : 1;
+    watched_level_t* levels = calloc(cap, sizeof(watched_level_t));
+    if (!levels) {
+        perror("calloc");
+        free_namelist(namelist, n);
+        watch_close(watch);
+        return 1;
+    }
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < n; i++) {
+        snprintf(levels[i].name, sizeof(levels[i].name), "%s", namelist[i]->d_name);
+        reload_level(&levels[i], dir_path);
+        print_level_report(stdout, &levels[i].report);
+    }
+    free_namelist(namelist, n);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("%d nível(is) lido(s) em %.1f ms; à espera de alterações em %s\n", n, elapsed_ms(&t0, &t1), dir_path);
+    fflush(stdout);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;) {
+        int timeout = -1;
+        if (seconds > 0) {
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            timeout = seconds * 1000 - (int)elapsed_ms(&start, &t1);
+            if (timeout <= 0) break;
+        }
+        struct pollfd pfd = { watch_fd(watch), POLLIN, 0 };
+        int ready = poll(&pfd, 1, timeout);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) continue;
+
+        watch_change_t changes[64];
+        int k;
+        while ((k = watch_read(watch, changes, 64)) > 0) {
+            for (int c = 0; c < k; c++) {
+                if (changes[c].kind == WATCH_LEVEL)
+                    n = level_changed(&levels, n, &cap, &changes[c], dir_path);
+                else if (changes[c].kind == WATCH_AGENT)
+                    agent_changed(levels, n, &changes[c], dir_path);
+                else {
+                    printf("eventos perdidos: a diretoria é lida de novo\n");
+                    n = rescan_levels(&levels, n, &cap, dir_path);
+                }
+            }
+        }
+        fflush(stdout);
+    }
+
+    int broken = 0;
+    for (int i = 0; i < n; i++) {
+        if (levels[i].report.n_errors > 0) broken++;
+        if (levels[i].loaded) unload_level(&levels[i].board);
+    }
+    free(levels);
+    watch_close(watch);
+    return broken ? 2 : 0;
+}